@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// raygen の PixelAccum と同じレイアウト (common_bindings.slang)
+struct PixelAccum {
+    float mean[3];      // radiance の平均
+    uint32_t count;     // サンプル数
+    float lumMean;      // 輝度の平均 (Welford)
+    float lumM2;        // 輝度の偏差平方和 (Welford)
+    uint32_t flags;
+    float pad;
+};
+static_assert(sizeof(PixelAccum) == 32, "PixelAccum must match the shader layout");
+
+// 1サンプル目で背景に抜けた画素 (分散0なので収束扱い)
+inline constexpr uint32_t kPixelBackground = 1u << 0;
+
+struct AdaptiveConfig {
+    uint32_t samplesPerPass = 15;
+    uint32_t minSamples = 30;
+    uint32_t maxSamples = 225;
+    // 平均の標準誤差 / 平均 がこれ以下なら収束
+    float relativeErrorThreshold = 0.02f;
+};
+
+uint32_t maxPasses(const AdaptiveConfig& config);
+bool isPixelConverged(const PixelAccum& p, const AdaptiveConfig& config);
+
+// 未収束画素のインデックス (y * width + x) を昇順で active に詰める
+uint32_t buildActivePixelList(
+    const PixelAccum* accum, uint32_t width, uint32_t height,
+    const AdaptiveConfig& config, std::vector<uint32_t>& active);
+
+// active が accum から求めた未収束画素の集合と一致するか調べる
+bool validateActivePixelList(
+    const PixelAccum* accum, uint32_t width, uint32_t height,
+    const AdaptiveConfig& config, const std::vector<uint32_t>& active);
@@ -0,0 +1,49 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+// フレーム番号 -> カメラ。キーフレーム (glTF のカメラアニメーションか camera.json) を
+// スプラインで補間し、どのフレームも前後のフレームに依存せず求められるようにする
+
+// raygen に渡すピンホールカメラの基底 (SceneUBO の camPos / camForward / camRight / camUp)
+struct CameraView {
+    glm::vec3 position{0.0f, 0.0f, 0.0f};
+    glm::vec3 forward{0.0f, 0.0f, -1.0f};
+    glm::vec3 right{1.0f, 0.0f, 0.0f};
+    glm::vec3 up{0.0f, 1.0f, 0.0f};
+    float tanHalfFov = 0.41421356f;     // tan(縦の画角 / 2)
+};
+
+// forward と up から直交基底を作る (up は forward に直交していなくてよい)
+CameraView makeCameraView(const glm::vec3& position, const glm::vec3& forward, const glm::vec3& up, float vfov);
+
+// シーンキャッシュにそのまま書くので固定レイアウト
+struct CameraKey {
+    float time = 0.0f;                  // 秒
+    glm::vec3 position{0.0f, 0.0f, 0.0f};
+    glm::vec3 forward{0.0f, 0.0f, -1.0f};
+    glm::vec3 up{0.0f, 1.0f, 0.0f};
+    float vfov = 0.78539816f;           // 縦の画角 [rad]
+};
+
+struct CameraTimeline {
+    float fps = 30.0f;
+    uint32_t frameCount = 1;            // キーが無いときの軌道 (frameCount フレームで半周) に使う
+    std::vector<CameraKey> keys;        // time の昇順 (重複なし)
+
+    // キーの最後の時刻。キーが無ければ 0
+    float duration() const;
+    // 時刻 frameIndex / fps を二分探索して、前後のキーの間を Catmull-Rom で補間する
+    CameraView view(uint32_t frameIndex) const;
+};
+
+// キーを時刻順に並べ、同じ時刻のキーや向きが 0 のキーがあれば false
+bool sortCameraKeys(std::vector<CameraKey>& keys);
+
+// {"keys": [{"time": 0, "position": [x,y,z], "target": [x,y,z] か "forward": [x,y,z], "up": [0,1,0], "fov": 45}]}
+// fov は縦の画角 [度]。up と fov は省略できる。失敗時は false
+bool loadCameraKeys(const std::filesystem::path& path, std::vector<CameraKey>& keys);
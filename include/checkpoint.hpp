@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// 長いレンダリングを途中から再開するためのチェックポイント
+// 書き終えたフレームと、その出力ファイルのサイズ・内容ハッシュを記録する
+// 締め切りで止まったフレームは、適応サンプリングの累積 (PixelAccum の配列) と次のパス番号も残す
+
+// チェックポイントのバイナリ形式を変えたら上げる
+inline constexpr uint32_t kCheckpointVersion = 1;
+inline constexpr uint32_t kNoPartialFrame = 0xFFFFFFFFu;
+
+struct CheckpointFile {
+    std::string path;
+    uint64_t size = 0;
+    uint64_t hash = 0;      // hashBytes (FNV-1a 64bit)
+};
+
+struct CheckpointFrame {
+    uint32_t index = 0;
+    std::vector<CheckpointFile> files;
+};
+
+struct RenderCheckpoint {
+    uint64_t configHash = 0;    // 解像度・フレーム数・出力設定・カメラ。違えば再開しない
+    uint32_t frameCount = 0;
+    std::vector<CheckpointFrame> frames;
+
+    uint32_t partialFrame = kNoPartialFrame;
+    uint32_t partialPasses = 0;             // 再開時に最初に回すパス番号
+    std::vector<uint8_t> partialState;      // PixelAccum の配列そのまま
+
+    // index のフレームを記録する (同じフレームがあれば置き換える)
+    void recordFrame(CheckpointFrame frame);
+};
+
+// 一時ファイルに書いてから置き換える
+bool writeCheckpoint(const std::filesystem::path& path, const RenderCheckpoint& checkpoint);
+// 無い/古い/壊れている場合は false
+bool readCheckpoint(const std::filesystem::path& path, RenderCheckpoint& checkpoint);
+
+// 書き出したファイルのサイズとハッシュを記録する
+bool describeFile(const std::filesystem::path& path, CheckpointFile& file);
+// 記録どおりのファイルが残っていれば true
+bool verifyFile(const CheckpointFile& file);
+
+// 記録されたフレームのうち、出力ファイルがすべて記録どおりのものだけ true (frameCount 個)
+std::vector<bool> verifiedFrames(const RenderCheckpoint& checkpoint);
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// SVGF (Schied et al. 2017) の空間フィルタ部分に沿ったエッジ保存 à-trous ウェーブレットフィルタ
+// アルベドで割った照度をフィルタし、最後にアルベドを掛け戻すのでテクスチャはぼけない
+struct DenoiseParams {
+    uint32_t iterations = 5;        // 2^i 画素おきの 5x5 を何段重ねるか (5 段で半径 62 画素)
+    float sigmaLuminance = 4.0f;    // 輝度の重みの幅 (分散から求めた標準偏差に対する倍率)
+    uint32_t normalPowerLog2 = 7;   // 法線の重み max(0, dot)^(2^n)。SVGF の σn = 128
+    float sigmaDepth = 1.0f;        // 深度の重みの幅 (画面上の深度勾配から予想される差に対する倍率)
+};
+
+// 入力はすべて width * height 画素
+struct DenoiseInput {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::span<const float> color;       // RGBA32F 線形 HDR
+    std::span<const float> albedo;      // RGBA32F 一次ヒットのアルベド (サンプル平均)
+    std::span<const float> normal;      // RGBA32F 一次ヒットのワールド法線 (サンプル平均, 背景は 0)
+    std::span<const float> depth;       // R32F 線形深度 (背景は 0)。空なら深度の重みを使わない
+    std::span<const float> variance;    // 画素ごとの輝度の平均の分散。空なら近傍 3x3 から推定する
+};
+
+// out は RGBA32F。入力の大きさが足りなければ false
+bool denoiseFrame(const DenoiseInput& input, const DenoiseParams& params, std::vector<float>& out);
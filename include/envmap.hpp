@@ -0,0 +1,10 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+glm::vec3 CubemapDirectionFromFaceXY(int face, int x, int y, int faceSize);
+glm::vec4 SampleEquirect(const glm::vec3& dir, const float* src, int w, int h);
+
+// equirect (RGBA32F) を6面のキューブマップ (RGBA32F, 面ごとに詰める) に変換する
+void convertEquirectToCubemap(const float* src, int w, int h, uint32_t faceSize, std::vector<float>& cube);
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// フレーム画像の書き出し形式 (maple --format で選ぶ)
+enum class OutputFormat : uint32_t {
+    Png,        // png_encoder レベル 6 (行ごとにフィルタを選ぶ)
+    PngFast,    // png_encoder レベル 1 (Sub フィルタ固定, 貪欲マッチ)
+    PngStore,   // png_encoder レベル 0 (無圧縮 deflate)
+    Exr,        // OpenEXR, half float RGBA, 無圧縮スキャンライン
+    Pfm,        // Portable Float Map, float RGB
+};
+
+// ldr: トーンマップ済み RGBA8, hdr: 線形 RGBA32F。形式に応じて片方だけ使う
+// albedo 以降は AOV (--aov か --denoise のときだけ読み戻す)。variance はデノイズ用
+struct OutputFrame {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::span<const uint8_t> ldr;
+    std::span<const float> hdr;
+    std::span<const float> albedo;      // RGBA32F 一次ヒットのアルベド (サンプル平均)
+    std::span<const float> normal;      // RGBA32F 一次ヒットのワールド法線 (サンプル平均, 背景は 0)
+    std::span<const float> depth;       // R32F 1 サンプル目のカメラ方向の線形深度 (背景は 0)
+    std::span<const uint32_t> ids;      // 画素ごとに (プリミティブ番号, マテリアル番号)。背景は kAovMissId
+    std::span<const float> variance;    // 画素ごとの輝度の平均の分散
+};
+
+// AOV の id で背景を表す値
+inline constexpr uint32_t kAovMissId = 0xffffffffu;
+
+bool parseOutputFormat(std::string_view name, OutputFormat& format);
+const char* outputFormatName(OutputFormat format);
+const char* outputExtension(OutputFormat format);
+
+// HDR 画像の読み戻しが必要か
+bool outputNeedsHdr(OutputFormat format);
+
+// メモリ上にエンコードする (ベンチマーク用)。失敗時は false
+bool encodeFrame(OutputFormat format, const OutputFrame& frame, std::vector<uint8_t>& out);
+
+bool writeFrame(const std::filesystem::path& path, OutputFormat format, const OutputFrame& frame);
+
+// AOV をまとめて 1 枚の EXR にする (albedo.RGB, N.XYZ は HALF, Z は FLOAT, id.* は UINT)
+bool encodeAovFrame(const OutputFrame& frame, std::vector<uint8_t>& out);
+bool writeAovFrame(const std::filesystem::path& path, const OutputFrame& frame);
+
+// float -> half (最近接偶数丸め, 非正規化数・Inf・NaN も扱う)
+uint16_t floatToHalf(float value);
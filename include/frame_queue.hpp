@@ -0,0 +1,52 @@
+#pragma once
+#include "frame_output.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 読み戻したフレームを書き出しスレッドへ渡すキュー
+// push はピクセルをコピーしてすぐ戻るので、エンコードや書き込みの間に GPU は次のフレームを描ける
+// consumer は書き出しスレッドで push した順に呼ばれる
+struct FrameQueue {
+    using Consumer = std::function<void(uint32_t index, const OutputFrame& frame)>;
+
+    explicit FrameQueue(Consumer frameConsumer, size_t maxPendingFrames = 3);
+    ~FrameQueue();
+    FrameQueue(const FrameQueue&) = delete;
+    FrameQueue& operator=(const FrameQueue&) = delete;
+
+    // maxPendingFrames 溜まっていたら空くまで待つ
+    void push(uint32_t index, const OutputFrame& frame);
+    // 残りをすべて書き切ってスレッドを止める
+    void finish();
+
+private:
+    struct Job {
+        uint32_t index = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> ldr;
+        std::vector<float> hdr;
+        std::vector<float> albedo;
+        std::vector<float> normal;
+        std::vector<float> depth;
+        std::vector<uint32_t> ids;
+        std::vector<float> variance;
+    };
+
+    void run();
+
+    Consumer consumer;
+    size_t maxPending;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Job> pending;
+    std::vector<Job> spare;     // 書き終えたジョブのバッファを使い回す
+    bool stopping = false;
+    std::thread worker;
+};
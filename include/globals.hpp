@@ -3,7 +3,10 @@
 #include <vulkan/vulkan.hpp>
 
 #include "buffer.hpp"
+#include "shader_constants.hpp"
 #include "accel.hpp"
+#include "scene.hpp"
+#include "scene_cache.hpp"
 #include <GLFW/glfw3.h>
 
 #include <stb_image.h>
@@ -15,10 +18,6 @@
 #include <glm/gtx/norm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <nlohmann/json.hpp>
-#define TINYGLTF_NO_INCLUDE_JSON
-#define TINYGLTF_NO_STB_IMAGE_WRITE
-#include <tiny_gltf.h>
 
 
 inline constexpr uint32_t MAX_FRAMES = 2;
@@ -30,38 +29,33 @@ extern bool enableValidationLayers;
 uint32_t alignUp(uint32_t size, uint32_t alignment);
 
 struct Mat4x4{ float v[4][4]; };
-struct Vertex{
-    alignas(16) glm::vec3 pos;
-    alignas(16) glm::vec3 normal;
-    alignas(16) glm::vec2 texCoord;
-};
-struct Material{
-    int baseColorTextureIndex = -1;
-    int matallicRoughnessTextureIndex = -1;
-    int normalTextureIndex = -1;
-    int occulusionTextureIndex = -1;
-    int emissiveTextureIndex = -1;
-
-    float metallicFactor = 1.0f;
-    float roughnessFactor = 1.0f;
-    float transmission = 1.0f;
-    float ior = 1.5f;
-
-    alignas(16) glm::vec4 baseColorFactor = glm::vec4(1.0f);
-    alignas(16) glm::vec4 emissiveFactor = glm::vec4(1.0f);
-};
 struct Light {
     alignas(16) glm::vec4 dir;
     alignas(16) glm::vec4 color;
 };
-struct SceneUBO { Light sun; alignas(16) glm::vec4 camPos; };
+struct SceneUBO {
+    Light sun;
+    alignas(16) glm::vec4 camPos;     // w: tan(縦の画角 / 2)
+    alignas(16) glm::vec4 camForward;
+    alignas(16) glm::vec4 camRight;
+    alignas(16) glm::vec4 camUp;
+    alignas(16) glm::uvec4 sampling; // x: pass, y: samplesPerPass, z: activePixels を使うか, w: AOV を書くか
+};
+// raygen の pathStats と同じ並び (common_types.slang の kStat*)
+// GPU 側は 32bit なのでパスごとに読んで 0 に戻す
+struct PathStats {
+    uint32_t paths;
+    uint32_t segments;
+    uint32_t rouletteKills;
+    uint32_t deadKills;
+};
 
 extern SceneUBO scene;
 extern void* sceneData;
-extern std::vector<Vertex> vertices;
-extern std::vector<uint32_t> indices;
-extern std::vector<Material> materials;
-extern std::vector<uint32_t> primitiveMaterialIndices;
+extern SceneAssets assets;
+extern CameraTimeline cameraTimeline;
+extern SceneCache sceneCache;
+extern SceneView sceneView;
 
 extern std::vector<const char*> extensions;
 
@@ -79,9 +73,13 @@ extern vk::Queue queue;
 extern uint32_t queueFamily;
 
 extern vk::UniqueCommandPool commandPool;
+extern vk::UniqueQueryPool timestampQueryPool;
 extern std::vector<vk::UniqueCommandBuffer> cmdBufs;
 
+extern vk::UniquePipelineCache pipelineCache;
 extern vk::UniquePipeline pipeline;
+// pipeline を作ったときの特殊化定数
+extern ShaderConstants pipelineConstants;
 extern vk::UniquePipelineLayout pipelineLayout;
 
 extern vk::UniqueShaderModule vertShader;
@@ -94,17 +92,66 @@ extern std::vector<vk::RayTracingShaderGroupCreateInfoKHR> shaderGroups;
 struct Buffer;
 struct AccelStruct;
 
+extern vk::UniqueImage hdrImage;
+extern vk::UniqueDeviceMemory hdrMemory;
+extern vk::UniqueImageView hdrView;
 extern vk::UniqueImage outputImage;
 extern vk::UniqueDeviceMemory outputMemory;
 extern vk::UniqueImageView outputView;
+extern vk::UniqueImage albedoImage;
+extern vk::UniqueDeviceMemory albedoMemory;
+extern vk::UniqueImageView albedoView;
+extern vk::UniqueImage normalImage;
+extern vk::UniqueDeviceMemory normalMemory;
+extern vk::UniqueImageView normalView;
+extern vk::UniqueImage depthImage;
+extern vk::UniqueDeviceMemory depthMemory;
+extern vk::UniqueImageView depthView;
+extern vk::UniqueImage idImage;
+extern vk::UniqueDeviceMemory idMemory;
+extern vk::UniqueImageView idView;
+
+extern vk::UniqueShaderModule tonemapShader;
+extern vk::UniqueDescriptorSetLayout tonemapDescSetLayout;
+extern vk::UniqueDescriptorPool tonemapDescPool;
+extern vk::UniqueDescriptorSet tonemapDescSet;
+extern vk::UniquePipelineLayout tonemapPipelineLayout;
+extern vk::UniquePipeline tonemapPipeline;
+
+// --temporal のときだけ作る。履歴はフレームごとに [0] と [1] を入れ替える
+extern std::vector<vk::UniqueImage> historyColorImages;
+extern std::vector<vk::UniqueDeviceMemory> historyColorMemorys;
+extern std::vector<vk::UniqueImageView> historyColorViews;
+extern std::vector<vk::UniqueImage> historyGeometryImages;
+extern std::vector<vk::UniqueDeviceMemory> historyGeometryMemorys;
+extern std::vector<vk::UniqueImageView> historyGeometryViews;
+
+extern vk::UniqueShaderModule temporalShader;
+extern vk::UniqueDescriptorSetLayout temporalDescSetLayout;
+extern vk::UniqueDescriptorPool temporalDescPool;
+extern std::vector<vk::UniqueDescriptorSet> temporalDescSets;
+extern vk::UniquePipelineLayout temporalPipelineLayout;
+extern vk::UniquePipeline temporalPipeline;
 
 extern Buffer vertexBuffer;
 extern Buffer indexBuffer;
 extern Buffer materialBuffer;
 extern Buffer materialIndexBuffer;
 extern Buffer sceneBuffer;
+extern Buffer sobolBuffer;
 
 extern Buffer outputBuffer;
+extern Buffer hdrBuffer;
+extern Buffer albedoBuffer;
+extern Buffer normalBuffer;
+extern Buffer depthBuffer;
+extern Buffer idBuffer;
+extern Buffer pathStatsBuffer;
+extern void* pathStatsData;
+extern Buffer pixelAccumBuffer;
+extern void* pixelAccumData;
+extern Buffer activePixelBuffer;
+extern void* activePixelData;
 
 extern std::vector<Buffer> textureBuffers;
 extern std::vector<Buffer> envTexBuffers;
@@ -134,5 +181,3 @@ extern vk::StridedDeviceAddressRegionKHR raygenRegion;
 extern vk::StridedDeviceAddressRegionKHR missRegion;
 extern vk::StridedDeviceAddressRegionKHR hitRegion;
 
-extern tinygltf::Model model;
-extern tinygltf::TinyGLTF loader;
@@ -0,0 +1,39 @@
+#pragma once
+#include "mapped_file.hpp"
+
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#define TINYGLTF_NO_INCLUDE_JSON
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#include <tiny_gltf.h>
+
+// glTF の画像。uri (外部ファイル) か、バッファ上のエンコード済みバイト列のどちらか
+struct GltfImage {
+    std::string uri;
+    std::string mimeType;
+    std::span<const uint8_t> bytes;
+};
+
+// .gltf / .glb をマップしたまま参照する。
+// tinygltf には JSON 部分だけを読ませ、バッファの中身はコピーせずに buffers[i] から引く
+// (model.buffers[i].data と model.images は使わない)
+struct GltfSource {
+    tinygltf::Model model;
+    std::vector<std::span<const uint8_t>> buffers;
+    std::vector<GltfImage> images;
+    std::vector<std::filesystem::path> sourceFiles;
+
+    // buffers / images が指す先の持ち主
+    std::vector<MappedFile> mappings;
+    std::vector<std::vector<unsigned char>> ownedBuffers;
+};
+
+// 拡張子ではなく先頭のマジックで GLB かどうかを判定する
+bool openGltf(const std::filesystem::path& path, GltfSource& source, std::string& err);
+
+// model.buffers[i].data をそのまま参照する (メモリ上で組み立てたモデル用)
+std::vector<std::span<const uint8_t>> modelBufferSpans(const tinygltf::Model& model);
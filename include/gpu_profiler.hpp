@@ -0,0 +1,14 @@
+#pragma once
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+#include <vulkan/vulkan.hpp>
+
+// Vulkan の timestamp query で GPU 区間を profiler の GPU トラックに積む
+// timestamp 非対応のデバイスでは全部 no-op になる
+void createTimestampQueryPool();
+
+// コマンドバッファの先頭で呼ぶ (クエリをリセット)
+void gpuTimerBegin(vk::CommandBuffer cmdBuf);
+void gpuZoneBegin(vk::CommandBuffer cmdBuf, const char* name);
+void gpuZoneEnd(vk::CommandBuffer cmdBuf);
+// フェンス待ちの後で呼ぶ。submitUs は submit したときの profiler.nowUs()
+void gpuTimerCollect(double submitUs);
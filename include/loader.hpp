@@ -1,8 +1,10 @@
 #pragma once
 #include <glm/glm.hpp>
+#include <filesystem>
 #include <iostream>
 
-void loadModel(std::string resourcePath);
-void loadTexture(std::string resourcePath);
-void loadMaterial();
-void loadResources(std::filesystem::path exeDir);
\ No newline at end of file
+void uploadGeometry();
+void uploadTextures();
+void uploadEnvMap();
+void uploadMaterials();
+void loadResources(std::filesystem::path exeDir);
@@ -0,0 +1,29 @@
+#pragma once
+#include "scene.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 1x1 までの段数
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+inline uint32_t mipExtent(uint32_t size, uint32_t level){
+    uint32_t s = size >> level;
+    return s > 0 ? s : 1;
+}
+
+// BC 形式の 4x4 ブロック1つのバイト数 (RGBA8 は 0)
+size_t textureBlockBytes(TextureFormat format);
+
+// level 段目のバイト数。BC 形式は端のブロックを切り上げて数える
+size_t mipLevelSize(uint32_t width, uint32_t height, uint32_t level, TextureFormat format = TextureFormat::RGBA8);
+
+// TextureData::pixels 内の level 段目の先頭
+size_t mipLevelOffset(uint32_t width, uint32_t height, uint32_t level, TextureFormat format = TextureFormat::RGBA8);
+
+// level 0 だけ入った RGBA8 の textures にミップチェーンを追加する。
+// 2x2 のボックスフィルタ (奇数サイズの端は 3 texel をまとめる) で、srgb[i] が true のテクスチャは RGB を線形空間で平均する
+// srgb は textures と同じ画像番号の並び (srgbTextureFlags)
+// 行単位でスレッドに分ける
+void generateMips(std::vector<TextureData>& textures, const std::vector<bool>& srgb);
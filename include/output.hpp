@@ -1,4 +1,8 @@
 #pragma once
 
 void createOutputBuffer();
+// テンポラル累積の履歴画像 (--temporal のときだけ)
+void createTemporalHistory();
+void createPathStatsBuffer();
+void createAdaptiveBuffers();
 void saveImage();
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// 小さい処理はスレッドを立てるより直接回したほうが速い
+inline constexpr uint32_t kMinRowsPerThread = 32;
+
+// [0, rows) を連続した範囲に分けて fn(begin, end) をスレッドで並列に呼ぶ
+// 1 要素が重い処理 (PNG のストリップなど) は minRowsPerThread を小さくする
+template<typename Fn>
+void parallelRows(uint32_t rows, Fn&& fn, uint32_t minRowsPerThread = kMinRowsPerThread){
+    uint32_t hw = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t threads = std::min(hw, rows / std::max(1u, minRowsPerThread));
+    if(threads <= 1){
+        fn(0u, rows);
+        return;
+    }
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for(uint32_t t = 0; t < threads; t++){
+        uint32_t begin = rows * t / threads;
+        uint32_t end = rows * (t + 1) / threads;
+        pool.emplace_back([&fn, begin, end]{ fn(begin, end); });
+    }
+    for(auto& th : pool) th.join();
+}
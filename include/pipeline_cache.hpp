@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+// vk::PipelineCache の中身をディスクに残す (cache/pipeline.cache)
+// ドライバは壊れた・別の GPU のデータを渡されても黙って捨てるとは限らないので、
+// 書いたときの GPU とドライバを自前のヘッダに記録し、一致するときだけ渡す
+
+// ファイル形式を変えたら上げる
+inline constexpr uint32_t kPipelineCacheFileVersion = 1;
+
+// VkPhysicalDeviceProperties から取る
+struct PipelineCacheKey {
+    uint32_t vendorID = 0;
+    uint32_t deviceID = 0;
+    uint32_t driverVersion = 0;
+    uint8_t pipelineCacheUUID[16] = {};
+};
+
+// 無い/別の GPU やドライバ/壊れている場合は false (data は空)
+bool readPipelineCache(const std::filesystem::path& path, const PipelineCacheKey& key, std::vector<uint8_t>& data);
+// 一時ファイルに書いてから置き換える
+bool writePipelineCache(const std::filesystem::path& path, const PipelineCacheKey& key, std::span<const uint8_t> data);
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// RGBA8 の PNG エンコーダ
+// 画像を行ストリップに分けて並列に deflate する。各ストリップは直前 32KB を辞書として使い、
+// 末尾を sync flush (空の stored ブロック) でバイト境界に揃えるのでそのまま連結できる
+struct PngOptions {
+    // 速度とサイズの調整。0: 無圧縮, 1: 最速 (Sub 固定, 貪欲マッチ) ... 9: 最小 (長いハッシュチェーン)
+    int level = 6;
+    // 1 ストリップあたりのフィルタ後のバイト数の目安。小さいほど並列度が上がり圧縮率は下がる
+    uint32_t stripBytes = 256 * 1024;
+};
+
+bool encodePng(std::span<const uint8_t> rgba, uint32_t width, uint32_t height, const PngOptions& options, std::vector<uint8_t>& out);
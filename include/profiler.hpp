@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// CPU/GPU のフェーズ計測。Vulkan に依存しないので GPU が無くても CPU 側のゾーンは取れる
+struct ProfileEvent {
+    std::string name;
+    uint32_t track;       // kTrackCpu / kTrackGpu / kTrackWriter
+    uint32_t frame;
+    double startUs;
+    double durationUs;
+};
+
+inline constexpr uint32_t kTrackCpu = 0;
+inline constexpr uint32_t kTrackGpu = 1;
+inline constexpr uint32_t kTrackWriter = 2;   // フレーム書き出しスレッド (FrameQueue)
+inline constexpr uint32_t kNoFrame = 0xFFFFFFFFu;
+
+struct Profiler {
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    std::vector<ProfileEvent> events;
+    std::atomic<uint32_t> frame{kNoFrame};
+    std::mutex mutex;     // events は書き出しスレッドからも足される
+
+    double nowUs() const;
+    // eventFrame が kNoFrame なら今の frame を付ける
+    void addEvent(const char* name, uint32_t track, double startUs, double durationUs, uint32_t eventFrame = kNoFrame);
+
+    // chrome://tracing / Perfetto で読める trace_event 形式
+    bool writeChromeTrace(const std::filesystem::path& path) const;
+    // 名前ごとの min / median / p99
+    void printSummary() const;
+};
+
+extern Profiler profiler;
+
+// ProfileZone がこのスレッドで記録するトラックとフレーム番号。メインスレッド以外で計測するときに設定する
+struct ProfileThread {
+    uint32_t track = kTrackCpu;
+    uint32_t frame = kNoFrame;
+};
+
+extern thread_local ProfileThread profileThread;
+
+struct ProfileZone {
+    const char* name;
+    double startUs;
+
+    explicit ProfileZone(const char* zoneName);
+    ~ProfileZone();
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
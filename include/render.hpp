@@ -1,3 +1,23 @@
 #pragma once
+#include "frame_output.hpp"
+#include "video_output.hpp"
+#include "shader_constants.hpp"
 
-void drawCall(std::filesystem::path exePath);
\ No newline at end of file
+#include <filesystem>
+
+// 実行ごとの設定 (main の引数から作る)
+struct RenderOptions {
+    OutputFormat outputFormat = OutputFormat::Png;
+    bool writeImages = true;                // false なら連番画像を書かない (動画だけ欲しいとき)
+    VideoSink videoSink = VideoSink::None;
+    std::filesystem::path videoPath;        // 空なら defaultVideoPath
+    bool denoise = false;                   // CPU の à-trous フィルタを掛けてから書き出す
+    bool writeAovs = false;                 // アルベド・法線・深度・id を NNN_aov.exr に書く
+    bool temporal = false;                  // 前フレームの結果を再投影して累積する (--spp と組み合わせる)
+    uint32_t maxSamples = 0;                // 0 以外なら画素あたりの最大サンプル数を上書き (--spp)
+    bool resume = false;                    // render.checkpoint に記録どおり残っているフレームを飛ばし、止まったフレームの続きから描く
+    ShaderConstants shaderConstants;        // raygen の特殊化定数 (--max-depth / --rr-depth / --no-nee / --no-roulette / --stats)
+    bool watchShaders = false;              // シェーダの変更を監視し、RT パイプラインを作り直して今のフレームを描き直す
+};
+
+void drawCall(std::filesystem::path exePath, const RenderOptions& options);
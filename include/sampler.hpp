@@ -0,0 +1,37 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// raygen の sobolMatrices と同じ次元数 (random.slang の kSobolDimensions)
+// next1D / next2D は padding で使い回すので 0, 1 次元目しか使わない
+inline constexpr uint32_t kSobolDimensions = 2;
+inline constexpr uint32_t kSobolBits = 32;
+
+// 次元ごとに 32 本の生成行列の列 (MSB 揃え) を並べたテーブル
+std::vector<uint32_t> buildSobolMatrices(uint32_t dimensions = kSobolDimensions);
+
+// ---- random.slang の CPU 版 ----
+
+uint32_t hashWang(uint32_t key);
+// 旧 raygen の pcg ホワイトノイズ (sampler_eval の比較用。シェーダ側にはもうない)
+uint32_t pcg(uint32_t& state);
+float randFloat(uint32_t& state);
+
+uint32_t sobol(const std::vector<uint32_t>& matrices, uint32_t index, uint32_t dim);
+uint32_t nestedUniformScramble(uint32_t x, uint32_t seed);
+uint32_t hashCombine(uint32_t seed, uint32_t v);
+
+// util.slang の sampleGGX (ローカル座標のハーフベクトル)
+std::array<float, 3> sampleGGX(float roughness, float u, float v);
+
+// Owen scramble した Sobol 列。次元は2つずつ、毎回別のシードで index をシャッフルして使う
+struct SobolSampler {
+    const std::vector<uint32_t>* matrices;
+    uint32_t index;
+    uint32_t seed;
+    uint32_t dimension = 0;
+
+    float next1D();
+    void next2D(float& u, float& v);
+};
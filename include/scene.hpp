@@ -0,0 +1,98 @@
+#pragma once
+#include "scene_types.hpp"
+#include "camera_timeline.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+// Vulkan に依存しないシーン表現。ロードと前処理はここまでで完結し、
+// GPU へのアップロードは loader.cpp (Vulkan バックエンド) が行う
+
+// テクスチャの格納形式。BC* は 4x4 ブロック圧縮 (texture_compress.hpp)
+enum class TextureFormat : uint32_t {
+    RGBA8,
+    BC1,
+    BC4,
+    BC5,
+    BC7,
+};
+
+// pixels には level 0 から mipLevels 段を順に詰める (mipmap.hpp)
+struct TextureData {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipLevels = 1;
+    TextureFormat format = TextureFormat::RGBA8;
+    bool srgb = false;  // baseColor / emissive。GPU では sRGB 形式で作ってハードウェアでデコードする
+    std::vector<uint8_t> pixels;
+};
+
+// 6面のキューブマップ (RGBA32F, 面ごとに詰める)
+struct EnvMapData {
+    uint32_t faceSize = 0;
+    std::vector<float> faces;
+};
+
+struct SceneAssets {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> primitiveMaterialIndices;
+    std::vector<Material> materials;
+    std::vector<TextureData> textures;
+    EnvMapData envMap;
+    std::vector<CameraKey> cameraKeys;  // glTF のカメラ (無ければ空)
+
+    // 読み込んだ入力ファイル (シーンキャッシュの検証に使う)
+    std::vector<std::string> sourceFiles;
+    // 有無で読み込み結果が変わるファイル (mesh/test.glb, .mtex)。無いことも含めて記録する
+    std::vector<std::string> probedFiles;
+};
+
+// アップロード側が読むのはこちら。SceneAssets か、mmap したシーンキャッシュを指す
+struct TextureView {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipLevels = 1;
+    TextureFormat format = TextureFormat::RGBA8;
+    bool srgb = false;
+    std::span<const uint8_t> pixels;
+};
+
+struct SceneView {
+    std::span<const Vertex> vertices;
+    std::span<const uint32_t> indices;
+    std::span<const uint32_t> primitiveMaterialIndices;
+    std::span<const Material> materials;
+    std::vector<TextureView> textures;
+    uint32_t envFaceSize = 0;
+    std::span<const float> envFaces;
+    std::span<const CameraKey> cameraKeys;
+};
+
+SceneView makeSceneView(const SceneAssets& assets);
+
+inline constexpr uint32_t kEnvFaceSize = 1024;
+
+struct GltfSource;
+
+// glTF の画像を RGBA8 で読み込んでミップを作る。読んだ画像ファイルは sourceFiles に足す
+bool loadTextures(
+    const GltfSource& gltf, const std::filesystem::path& textureDir, const std::vector<Material>& materials,
+    std::vector<TextureData>& textures, std::vector<std::string>& sourceFiles);
+
+// シーンファイルの横に置く圧縮済みテクスチャ (mesh/test.mtex)
+std::filesystem::path textureContainerPath(const std::filesystem::path& scenePath);
+
+// 圧縮済みテクスチャが古くないかの照合に使う、画像とマテリアルからの参照のハッシュ。
+// 外部画像のパスは sourceFiles に足す
+bool textureSourceHash(
+    const GltfSource& gltf, const std::filesystem::path& textureDir, const std::vector<Material>& materials,
+    uint64_t& hash, std::vector<std::string>& sourceFiles);
+
+// mesh/test.glb があればそれを、無ければ mesh/test.gltf を使う
+std::filesystem::path findSceneFile(const std::filesystem::path& resourceDir);
+
+// resourceDir 以下のシーン、texture/ (または圧縮済みの mesh/test.mtex), envmap/env.hdr を読み込む。失敗時は false
+bool loadScene(const std::filesystem::path& resourceDir, SceneAssets& assets);
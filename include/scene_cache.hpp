@@ -0,0 +1,25 @@
+#pragma once
+#include "scene.hpp"
+#include "mapped_file.hpp"
+
+#include <filesystem>
+#include <span>
+
+// シーンキャッシュのバイナリ形式を変えたら上げる
+inline constexpr uint32_t kSceneCacheVersion = 7;
+
+// mmap したシーンキャッシュ。view はマップを開いている間だけ有効
+struct SceneCache {
+    MappedFile file;
+    SceneView view;
+
+    // キャッシュを開いて入力ファイルと照合する。無い/古い/壊れている場合は false
+    bool open(const std::filesystem::path& path);
+};
+
+// 最初のロード後に書き出す。入力ファイルのサイズ・mtime・内容ハッシュも記録する
+// probedFiles は有無も記録し、現れた・消えた・変わったときはキャッシュを使わない
+bool writeSceneCache(const std::filesystem::path& path, const SceneAssets& assets);
+
+// FNV-1a 64bit
+uint64_t hashBytes(std::span<const uint8_t> bytes);
@@ -0,0 +1,32 @@
+#pragma once
+#include "scene_types.hpp"
+#include "camera_timeline.hpp"
+#include <span>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#define TINYGLTF_NO_INCLUDE_JSON
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#include <tiny_gltf.h>
+
+// tinygltf のモデルから頂点/インデックス/三角形ごとのマテリアル番号を追記する
+// アクセサは buffers[i] (model.buffers[i] の中身、mmap 上でもよい) から直接読む
+// POSITION が無い、属性が FLOAT の VEC3/VEC2 でない (正規化・量子化・sparse)、
+// 未対応のインデックス型や範囲外のアクセサがあれば false
+bool decodeGeometry(
+    const tinygltf::Model& model,
+    std::span<const std::span<const uint8_t>> buffers,
+    std::vector<Vertex>& vertices,
+    std::vector<uint32_t>& indices,
+    std::vector<uint32_t>& primitiveMaterialIndices);
+
+// テクスチャ番号は textures[i].source を引いた画像番号にする (無い・範囲外のテクスチャなら -1)
+std::vector<Material> translateMaterials(const tinygltf::Model& model);
+
+// 最初の透視投影カメラのノードから、その translation / rotation アニメーションのキー時刻ごとに
+// カメラのキーを作る (アニメーションが無ければ 1 つ)。カメラが無ければ keys は空で true
+// 範囲外のアクセサや float 以外のキーがあれば false
+bool decodeCameraKeys(
+    const tinygltf::Model& model,
+    std::span<const std::span<const uint8_t>> buffers,
+    std::vector<CameraKey>& keys);
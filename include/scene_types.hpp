@@ -0,0 +1,25 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// GPU にそのまま送るシーンデータ (common_bindings.slang と同じレイアウト)
+struct Vertex{
+    alignas(16) glm::vec3 pos;
+    alignas(16) glm::vec3 normal;
+    alignas(16) glm::vec2 texCoord;
+};
+// *TextureIndex は glTF の画像番号 (textures[] の並び)。テクスチャ番号ではない
+struct Material{
+    int baseColorTextureIndex = -1;
+    int matallicRoughnessTextureIndex = -1;
+    int normalTextureIndex = -1;
+    int occulusionTextureIndex = -1;
+    int emissiveTextureIndex = -1;
+
+    float metallicFactor = 1.0f;
+    float roughnessFactor = 1.0f;
+    float transmission = 1.0f;
+    float ior = 1.5f;
+
+    alignas(16) glm::vec4 baseColorFactor = glm::vec4(1.0f);
+    alignas(16) glm::vec4 emissiveFactor = glm::vec4(1.0f);
+};
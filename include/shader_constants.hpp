@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+
+// raygen の特殊化定数 (common_types.slang の vk::constant_id と同じ並び、すべて 4 バイト)
+// パイプライン作成時に値が決まるので、シェーダを作り直さずに品質と速度の設定を変えられる
+struct ShaderConstants {
+    uint32_t maxDepth = 5;              // 最大バウンス数
+    uint32_t rouletteMinDepth = 2;      // この深さ以降はロシアンルーレットで打ち切る
+    uint32_t sunNee = 1;                // 0 なら太陽の NEE を行わず BSDF サンプリングだけで拾う
+    uint32_t russianRoulette = 1;       // 0 ならロシアンルーレットを行わない
+    uint32_t pathStats = 0;             // 1 なら pathStats にパスの統計を数える (--stats)。出力には影響しない
+
+    bool operator==(const ShaderConstants&) const = default;
+};
+inline constexpr uint32_t kShaderConstantCount = sizeof(ShaderConstants) / sizeof(uint32_t);
+static_assert(sizeof(ShaderConstants) == kShaderConstantCount * sizeof(uint32_t), "ShaderConstants must be packed uint32 values");
@@ -0,0 +1,56 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// --watch-shaders: シェーダのディレクトリの *.slang を監視し、変わったら書き出しとは別のスレッドで slangc を走らせる
+// 全部のコンパイルが通ったときだけ結果を渡す。失敗したら今のシェーダのまま次の変更を待つ
+
+// slangc の引数 (CMakeLists.txt の add_custom_command と同じ)
+struct ShaderCompileJob {
+    std::string name;       // ソースは <name>.slang、出力は <name>.spv
+    std::string entry;
+    std::string stage;
+};
+
+struct ShaderBinary {
+    std::string name;
+    std::vector<uint32_t> code;
+};
+
+struct ShaderWatcher {
+    ShaderWatcher(std::filesystem::path shaderDir, std::filesystem::path outDir,
+                  std::string slangc, std::string profile, std::vector<ShaderCompileJob> jobs);
+    ~ShaderWatcher();
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    // 前回から新しくコンパイルできていれば binaries に入れて true (jobs と同じ順)
+    bool poll(std::vector<ShaderBinary>& binaries);
+    void stop();
+
+private:
+    using Stamps = std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>>;
+
+    Stamps scan() const;
+    bool compile(std::vector<ShaderBinary>& binaries) const;
+    void run();
+
+    std::filesystem::path shaderDir;
+    std::filesystem::path outDir;
+    std::string slangc;
+    std::string profile;
+    std::vector<ShaderCompileJob> jobs;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool stopping = false;
+    bool ready = false;
+    std::vector<ShaderBinary> compiled;
+    std::thread worker;
+};
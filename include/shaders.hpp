@@ -1,8 +1,20 @@
 #pragma once
 #include "globals.hpp"
+#include "shader_watch.hpp"
 #include <iostream>
+#include <memory>
 
 void prepareShaders();
-void addShader(uint32_t shaderIndex, const std::string& filename, vk::ShaderStageFlagBits stage);
-void createRayTracingPipeline();
-void createShaderBindingTable();
\ No newline at end of file
+// path が空ならディスクのキャッシュを使わない (--no-pipeline-cache)
+void createPipelineCache(const std::filesystem::path& path);
+// 全パイプラインを作った後に呼ぶ。内容が変わっていれば書き戻す
+void savePipelineCache(const std::filesystem::path& path);
+// constants でパイプラインと SBT を作る。今のパイプラインと同じ定数なら何もしない (pipelineCache を使う)
+void createRayTracingPipeline(const ShaderConstants& constants);
+
+// --watch-shaders: RT パイプラインのシェーダ (prepareShaders と同じ並び) を監視してコンパイルする
+// 出力は outDir/<name>.spv
+std::unique_ptr<ShaderWatcher> createShaderWatcher(const std::filesystem::path& outDir);
+// 新しくコンパイルできていれば、シェーダモジュールと RT パイプライン・SBT だけを作り直して true
+// ジオメトリ・テクスチャ・AS・デスクリプタはそのまま使うので、バインディングを変える変更には使えない
+bool reloadRayTracingShaders(ShaderWatcher& watcher, const ShaderConstants& constants);
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+#include "globals.hpp"
+#include "temporal_reproject.hpp"
+
+// hdrImage + AOV + 履歴 -> hdrImage の compute パイプラインとディスクリプタを作る (createTemporalHistory の後)
+void createTemporalPipeline();
+
+// hdrImage, normalImage, depthImage と履歴画像は General に遷移済みで呼ぶ
+// historyIndex 側の履歴に書き、もう片方を前フレームの履歴として読む
+void recordTemporal(vk::CommandBuffer cmdBuf, const TemporalParams& params, uint32_t historyIndex);
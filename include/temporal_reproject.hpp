@@ -0,0 +1,47 @@
+#pragma once
+#include "scene.hpp"
+
+#include <cstdint>
+#include <span>
+
+// 前フレームの累積結果を今のフレームへ再投影して混ぜる (静的シーン + 動くカメラ)
+// GPU 版は temporal.slang。ここは同じ式の CPU 版 (検証とベンチマーク用)
+
+// temporal.slang の TemporalCamera と同じ並び
+struct TemporalCamera {
+    float position[4];  // w: tan(画角 / 2)
+    float forward[4];   // w: アスペクト比 (幅 / 高さ)
+    float right[4];
+};
+
+// temporal.slang の push constant と同じ並び (128 バイト以内)
+struct TemporalParams {
+    TemporalCamera current;
+    TemporalCamera previous;
+    float minBlend = 0.1f;          // 新しいフレームの重みの下限 (累積は実質 1 / minBlend フレーム)
+    float depthTolerance = 0.05f;   // 再投影した深度と履歴の深度の相対誤差の上限
+    float normalThreshold = 0.9f;   // 法線の内積の下限
+    uint32_t historyValid = 0;      // 0 なら履歴を捨てる (最初のフレーム)
+};
+static_assert(sizeof(TemporalParams) <= 128, "TemporalParams must fit in the push constant range");
+
+TemporalCamera makeTemporalCamera(const CameraView& view, uint32_t width, uint32_t height);
+
+// 累積の状態。どちらも RGBA32F
+// color: rgb + 累積フレーム数, geometry: ワールド法線 xyz + 線形深度 (背景は 0)
+struct TemporalHistoryView {
+    std::span<const float> color;
+    std::span<const float> geometry;
+};
+
+struct TemporalHistory {
+    std::span<float> color;
+    std::span<float> geometry;
+};
+
+// current: 今のフレームの HDR (RGBA32F), normal: RGBA32F, depth: R32F (AOV と同じ形式)
+// next に新しい履歴を書き、output に混ぜた HDR を書く (current と同じ領域でもよい)
+void temporalAccumulate(
+    std::span<const float> current, std::span<const float> normal, std::span<const float> depth,
+    uint32_t width, uint32_t height, const TemporalParams& params,
+    const TemporalHistoryView& previous, const TemporalHistory& next, std::span<float> output);
@@ -0,0 +1,33 @@
+#pragma once
+#include "scene.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// 4x4 ブロック圧縮。block は RGBA8 の 16 画素 (行優先 64 バイト)
+void encodeBC1Block(const uint8_t* block, uint8_t* out);                   // RGB, 8 バイト
+void encodeBC4Block(const uint8_t* block, uint32_t channel, uint8_t* out); // 1ch, 8 バイト
+void encodeBC5Block(const uint8_t* block, uint8_t* out);                   // RG, 16 バイト
+void encodeBC7Block(const uint8_t* block, uint8_t* out);                   // RGBA (mode 6), 16 バイト
+
+// ミップチェーン付きの RGBA8 テクスチャを format に圧縮する (ブロック行ごとに並列)
+TextureData compressTexture(const TextureData& src, TextureFormat format);
+
+// マテリアルでの使われ方から画像ごとの形式を決める (Material の番号は画像番号、textureCount は画像の数)
+//   baseColor / emissive: BC7 (preferBC1 なら BC1), normal / metallicRoughness: BC5, occlusion: BC4
+// metallicRoughness を BC5 にすると R/G だけが残り B は捨てる。shading.slang は metallic を .r、roughness を .g から読む
+// (glTF の規約では metallic は B) ので、圧縮しても非圧縮と同じ値になる。読むチャンネルを変えるときはここも直す
+std::vector<TextureFormat> chooseTextureFormats(const std::vector<Material>& materials, size_t textureCount, bool preferBC1);
+
+// baseColor / emissive は sRGB で格納されている。結果は画像番号で引く (textures / generateMips の srgb と同じ並び)
+// normal / metallicRoughness / occlusion の画像は線形のまま読むので false
+std::vector<bool> srgbTextureFlags(const std::vector<Material>& materials, size_t textureCount);
+
+// 圧縮済みテクスチャのコンテナ (.mtex)。形式を変えたら上げる
+// 各テクスチャは chooseTextureFormats の形式のまま格納する (BC5 の metallicRoughness は R/G だけ)
+inline constexpr uint32_t kTextureContainerVersion = 1;
+
+// sourceHash はテクスチャの入力の内容ハッシュ (textureSourceHash)。読み込み時に一致しなければ使わない
+bool writeTextureContainer(const std::filesystem::path& path, uint64_t sourceHash, const std::vector<TextureData>& textures);
+bool readTextureContainer(const std::filesystem::path& path, uint64_t sourceHash, std::vector<TextureData>& textures);
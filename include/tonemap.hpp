@@ -0,0 +1,9 @@
+#pragma once
+#include "globals.hpp"
+#include "tonemap_curve.hpp"
+
+// hdrImage -> outputImage の compute パイプラインとディスクリプタを作る (createOutputBuffer の後)
+void createTonemapPipeline();
+
+// hdrImage は General、outputImage は General に遷移済みで呼ぶ
+void recordTonemap(vk::CommandBuffer cmdBuf, const TonemapParams& params);
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <span>
+
+enum TonemapOperator : uint32_t {
+    kTonemapClamp = 0,  // 露出を掛けて [0,1] に切り詰めるだけ
+    kTonemapAces = 1,
+};
+
+// tonemap.slang の push constant と同じ並び
+struct TonemapParams {
+    float exposure = 1.0f;
+    uint32_t tonemapOperator = kTonemapAces;
+};
+
+// tonemap.slang と同じ変換の CPU 版 (CPU でデノイズしたフレーム用)
+// hdr: RGBA32F, ldr: RGBA8。アルファは 255
+void tonemapFrame(std::span<const float> hdr, uint32_t width, uint32_t height, const TonemapParams& params, std::span<uint8_t> ldr);
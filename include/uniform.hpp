@@ -1,3 +1,4 @@
 #pragma once
 
-void createUniformBuffer();
\ No newline at end of file
+void createUniformBuffer();
+void createSobolBuffer();
\ No newline at end of file
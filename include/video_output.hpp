@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// 動画の書き出し先 (maple --video で選ぶ)
+enum class VideoSink : uint32_t {
+    None,
+    Ffmpeg,     // ffmpeg の stdin に生の RGBA を流して H.264 (yuv420p) にする
+    Y4m,        // YUV4MPEG2 (4:2:0, BT.601 limited) を直接書く。外部ツール不要
+};
+
+bool parseVideoSink(std::string_view name, VideoSink& sink);
+const char* videoSinkName(VideoSink sink);
+// --video-out を指定しなかったときの出力先
+const char* defaultVideoPath(VideoSink sink);
+
+// RGBA8 -> I420 (Y, U, V の平面を続けて out に入れる)。色差は 2x2 の平均
+void rgbaToI420(std::span<const uint8_t> rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& out);
+
+struct VideoWriter {
+    VideoSink sink = VideoSink::None;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t frameCount = 0;
+    std::FILE* fp = nullptr;        // ffmpeg ならパイプ
+    std::vector<uint8_t> scratch;   // I420 変換先
+
+    VideoWriter() = default;
+    ~VideoWriter();
+    VideoWriter(const VideoWriter&) = delete;
+    VideoWriter& operator=(const VideoWriter&) = delete;
+
+    bool open(VideoSink videoSink, const std::filesystem::path& path, uint32_t frameWidth, uint32_t frameHeight, uint32_t fps);
+    // rgba は width * height * 4 バイト
+    bool write(std::span<const uint8_t> rgba);
+    // ffmpeg は終了を待つ。ffmpeg がエラーで終わったときも false
+    bool close();
+};
@@ -1,4 +1,6 @@
 #include "../include/accel.hpp"
+#include "../include/gpu_profiler.hpp"
+#include "../include/profiler.hpp"
 
 #define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
 #include <vulkan/vulkan.hpp>
@@ -55,16 +57,22 @@ void AccelStruct::init(
     std::vector<vk::UniqueCommandBuffer> cmdBufs = device.allocateCommandBuffersUnique(allocInfo);
     vk::CommandBufferBeginInfo cmdBeginInfo{};
     cmdBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    const char* zoneName = (type == vk::AccelerationStructureTypeKHR::eBottomLevel) ? "build BLAS" : "build TLAS";
     cmdBufs[0]->begin(cmdBeginInfo);
+    gpuTimerBegin(cmdBufs[0].get());
+    gpuZoneBegin(cmdBufs[0].get(), zoneName);
     cmdBufs[0]->buildAccelerationStructuresKHR(buildInfo, &buildRangeInfo);
+    gpuZoneEnd(cmdBufs[0].get());
     cmdBufs[0]->end();
     vk::CommandBuffer submitCmdBufs[1] = {cmdBufs[0].get()};
     vk::SubmitInfo submitInfo{};
     submitInfo.setCommandBufferCount(1);
     submitInfo.setPCommandBuffers(submitCmdBufs);
 
+    double submitUs = profiler.nowUs();
     queue.submit(submitInfo, nullptr);
     queue.waitIdle();
+    gpuTimerCollect(submitUs);
 
     vk::AccelerationStructureDeviceAddressInfoKHR addressInfo{};
     addressInfo.setAccelerationStructure(*accel);
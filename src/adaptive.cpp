@@ -0,0 +1,59 @@
+#include "../include/adaptive.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+uint32_t maxPasses(const AdaptiveConfig& config){
+    return (config.maxSamples + config.samplesPerPass - 1) / config.samplesPerPass;
+}
+
+bool isPixelConverged(const PixelAccum& p, const AdaptiveConfig& config){
+    if (p.flags & kPixelBackground) return true;
+    if (p.count >= config.maxSamples) return true;
+    if (p.count < config.minSamples || p.count < 2) return false;
+
+    // 平均の標準誤差 sqrt(s^2 / n)
+    double variance = double(p.lumM2) / double(p.count - 1);
+    double stdError = std::sqrt(variance / double(p.count));
+    // 暗い画素で閾値が0に潰れないように下限を入れる
+    double scale = std::max(double(p.lumMean), 1e-3);
+    return stdError <= double(config.relativeErrorThreshold) * scale;
+}
+
+uint32_t buildActivePixelList(
+    const PixelAccum* accum, uint32_t width, uint32_t height,
+    const AdaptiveConfig& config, std::vector<uint32_t>& active)
+{
+    active.clear();
+    const uint32_t pixelCount = width * height;
+    for (uint32_t i = 0; i < pixelCount; i++) {
+        if (!isPixelConverged(accum[i], config)) {
+            active.push_back(i);
+        }
+    }
+    return static_cast<uint32_t>(active.size());
+}
+
+bool validateActivePixelList(
+    const PixelAccum* accum, uint32_t width, uint32_t height,
+    const AdaptiveConfig& config, const std::vector<uint32_t>& active)
+{
+    const uint32_t pixelCount = width * height;
+    size_t cursor = 0;
+    for (uint32_t i = 0; i < pixelCount; i++) {
+        bool expected = !isPixelConverged(accum[i], config);
+        bool listed = cursor < active.size() && active[cursor] == i;
+        if (expected != listed) {
+            std::cerr << "[adaptive] mask mismatch at pixel (" << (i % width) << ", " << (i / width)
+                      << "): expected " << (expected ? "active" : "converged") << "\n";
+            return false;
+        }
+        if (listed) cursor++;
+    }
+    if (cursor != active.size()) {
+        std::cerr << "[adaptive] active list has " << (active.size() - cursor)
+                  << " out of range or unsorted entries\n";
+        return false;
+    }
+    return true;
+}
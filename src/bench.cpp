@@ -0,0 +1,437 @@
+// Vulkan を使わない CPU 側ホットパスのマイクロベンチマーク
+//   maple_bench [--gltf path] [--json out.json] [--iterations N]
+// 結果は JSON (標準出力 or --json のファイル) で出すので、最適化前後の比較に使える
+#include "../include/scene_decode.hpp"
+#include "../include/gltf_source.hpp"
+#include "../include/envmap.hpp"
+#include "../include/sampler.hpp"
+#include "../include/texture_compress.hpp"
+#include "../include/frame_output.hpp"
+#include "../include/png_encoder.hpp"
+#include "../include/denoise.hpp"
+#include "../include/tonemap_curve.hpp"
+#include "../include/temporal_reproject.hpp"
+
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// 1280x960 は render.cpp の出力解像度
+constexpr int kFrameWidth  = 1280;
+constexpr int kFrameHeight = 960;
+
+struct BenchResult {
+    std::string name;
+    uint64_t items;
+    std::vector<double> samplesNs;
+    uint64_t outputBytes = 0;   // エンコード系の出力サイズ (0 なら出さない)
+};
+
+// 最適化で計算が消えないように結果をここに流す
+volatile uint64_t gSink = 0;
+
+BenchResult measure(const std::string& name, uint64_t items, int iterations, const std::function<void()>& fn)
+{
+    fn(); // warmup
+    BenchResult r{name, items, {}};
+    r.samplesNs.reserve(iterations);
+    for (int i = 0; i < iterations; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        auto t1 = std::chrono::steady_clock::now();
+        r.samplesNs.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+    }
+    return r;
+}
+
+nlohmann::json toJson(const BenchResult& r)
+{
+    std::vector<double> s = r.samplesNs;
+    std::sort(s.begin(), s.end());
+    double mean = 0.0;
+    for (double v : s) mean += v;
+    mean /= double(s.size());
+    double median = s[s.size() / 2];
+    nlohmann::json j = {
+        {"name", r.name},
+        {"iterations", s.size()},
+        {"items", r.items},
+        {"min_ns", s.front()},
+        {"median_ns", median},
+        {"mean_ns", mean},
+        {"items_per_s", median > 0.0 ? double(r.items) * 1e9 / median : 0.0},
+    };
+    if (r.outputBytes) j["output_bytes"] = r.outputBytes;
+    return j;
+}
+
+template<typename T>
+int appendBufferView(tinygltf::Model& model, const std::vector<T>& data)
+{
+    auto& buffer = model.buffers[0];
+    size_t offset = buffer.data.size();
+    buffer.data.resize(offset + data.size() * sizeof(T));
+    std::memcpy(buffer.data.data() + offset, data.data(), data.size() * sizeof(T));
+
+    tinygltf::BufferView view;
+    view.buffer = 0;
+    view.byteOffset = offset;
+    view.byteLength = data.size() * sizeof(T);
+    model.bufferViews.push_back(view);
+    return int(model.bufferViews.size() - 1);
+}
+
+int appendAccessor(tinygltf::Model& model, int view, int componentType, int type, size_t count)
+{
+    tinygltf::Accessor accessor;
+    accessor.bufferView = view;
+    accessor.componentType = componentType;
+    accessor.type = type;
+    accessor.count = count;
+    model.accessors.push_back(accessor);
+    return int(model.accessors.size() - 1);
+}
+
+// grid x grid の格子を primitives 個に分けたメモリ上のモデル
+tinygltf::Model makeSyntheticModel(int grid, int primitives, int materialCount)
+{
+    tinygltf::Model model;
+    model.buffers.resize(1);
+    model.meshes.resize(1);
+
+    for (int p = 0; p < primitives; ++p) {
+        std::vector<float> pos, nrm, uv;
+        std::vector<uint32_t> idx;
+        for (int y = 0; y <= grid; ++y) {
+            for (int x = 0; x <= grid; ++x) {
+                float fx = float(x) / grid, fy = float(y) / grid;
+                pos.insert(pos.end(), {fx, float(p), fy});
+                nrm.insert(nrm.end(), {0.0f, 1.0f, 0.0f});
+                uv.insert(uv.end(), {fx, fy});
+            }
+        }
+        for (int y = 0; y < grid; ++y) {
+            for (int x = 0; x < grid; ++x) {
+                uint32_t i0 = y * (grid + 1) + x;
+                uint32_t i1 = i0 + 1;
+                uint32_t i2 = i0 + grid + 1;
+                uint32_t i3 = i2 + 1;
+                idx.insert(idx.end(), {i0, i2, i1, i1, i2, i3});
+            }
+        }
+        size_t vertexCount = pos.size() / 3;
+
+        tinygltf::Primitive prim;
+        prim.attributes["POSITION"] = appendAccessor(model, appendBufferView(model, pos),
+            TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, vertexCount);
+        prim.attributes["NORMAL"] = appendAccessor(model, appendBufferView(model, nrm),
+            TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, vertexCount);
+        prim.attributes["TEXCOORD_0"] = appendAccessor(model, appendBufferView(model, uv),
+            TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC2, vertexCount);
+        prim.indices = appendAccessor(model, appendBufferView(model, idx),
+            TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT, TINYGLTF_TYPE_SCALAR, idx.size());
+        prim.material = p % std::max(materialCount, 1);
+        model.meshes[0].primitives.push_back(prim);
+    }
+
+    for (int m = 0; m < materialCount; ++m) {
+        tinygltf::Material mat;
+        mat.pbrMetallicRoughness.baseColorFactor = {0.8, 0.2, 0.1, 1.0};
+        mat.pbrMetallicRoughness.metallicFactor = (m % 2) ? 1.0 : 0.0;
+        mat.pbrMetallicRoughness.roughnessFactor = 0.5;
+        mat.pbrMetallicRoughness.baseColorTexture.index = m % 4;
+        mat.emissiveFactor = {0.0, 0.0, 0.0};
+        tinygltf::Value::Object ior;
+        ior["ior"] = tinygltf::Value(1.45);
+        mat.extensions["KHR_materials_ior"] = tinygltf::Value(ior);
+        model.materials.push_back(mat);
+    }
+    return model;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string gltfPath;
+    std::string jsonPath;
+    int iterations = 10;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--gltf" && i + 1 < argc) gltfPath = argv[++i];
+        else if (arg == "--json" && i + 1 < argc) jsonPath = argv[++i];
+        else if (arg == "--iterations" && i + 1 < argc) iterations = std::max(1, std::atoi(argv[++i]));
+        else {
+            std::cerr << "usage: maple_bench [--gltf path] [--json out.json] [--iterations N]\n";
+            return 1;
+        }
+    }
+
+    std::vector<BenchResult> results;
+
+    // ---- glTF decode ----
+    // --gltf のときはアプリと同じくマップしたバッファから直接デコードする
+    GltfSource source;
+    if (!gltfPath.empty()) {
+        std::string err;
+        if (!openGltf(gltfPath, source, err)) {
+            std::cerr << "[gltf err] " << err << "\n";
+            return 1;
+        }
+    } else {
+        source.model = makeSyntheticModel(256, 8, 0);
+        source.buffers = modelBufferSpans(source.model);
+    }
+    const tinygltf::Model& model = source.model;
+    {
+        size_t vertexCount = 0;
+        for (const auto& mesh : model.meshes)
+            for (const auto& prim : mesh.primitives)
+                vertexCount += model.accessors[prim.attributes.at("POSITION")].count;
+
+        results.push_back(measure("gltf_decode", vertexCount, iterations, [&] {
+            std::vector<Vertex> vertices;
+            std::vector<uint32_t> indices, primitiveMaterialIndices;
+            decodeGeometry(model, source.buffers, vertices, indices, primitiveMaterialIndices);
+            gSink = gSink + vertices.size() + indices.size();
+        }));
+    }
+
+    // ---- material translation ----
+    {
+        tinygltf::Model matModel = gltfPath.empty() ? makeSyntheticModel(1, 1, 4096) : model;
+        results.push_back(measure("material_translate", matModel.materials.size(), iterations, [&] {
+            auto materials = translateMaterials(matModel);
+            gSink = gSink + materials.size();
+        }));
+    }
+
+    // ---- equirect -> cubemap ----
+    {
+        const int envW = 2048, envH = 1024;
+        const uint32_t faceSize = envH / 2;
+        std::vector<float> env(size_t(envW) * envH * 4);
+        uint32_t state = hashWang(1);
+        for (auto& v : env) v = randFloat(state);
+
+        results.push_back(measure("cubemap_convert", 6ull * faceSize * faceSize, iterations, [&] {
+            std::vector<float> cube;
+            convertEquirectToCubemap(env.data(), envW, envH, faceSize, cube);
+            gSink = gSink + uint64_t(cube[cube.size() / 2]);
+        }));
+    }
+
+    // ---- PNG encode ----
+    {
+        std::vector<uint8_t> frame(size_t(kFrameWidth) * kFrameHeight * 4);
+        for (int y = 0; y < kFrameHeight; ++y) {
+            for (int x = 0; x < kFrameWidth; ++x) {
+                uint8_t* p = &frame[(size_t(y) * kFrameWidth + x) * 4];
+                p[0] = uint8_t(x * 255 / kFrameWidth);
+                p[1] = uint8_t(y * 255 / kFrameHeight);
+                p[2] = uint8_t(hashWang(y * kFrameWidth + x) & 0x3f);
+                p[3] = 255;
+            }
+        }
+        uint64_t encodedBytes = 0;
+        results.push_back(measure("png_encode", uint64_t(kFrameWidth) * kFrameHeight, iterations, [&] {
+            encodedBytes = 0;
+            stbi_write_png_to_func(
+                [](void* ctx, void*, int size) { *static_cast<uint64_t*>(ctx) += uint64_t(size); },
+                &encodedBytes, kFrameWidth, kFrameHeight, 4, frame.data(), kFrameWidth * 4);
+            gSink = gSink + encodedBytes;
+        }));
+        results.back().outputBytes = encodedBytes;
+
+        // 並列エンコーダ (png_encoder) のレベルごとの速度とサイズ。png_encode (stb) と比べる
+        std::vector<uint8_t> encoded;
+        for (int level : {0, 1, 3, 6, 9}) {
+            PngOptions options;
+            options.level = level;
+            results.push_back(measure("png_level" + std::to_string(level) + "_encode", uint64_t(kFrameWidth) * kFrameHeight, iterations, [&] {
+                encodePng(frame, kFrameWidth, kFrameHeight, options, encoded);
+                gSink = gSink + encoded.size();
+            }));
+            results.back().outputBytes = encoded.size();
+        }
+
+        // HDR の出力形式 (--format)
+        std::vector<float> hdr(frame.size());
+        for (size_t i = 0; i < frame.size(); ++i) hdr[i] = float(frame[i]) * (4.0f / 255.0f);
+        // AOV は書かないので空のまま
+        OutputFrame out;
+        out.width = uint32_t(kFrameWidth);
+        out.height = uint32_t(kFrameHeight);
+        out.ldr = frame;
+        out.hdr = hdr;
+        for (OutputFormat format : {OutputFormat::Exr, OutputFormat::Pfm}) {
+            std::string name = std::string(outputFormatName(format)) + "_encode";
+            std::replace(name.begin(), name.end(), '-', '_');
+            results.push_back(measure(name, uint64_t(kFrameWidth) * kFrameHeight, iterations, [&] {
+                encodeFrame(format, out, encoded);
+                gSink = gSink + encoded.size();
+            }));
+            results.back().outputBytes = encoded.size();
+        }
+    }
+
+    // ---- デノイズ + CPU トーンマップ (--denoise) ----
+    {
+        const size_t pixels = size_t(kFrameWidth) * kFrameHeight;
+        std::vector<float> color(pixels * 4), albedo(pixels * 4), normal(pixels * 4);
+        for (int y = 0; y < kFrameHeight; ++y) {
+            for (int x = 0; x < kFrameWidth; ++x) {
+                size_t i = size_t(y) * kFrameWidth + x;
+                // 縦の帯ごとにアルベドと法線が変わる面にノイズを載せる
+                float a = ((x / 64) & 1) ? 0.8f : 0.2f;
+                float noise = float(hashWang(uint32_t(i)) & 0xff) * (1.0f / 128.0f);
+                for (int c = 0; c < 3; ++c) {
+                    albedo[i * 4 + c] = a;
+                    color[i * 4 + c] = a * noise;
+                }
+                color[i * 4 + 3] = albedo[i * 4 + 3] = 1.0f;
+                normal[i * 4 + ((y / 96) % 3)] = 1.0f;
+            }
+        }
+        DenoiseInput input{uint32_t(kFrameWidth), uint32_t(kFrameHeight), color, albedo, normal, {}, {}};  // 深度・分散なし
+        std::vector<float> denoised;
+        results.push_back(measure("denoise_frame", pixels, iterations, [&] {
+            denoiseFrame(input, DenoiseParams{}, denoised);
+            gSink = gSink + uint64_t(denoised[pixels * 2]);
+        }));
+
+        std::vector<uint8_t> ldr(pixels * 4);
+        results.push_back(measure("tonemap_frame", pixels, iterations, [&] {
+            tonemapFrame(denoised, uint32_t(kFrameWidth), uint32_t(kFrameHeight), TonemapParams{}, ldr);
+            gSink = gSink + ldr[pixels * 2];
+        }));
+    }
+
+    // ---- テンポラル累積の CPU 版 (--temporal の GPU パスと同じ式) ----
+    {
+        const size_t pixels = size_t(kFrameWidth) * kFrameHeight;
+        std::vector<float> color(pixels * 4, 0.5f), normal(pixels * 4), depth(pixels);
+        for (size_t i = 0; i < pixels; ++i) {
+            normal[i * 4 + 2] = -1.0f;
+            depth[i] = 4.0f + float(i % kFrameWidth) * (1.0f / kFrameWidth);
+        }
+        std::vector<float> historyColor[2], historyGeometry[2];
+        for (int i = 0; i < 2; ++i) {
+            historyColor[i].assign(pixels * 4, 1.0f);
+            historyGeometry[i].assign(pixels * 4, 0.0f);
+        }
+        CameraTimeline timeline;
+        timeline.frameCount = 90;
+        TemporalParams params;
+        params.current = makeTemporalCamera(timeline.view(1), kFrameWidth, kFrameHeight);
+        params.previous = makeTemporalCamera(timeline.view(0), kFrameWidth, kFrameHeight);
+        params.historyValid = 1;
+        // 1 回目で履歴に深度と法線が入り、以降は再投影が通る
+        std::vector<float> output(pixels * 4);
+        int parity = 0;
+        results.push_back(measure("temporal_accumulate", pixels, iterations, [&] {
+            temporalAccumulate(color, normal, depth, kFrameWidth, kFrameHeight, params,
+                               {historyColor[parity], historyGeometry[parity]},
+                               {historyColor[parity ^ 1], historyGeometry[parity ^ 1]}, output);
+            parity ^= 1;
+            gSink = gSink + uint64_t(output[pixels * 2]);
+        }));
+    }
+
+    // ---- カメラのタイムライン (キー 4096 個を 1 フレームずつ評価) ----
+    {
+        constexpr uint32_t kKeyCount = 4096;
+        constexpr uint32_t kFrames = 10000;
+        CameraTimeline timeline;
+        timeline.fps = 30.0f;
+        for (uint32_t i = 0; i < kKeyCount; ++i) {
+            CameraKey key;
+            key.time = float(i) * 0.1f;
+            float angle = float(i) * 0.05f;
+            key.position = glm::vec3(4.0f * std::sin(angle), 1.0f, 4.0f * std::cos(angle));
+            key.forward = glm::vec3(0.0f) - key.position;
+            timeline.keys.push_back(key);
+        }
+        results.push_back(measure("camera_timeline_view", kFrames, iterations, [&] {
+            float sum = 0.0f;
+            for (uint32_t f = 0; f < kFrames; ++f) {
+                sum += timeline.view(f).position.x;
+            }
+            gSink = gSink + uint64_t(sum != 0.0f);
+        }));
+    }
+
+    // ---- BC 圧縮 (compress_textures) ----
+    {
+        TextureData tex;
+        tex.width = tex.height = 1024;
+        tex.pixels.resize(size_t(tex.width) * tex.height * 4);
+        for (uint32_t y = 0; y < tex.height; ++y) {
+            for (uint32_t x = 0; x < tex.width; ++x) {
+                uint8_t* p = &tex.pixels[(size_t(y) * tex.width + x) * 4];
+                p[0] = uint8_t(x / 4);
+                p[1] = uint8_t(y / 4);
+                p[2] = uint8_t(hashWang(y * tex.width + x) & 0x1f);
+                p[3] = 255;
+            }
+        }
+        for (TextureFormat format : {TextureFormat::BC1, TextureFormat::BC7}) {
+            std::string name = format == TextureFormat::BC1 ? "bc1_encode" : "bc7_encode";
+            results.push_back(measure(name, uint64_t(tex.width) * tex.height, iterations, [&] {
+                TextureData compressed = compressTexture(tex, format);
+                gSink = gSink + compressed.pixels[compressed.pixels.size() / 2];
+            }));
+        }
+    }
+
+    // ---- random.slang / util.slang の CPU 版 ----
+    const uint64_t kRandomCount = 1u << 22;
+    results.push_back(measure("pcg", kRandomCount, iterations, [&] {
+        uint32_t state = 1;
+        uint32_t acc = 0;
+        for (uint64_t i = 0; i < kRandomCount; ++i) acc ^= pcg(state);
+        gSink = gSink + acc;
+    }));
+    results.push_back(measure("hash_wang", kRandomCount, iterations, [&] {
+        uint32_t acc = 0;
+        for (uint64_t i = 0; i < kRandomCount; ++i) acc ^= hashWang(uint32_t(i));
+        gSink = gSink + acc;
+    }));
+    results.push_back(measure("sample_ggx", kRandomCount, iterations, [&] {
+        uint32_t state = 7;
+        float acc = 0.0f;
+        for (uint64_t i = 0; i < kRandomCount; ++i) {
+            float u = randFloat(state);
+            float v = randFloat(state);
+            acc += sampleGGX(0.4f, u, v)[2];
+        }
+        gSink = gSink + uint64_t(acc);
+    }));
+
+    nlohmann::json out;
+    out["iterations"] = iterations;
+    out["gltf"] = gltfPath.empty() ? "synthetic" : gltfPath;
+    out["results"] = nlohmann::json::array();
+    for (const auto& r : results) out["results"].push_back(toJson(r));
+
+    if (jsonPath.empty()) {
+        std::cout << out.dump(2) << "\n";
+    } else {
+        std::ofstream ofs(jsonPath);
+        ofs << out.dump(2) << "\n";
+        std::cout << "wrote " << jsonPath << "\n";
+    }
+    return 0;
+}
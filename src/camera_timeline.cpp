@@ -0,0 +1,165 @@
+#include "../include/camera_timeline.hpp"
+#include "../include/profiler.hpp"
+
+#include <nlohmann/json.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr float kDefaultVFov = 0.78539816f;    // 45 度
+
+// キーが無いときの軌道。原点を注視しながら frameCount フレームで半周する
+CameraView orbitView(uint32_t frameIndex, uint32_t frameCount){
+    const double theta = glm::pi<double>() / double(std::max(1u, frameCount));
+    const double phase = double(frameIndex) * theta;
+    glm::vec3 position;
+    position.x = float(1.5 * std::sin(5.0 / 4.0 * glm::pi<double>() + phase));
+    position.y = float(3.0 * std::sin(6.0 / 4.0 * glm::pi<double>() + phase));
+    position.z = float(4.0 * std::cos(5.0 / 4.0 * glm::pi<double>() + phase));
+    return makeCameraView(position, glm::vec3(0.0f) - position, glm::vec3(0.0f, 1.0f, 0.0f), kDefaultVFov);
+}
+
+// 時刻が不等間隔な Catmull-Rom の接線 (単位は 1 秒あたり)。端は片側差分
+template<typename T, typename Get>
+T tangent(const std::vector<CameraKey>& keys, size_t i, Get get){
+    size_t prev = i > 0 ? i - 1 : i;
+    size_t next = i + 1 < keys.size() ? i + 1 : i;
+    return (get(keys[next]) - get(keys[prev])) * (1.0f / (keys[next].time - keys[prev].time));
+}
+
+// 3 次 Hermite 補間。h は区間の長さ、s は区間内の 0..1
+template<typename T>
+T hermite(const T& p0, const T& m0, const T& p1, const T& m1, float h, float s){
+    float s2 = s * s;
+    float s3 = s2 * s;
+    float h00 = 2.0f * s3 - 3.0f * s2 + 1.0f;
+    float h10 = s3 - 2.0f * s2 + s;
+    float h01 = -2.0f * s3 + 3.0f * s2;
+    float h11 = s3 - s2;
+    return p0 * h00 + m0 * (h10 * h) + p1 * h01 + m1 * (h11 * h);
+}
+
+bool readVec3(const nlohmann::json& j, glm::vec3& v){
+    if(!j.is_array() || j.size() != 3) return false;
+    for(const auto& c : j){
+        if(!c.is_number()) return false;
+    }
+    v = glm::vec3(j[0].get<float>(), j[1].get<float>(), j[2].get<float>());
+    return true;
+}
+
+}
+
+CameraView makeCameraView(const glm::vec3& position, const glm::vec3& forward, const glm::vec3& up, float vfov){
+    CameraView view;
+    view.position = position;
+    view.forward = glm::normalize(forward);
+    glm::vec3 right = glm::cross(view.forward, up);
+    // up が forward と平行なら、別の軸を上にする
+    if(glm::dot(right, right) < 1e-12f){
+        glm::vec3 fallback = std::abs(view.forward.y) < 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+        right = glm::cross(view.forward, fallback);
+    }
+    view.right = glm::normalize(right);
+    view.up = glm::cross(view.right, view.forward);
+    view.tanHalfFov = std::tan(0.5f * vfov);
+    return view;
+}
+
+float CameraTimeline::duration() const {
+    return keys.empty() ? 0.0f : keys.back().time;
+}
+
+CameraView CameraTimeline::view(uint32_t frameIndex) const {
+    if(keys.empty()) return orbitView(frameIndex, frameCount);
+
+    const float t = float(frameIndex) / fps;
+    auto after = std::upper_bound(keys.begin(), keys.end(), t,
+                                  [](float value, const CameraKey& key){ return value < key.time; });
+    if(after == keys.begin() || after == keys.end()){
+        const CameraKey& key = after == keys.begin() ? keys.front() : keys.back();
+        return makeCameraView(key.position, key.forward, key.up, key.vfov);
+    }
+
+    const size_t i1 = size_t(after - keys.begin());
+    const size_t i0 = i1 - 1;
+    const CameraKey& k0 = keys[i0];
+    const CameraKey& k1 = keys[i1];
+    const float h = k1.time - k0.time;
+    const float s = (t - k0.time) / h;
+
+    auto position = [](const CameraKey& k){ return k.position; };
+    auto forward = [](const CameraKey& k){ return k.forward; };
+    auto up = [](const CameraKey& k){ return k.up; };
+    auto vfov = [](const CameraKey& k){ return k.vfov; };
+    // 向きは補間したあと makeCameraView で正規化・直交化する
+    glm::vec3 f = hermite(k0.forward, tangent<glm::vec3>(keys, i0, forward), k1.forward, tangent<glm::vec3>(keys, i1, forward), h, s);
+    if(glm::dot(f, f) < 1e-12f) f = s < 0.5f ? k0.forward : k1.forward;
+    return makeCameraView(
+        hermite(k0.position, tangent<glm::vec3>(keys, i0, position), k1.position, tangent<glm::vec3>(keys, i1, position), h, s),
+        f,
+        hermite(k0.up, tangent<glm::vec3>(keys, i0, up), k1.up, tangent<glm::vec3>(keys, i1, up), h, s),
+        hermite(k0.vfov, tangent<float>(keys, i0, vfov), k1.vfov, tangent<float>(keys, i1, vfov), h, s));
+}
+
+bool sortCameraKeys(std::vector<CameraKey>& keys){
+    std::stable_sort(keys.begin(), keys.end(), [](const CameraKey& a, const CameraKey& b){ return a.time < b.time; });
+    for(size_t i = 0; i < keys.size(); i++){
+        const CameraKey& key = keys[i];
+        if(!std::isfinite(key.time) || glm::dot(key.forward, key.forward) < 1e-12f) return false;
+        if(!(key.vfov > 0.0f && key.vfov < glm::pi<float>())) return false;
+        if(i > 0 && !(key.time > keys[i - 1].time)) return false;
+    }
+    return true;
+}
+
+bool loadCameraKeys(const std::filesystem::path& path, std::vector<CameraKey>& keys){
+    PROFILE_ZONE("loadCameraKeys");
+    std::ifstream ifs(path);
+    if(!ifs){
+        std::cerr << "カメラファイルを開けません: " << path.string() << std::endl;
+        return false;
+    }
+    nlohmann::json doc = nlohmann::json::parse(ifs, nullptr, false);
+    if(doc.is_discarded() || !doc.contains("keys") || !doc["keys"].is_array()){
+        std::cerr << "カメラファイルの形式が不正です: " << path.string() << std::endl;
+        return false;
+    }
+
+    keys.clear();
+    for(const auto& k : doc["keys"]){
+        CameraKey key;
+        glm::vec3 target;
+        bool ok = k.is_object() && k.contains("time") && k["time"].is_number() &&
+                  k.contains("position") && readVec3(k["position"], key.position);
+        if(ok){
+            key.time = k["time"].get<float>();
+            if(k.contains("forward")){
+                ok = readVec3(k["forward"], key.forward);
+            }else{
+                ok = k.contains("target") && readVec3(k["target"], target);
+                key.forward = target - key.position;
+            }
+        }
+        if(ok && k.contains("up")) ok = readVec3(k["up"], key.up);
+        if(ok && k.contains("fov")){
+            ok = k["fov"].is_number();
+            if(ok) key.vfov = glm::radians(k["fov"].get<float>());
+        }
+        if(!ok){
+            std::cerr << "カメラキーの形式が不正です (" << keys.size() << " 番目): " << path.string() << std::endl;
+            return false;
+        }
+        keys.push_back(key);
+    }
+    if(keys.empty() || !sortCameraKeys(keys)){
+        std::cerr << "カメラキーが空か、時刻・向き・画角が不正です: " << path.string() << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,176 @@
+#include "../include/checkpoint.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/scene_cache.hpp"
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <span>
+
+namespace {
+
+constexpr char kCheckpointMagic[8] = {'M', 'A', 'P', 'L', 'E', 'C', 'K', 'P'};
+
+// ヘッダの後ろに、フレームごとの (index, ファイル数, ファイル (size, hash, パス長, パス)...) と累積を続ける
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t frameCount;
+    uint64_t configHash;
+    uint32_t recordedFrames;
+    uint32_t partialFrame;
+    uint32_t partialPasses;
+    uint32_t pad;
+    uint64_t partialBytes;
+    uint64_t payloadSize;
+    uint64_t payloadHash;   // 途中で切れた・壊れたファイルを読まないため
+};
+
+template<typename T>
+void append(std::vector<uint8_t>& out, const T& value){
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+struct Reader {
+    std::span<const uint8_t> bytes;
+    size_t offset = 0;
+
+    template<typename T>
+    bool read(T& value){
+        if(bytes.size() - offset < sizeof(T)) return false;
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    bool read(std::string& value, size_t length){
+        if(bytes.size() - offset < length) return false;
+        value.assign(reinterpret_cast<const char*>(bytes.data() + offset), length);
+        offset += length;
+        return true;
+    }
+};
+
+}
+
+void RenderCheckpoint::recordFrame(CheckpointFrame frame){
+    auto it = std::find_if(frames.begin(), frames.end(), [&](const CheckpointFrame& f){ return f.index == frame.index; });
+    if(it != frames.end()){
+        *it = std::move(frame);
+    }else{
+        frames.push_back(std::move(frame));
+    }
+}
+
+bool writeCheckpoint(const std::filesystem::path& path, const RenderCheckpoint& checkpoint){
+    PROFILE_ZONE("writeCheckpoint");
+    std::vector<uint8_t> payload;
+    for(const auto& frame : checkpoint.frames){
+        append(payload, frame.index);
+        append(payload, uint32_t(frame.files.size()));
+        for(const auto& file : frame.files){
+            append(payload, file.size);
+            append(payload, file.hash);
+            append(payload, uint32_t(file.path.size()));
+            payload.insert(payload.end(), file.path.begin(), file.path.end());
+        }
+    }
+    payload.insert(payload.end(), checkpoint.partialState.begin(), checkpoint.partialState.end());
+
+    CheckpointHeader header{};
+    std::memcpy(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic));
+    header.version = kCheckpointVersion;
+    header.frameCount = checkpoint.frameCount;
+    header.configHash = checkpoint.configHash;
+    header.recordedFrames = uint32_t(checkpoint.frames.size());
+    header.partialFrame = checkpoint.partialState.empty() ? kNoPartialFrame : checkpoint.partialFrame;
+    header.partialPasses = checkpoint.partialPasses;
+    header.partialBytes = checkpoint.partialState.size();
+    header.payloadSize = payload.size();
+    header.payloadHash = hashBytes(payload);
+
+    // 書きかけのファイルを読まないように一時ファイルに書いてから置き換える
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!ofs) return false;
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(payload.data()), std::streamsize(payload.size()));
+        if(!ofs) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+bool readCheckpoint(const std::filesystem::path& path, RenderCheckpoint& checkpoint){
+    PROFILE_ZONE("readCheckpoint");
+    checkpoint = {};
+    MappedFile file;
+    if(!file.open(path)) return false;
+
+    CheckpointHeader header{};
+    if(file.size < sizeof(header)) return false;
+    std::memcpy(&header, file.data, sizeof(header));
+    if(std::memcmp(header.magic, kCheckpointMagic, sizeof(kCheckpointMagic)) != 0) return false;
+    if(header.version != kCheckpointVersion) return false;
+    if(header.payloadSize != file.size - sizeof(header)) return false;
+    std::span<const uint8_t> payload = file.bytes().subspan(sizeof(header));
+    if(hashBytes(payload) != header.payloadHash) return false;
+    if(header.partialBytes > payload.size()) return false;
+
+    Reader reader{payload.first(payload.size() - header.partialBytes)};
+    checkpoint.frames.resize(header.recordedFrames);
+    for(auto& frame : checkpoint.frames){
+        uint32_t fileCount = 0;
+        if(!reader.read(frame.index) || !reader.read(fileCount)) return false;
+        if(frame.index >= header.frameCount) return false;
+        for(uint32_t i = 0; i < fileCount; i++){
+            CheckpointFile& f = frame.files.emplace_back();
+            uint32_t pathLength = 0;
+            if(!reader.read(f.size) || !reader.read(f.hash) || !reader.read(pathLength) || !reader.read(f.path, pathLength)) return false;
+        }
+    }
+    if(reader.offset != reader.bytes.size()) return false;
+
+    checkpoint.configHash = header.configHash;
+    checkpoint.frameCount = header.frameCount;
+    if(header.partialFrame != kNoPartialFrame && header.partialFrame < header.frameCount && header.partialBytes > 0){
+        checkpoint.partialFrame = header.partialFrame;
+        checkpoint.partialPasses = header.partialPasses;
+        auto state = payload.last(header.partialBytes);
+        checkpoint.partialState.assign(state.begin(), state.end());
+    }
+    return true;
+}
+
+bool describeFile(const std::filesystem::path& path, CheckpointFile& file){
+    MappedFile mapped;
+    if(!mapped.open(path)) return false;
+    file.path = path.string();
+    file.size = mapped.size;
+    file.hash = hashBytes(mapped.bytes());
+    return true;
+}
+
+bool verifyFile(const CheckpointFile& file){
+    // サイズが違えば中身を読まない
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(file.path, ec);
+    if(ec || size != file.size) return false;
+    CheckpointFile current;
+    return describeFile(file.path, current) && current.hash == file.hash;
+}
+
+std::vector<bool> verifiedFrames(const RenderCheckpoint& checkpoint){
+    PROFILE_ZONE("verifyCheckpoint");
+    std::vector<bool> verified(checkpoint.frameCount, false);
+    for(const auto& frame : checkpoint.frames){
+        if(frame.index >= checkpoint.frameCount || frame.files.empty()) continue;
+        verified[frame.index] = std::all_of(frame.files.begin(), frame.files.end(), verifyFile);
+    }
+    return verified;
+}
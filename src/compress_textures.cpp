@@ -0,0 +1,93 @@
+// シーンのテクスチャをブロック圧縮して mesh/test.mtex に書き出すオフライン変換
+//   compress_textures <resourceDir> [--bc1] [--out path]
+// baseColor / emissive は BC7 (--bc1 なら BC1), normal / metallicRoughness は BC5, occlusion は BC4
+#include "../include/scene.hpp"
+#include "../include/scene_decode.hpp"
+#include "../include/gltf_source.hpp"
+#include "../include/texture_compress.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* formatName(TextureFormat format){
+    switch(format){
+    case TextureFormat::BC1: return "BC1";
+    case TextureFormat::BC4: return "BC4";
+    case TextureFormat::BC5: return "BC5";
+    case TextureFormat::BC7: return "BC7";
+    default: return "RGBA8";
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::filesystem::path resourceDir;
+    std::filesystem::path outPath;
+    bool preferBC1 = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--bc1") preferBC1 = true;
+        else if (arg == "--out" && i + 1 < argc) outPath = argv[++i];
+        else if (resourceDir.empty() && arg.rfind("--", 0) != 0) resourceDir = arg;
+        else {
+            resourceDir.clear();
+            break;
+        }
+    }
+    if (resourceDir.empty()) {
+        std::cerr << "usage: compress_textures <resourceDir> [--bc1] [--out path]\n";
+        return 1;
+    }
+
+    std::filesystem::path scenePath = findSceneFile(resourceDir);
+    std::filesystem::path textureDir = resourceDir / "texture";
+    if (outPath.empty()) outPath = textureContainerPath(scenePath);
+
+    GltfSource gltf;
+    std::string err;
+    if (!openGltf(scenePath, gltf, err)) {
+        std::cerr << "[gltf err] " << err << "\n";
+        return 1;
+    }
+    if (gltf.images.empty()) {
+        std::cout << "no images in " << scenePath.string() << "\n";
+        return 0;
+    }
+
+    std::vector<Material> materials = translateMaterials(gltf.model);
+    std::vector<std::string> sourceFiles;
+    uint64_t sourceHash = 0;
+    std::vector<TextureData> textures;
+    if (!textureSourceHash(gltf, textureDir, materials, sourceHash, sourceFiles) ||
+        !loadTextures(gltf, textureDir, materials, textures, sourceFiles)) {
+        return 1;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<TextureFormat> formats = chooseTextureFormats(materials, textures.size(), preferBC1);
+    std::vector<TextureData> compressed;
+    size_t rawBytes = 0, compressedBytes = 0;
+    for (size_t i = 0; i < textures.size(); ++i) {
+        compressed.push_back(compressTexture(textures[i], formats[i]));
+        rawBytes += textures[i].pixels.size();
+        compressedBytes += compressed.back().pixels.size();
+        std::cout << "texture " << i << ": " << textures[i].width << "x" << textures[i].height
+                  << " " << formatName(formats[i]) << "\n";
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    if (!writeTextureContainer(outPath, sourceHash, compressed)) {
+        std::cerr << "failed to write " << outPath.string() << "\n";
+        return 1;
+    }
+    std::cout << "wrote " << outPath.string() << " (" << rawBytes << " -> " << compressedBytes << " bytes, "
+              << std::chrono::duration<double, std::milli>(t1 - t0).count() << " ms)\n";
+    return 0;
+}
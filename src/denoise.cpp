@@ -0,0 +1,370 @@
+#include "../include/denoise.hpp"
+#include "../include/parallel.hpp"
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define MAPLE_DENOISE_SSE2 1
+#endif
+
+namespace {
+
+constexpr float kAlbedoEpsilon = 1e-3f;
+constexpr float kSigmaEpsilon = 1e-10f;
+// 深度の許容差の下限 (深度に対する比)。勾配 0 の面で丸め誤差を弾かないように
+constexpr float kDepthRelativeEpsilon = 1e-3f;
+// B3 スプライン (1/16, 1/4, 3/8, 1/4, 1/16) を中央が 1 になるように割ったもの
+constexpr float kKernel[3] = {1.0f, 2.0f / 3.0f, 1.0f / 6.0f};
+
+// 4 画素まとめて読めるように平面ごとに持つ
+struct Planes {
+    std::vector<float> r, g, b, var;
+
+    void resize(size_t n){
+        r.resize(n);
+        g.resize(n);
+        b.resize(n);
+        var.resize(n);
+    }
+};
+
+// パスごとに作り直す補助平面
+struct Guide {
+    std::vector<float> lum;         // 照度の輝度
+    std::vector<float> invSigma;    // 1 / (σl * sqrt(3x3 でぼかした分散))
+};
+
+struct Normals {
+    std::vector<float> x, y, z;     // 正規化済み。背景は 0 (どの画素とも重みが 0 になる)
+};
+
+// 深度の重み exp(-|zp - zq| / (gradient * 距離 + epsilon))
+struct Depths {
+    std::vector<float> z;
+    std::vector<float> gradient;    // σz * 画面上の深度勾配の大きさ
+    std::vector<float> epsilon;
+};
+
+// 5x5 の各タップの中心からの距離 (step 1 のとき)
+const float kTapDistance[5][5] = {
+    {2.8284271f, 2.2360680f, 2.0f, 2.2360680f, 2.8284271f},
+    {2.2360680f, 1.4142136f, 1.0f, 1.4142136f, 2.2360680f},
+    {2.0f,       1.0f,       0.0f, 1.0f,       2.0f},
+    {2.2360680f, 1.4142136f, 1.0f, 1.4142136f, 2.2360680f},
+    {2.8284271f, 2.2360680f, 2.0f, 2.2360680f, 2.8284271f},
+};
+
+float luminance(float r, float g, float b){
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+// exp(x) の近似。2^t の小数部を 5 次多項式で近似する (相対誤差 2e-4 程度)。SIMD 版と同じ式
+float fastExp(float x){
+    float t = std::max(x, -87.0f) * 1.44269504f;
+    float fi = std::floor(t);
+    float f = t - fi;
+    float p = 1.0f + f * (0.6931472f + f * (0.2402265f + f * (0.0555041f + f * (0.0096181f + f * 0.0013333f))));
+    int32_t bits;
+    std::memcpy(&bits, &p, 4);
+    bits += int32_t(fi) * (1 << 23);
+    std::memcpy(&p, &bits, 4);
+    return p;
+}
+
+float normalWeight(float d, uint32_t powerLog2){
+    d = std::max(d, 0.0f);
+    for(uint32_t i = 0; i < powerLog2; i++) d *= d;
+    return d;
+}
+
+struct PassContext {
+    const Planes& src;
+    Planes& dst;
+    const Guide& guide;
+    const Normals& normals;
+    const Depths& depths;           // z が空なら深度の重みを使わない
+    uint32_t width;
+    uint32_t height;
+    int step;
+    uint32_t normalPowerLog2;
+};
+
+void filterPixel(const PassContext& c, uint32_t x, uint32_t y){
+    const size_t p = size_t(y) * c.width + x;
+    const float lp = c.guide.lum[p];
+    const float invSigma = c.guide.invSigma[p];
+    const float nx = c.normals.x[p], ny = c.normals.y[p], nz = c.normals.z[p];
+    const bool useDepth = !c.depths.z.empty();
+    const float zp = useDepth ? c.depths.z[p] : 0.0f;
+    const float zGradient = useDepth ? c.depths.gradient[p] * float(c.step) : 0.0f;
+    const float zEpsilon = useDepth ? c.depths.epsilon[p] : 0.0f;
+
+    float sumW = 1.0f;
+    float sumR = c.src.r[p], sumG = c.src.g[p], sumB = c.src.b[p];
+    float sumV = c.src.var[p];
+    for(int dy = -2; dy <= 2; dy++){
+        int qy = int(y) + dy * c.step;
+        if(qy < 0 || qy >= int(c.height)) continue;
+        for(int dx = -2; dx <= 2; dx++){
+            int qx = int(x) + dx * c.step;
+            if((dx == 0 && dy == 0) || qx < 0 || qx >= int(c.width)) continue;
+            size_t q = size_t(qy) * c.width + size_t(qx);
+            float wn = normalWeight(nx * c.normals.x[q] + ny * c.normals.y[q] + nz * c.normals.z[q], c.normalPowerLog2);
+            float e = std::abs(lp - c.guide.lum[q]) * invSigma;
+            if(useDepth) e += std::abs(zp - c.depths.z[q]) / (zGradient * kTapDistance[dy + 2][dx + 2] + zEpsilon);
+            float w = kKernel[std::abs(dx)] * kKernel[std::abs(dy)] * wn * fastExp(-e);
+            sumW += w;
+            sumR += w * c.src.r[q];
+            sumG += w * c.src.g[q];
+            sumB += w * c.src.b[q];
+            sumV += w * w * c.src.var[q];
+        }
+    }
+    const float invW = 1.0f / sumW;
+    c.dst.r[p] = sumR * invW;
+    c.dst.g[p] = sumG * invW;
+    c.dst.b[p] = sumB * invW;
+    c.dst.var[p] = sumV * invW * invW;
+}
+
+#ifdef MAPLE_DENOISE_SSE2
+__m128 fastExp4(__m128 x){
+    __m128 t = _mm_mul_ps(_mm_max_ps(x, _mm_set1_ps(-87.0f)), _mm_set1_ps(1.44269504f));
+    // 切り捨て変換を floor に直す
+    __m128 fi = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+    fi = _mm_sub_ps(fi, _mm_and_ps(_mm_cmpgt_ps(fi, t), _mm_set1_ps(1.0f)));
+    __m128 f = _mm_sub_ps(t, fi);
+    __m128 p = _mm_set1_ps(0.0013333f);
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.0096181f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.0555041f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.2402265f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.6931472f));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+    __m128i e = _mm_slli_epi32(_mm_cvttps_epi32(fi), 23);
+    return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(p), e));
+}
+
+__m128 abs4(__m128 v){
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+// x から 4 画素。全タップが画像内にあるときだけ呼ぶ
+void filterPixels4(const PassContext& c, uint32_t x, uint32_t y){
+    const size_t p = size_t(y) * c.width + x;
+    const __m128 lp = _mm_loadu_ps(&c.guide.lum[p]);
+    const __m128 invSigma = _mm_loadu_ps(&c.guide.invSigma[p]);
+    const __m128 nx = _mm_loadu_ps(&c.normals.x[p]);
+    const __m128 ny = _mm_loadu_ps(&c.normals.y[p]);
+    const __m128 nz = _mm_loadu_ps(&c.normals.z[p]);
+    const __m128 zero = _mm_setzero_ps();
+    const bool useDepth = !c.depths.z.empty();
+    const __m128 zp = useDepth ? _mm_loadu_ps(&c.depths.z[p]) : zero;
+    const __m128 zGradient = useDepth ? _mm_mul_ps(_mm_loadu_ps(&c.depths.gradient[p]), _mm_set1_ps(float(c.step))) : zero;
+    const __m128 zEpsilon = useDepth ? _mm_loadu_ps(&c.depths.epsilon[p]) : zero;
+
+    __m128 sumW = _mm_set1_ps(1.0f);
+    __m128 sumR = _mm_loadu_ps(&c.src.r[p]);
+    __m128 sumG = _mm_loadu_ps(&c.src.g[p]);
+    __m128 sumB = _mm_loadu_ps(&c.src.b[p]);
+    __m128 sumV = _mm_loadu_ps(&c.src.var[p]);
+    for(int dy = -2; dy <= 2; dy++){
+        for(int dx = -2; dx <= 2; dx++){
+            if(dx == 0 && dy == 0) continue;
+            const size_t q = size_t(int64_t(p) + int64_t(dy * c.step) * c.width + dx * c.step);
+            __m128 d = _mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(nx, _mm_loadu_ps(&c.normals.x[q])),
+                _mm_mul_ps(ny, _mm_loadu_ps(&c.normals.y[q]))),
+                _mm_mul_ps(nz, _mm_loadu_ps(&c.normals.z[q])));
+            __m128 wn = _mm_max_ps(d, zero);
+            for(uint32_t i = 0; i < c.normalPowerLog2; i++) wn = _mm_mul_ps(wn, wn);
+            __m128 e = _mm_mul_ps(abs4(_mm_sub_ps(lp, _mm_loadu_ps(&c.guide.lum[q]))), invSigma);
+            if(useDepth){
+                __m128 zDiff = abs4(_mm_sub_ps(zp, _mm_loadu_ps(&c.depths.z[q])));
+                __m128 zScale = _mm_add_ps(_mm_mul_ps(zGradient, _mm_set1_ps(kTapDistance[dy + 2][dx + 2])), zEpsilon);
+                e = _mm_add_ps(e, _mm_div_ps(zDiff, zScale));
+            }
+            __m128 wl = fastExp4(_mm_sub_ps(zero, e));
+            __m128 w = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(kKernel[std::abs(dx)] * kKernel[std::abs(dy)]), wn), wl);
+            sumW = _mm_add_ps(sumW, w);
+            sumR = _mm_add_ps(sumR, _mm_mul_ps(w, _mm_loadu_ps(&c.src.r[q])));
+            sumG = _mm_add_ps(sumG, _mm_mul_ps(w, _mm_loadu_ps(&c.src.g[q])));
+            sumB = _mm_add_ps(sumB, _mm_mul_ps(w, _mm_loadu_ps(&c.src.b[q])));
+            sumV = _mm_add_ps(sumV, _mm_mul_ps(_mm_mul_ps(w, w), _mm_loadu_ps(&c.src.var[q])));
+        }
+    }
+    const __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), sumW);
+    _mm_storeu_ps(&c.dst.r[p], _mm_mul_ps(sumR, invW));
+    _mm_storeu_ps(&c.dst.g[p], _mm_mul_ps(sumG, invW));
+    _mm_storeu_ps(&c.dst.b[p], _mm_mul_ps(sumB, invW));
+    _mm_storeu_ps(&c.dst.var[p], _mm_mul_ps(sumV, _mm_mul_ps(invW, invW)));
+}
+#endif
+
+// 輝度と、3x3 のガウシアンでぼかした分散から輝度の重みの幅を作る
+void buildGuide(const Planes& src, uint32_t width, uint32_t height, float sigmaLuminance, Guide& guide){
+    parallelRows(height, [&](uint32_t begin, uint32_t end){
+        for(uint32_t y = begin; y < end; y++){
+            for(uint32_t x = 0; x < width; x++){
+                size_t p = size_t(y) * width + x;
+                guide.lum[p] = luminance(src.r[p], src.g[p], src.b[p]);
+                float sum = 0.0f, sumK = 0.0f;
+                for(int dy = -1; dy <= 1; dy++){
+                    int qy = int(y) + dy;
+                    if(qy < 0 || qy >= int(height)) continue;
+                    for(int dx = -1; dx <= 1; dx++){
+                        int qx = int(x) + dx;
+                        if(qx < 0 || qx >= int(width)) continue;
+                        float k = (dx == 0 ? 0.5f : 0.25f) * (dy == 0 ? 0.5f : 0.25f);
+                        sum += k * src.var[size_t(qy) * width + size_t(qx)];
+                        sumK += k;
+                    }
+                }
+                float sigma = sigmaLuminance * std::sqrt(std::max(sum / sumK, 0.0f));
+                guide.invSigma[p] = 1.0f / (sigma + kSigmaEpsilon);
+            }
+        }
+    });
+}
+
+// 中心差分の深度勾配。背景 (深度 0) の隣は使わず片側差分にする
+void buildDepths(std::span<const float> depth, uint32_t width, uint32_t height, float sigmaDepth, Depths& depths){
+    const size_t pixels = size_t(width) * height;
+    depths.z.assign(depth.begin(), depth.begin() + pixels);
+    depths.gradient.resize(pixels);
+    depths.epsilon.resize(pixels);
+    auto slope = [&](size_t p, size_t prev, size_t next, bool hasPrev, bool hasNext){
+        const float z = depths.z[p];
+        hasPrev = hasPrev && depths.z[prev] > 0.0f;
+        hasNext = hasNext && depths.z[next] > 0.0f;
+        if(hasPrev && hasNext) return 0.5f * (depths.z[next] - depths.z[prev]);
+        if(hasNext) return depths.z[next] - z;
+        if(hasPrev) return z - depths.z[prev];
+        return 0.0f;
+    };
+    parallelRows(height, [&](uint32_t begin, uint32_t end){
+        for(uint32_t y = begin; y < end; y++){
+            for(uint32_t x = 0; x < width; x++){
+                size_t p = size_t(y) * width + x;
+                float gx = slope(p, p - 1, p + 1, x > 0, x + 1 < width);
+                float gy = slope(p, p - width, p + width, y > 0, y + 1 < height);
+                depths.gradient[p] = sigmaDepth * std::sqrt(gx * gx + gy * gy);
+                depths.epsilon[p] = kDepthRelativeEpsilon * depths.z[p] + kSigmaEpsilon;
+            }
+        }
+    });
+}
+
+void atrousPass(const PassContext& c){
+    const uint32_t reach = uint32_t(2 * c.step);
+    parallelRows(c.height, [&](uint32_t begin, uint32_t end){
+        for(uint32_t y = begin; y < end; y++){
+            uint32_t x = 0;
+#ifdef MAPLE_DENOISE_SSE2
+            // 全タップが画像内に収まる内側だけ 4 画素ずつ
+            if(y >= reach && y + reach < c.height && c.width > 2 * reach + 4){
+                for(; x < reach; x++) filterPixel(c, x, y);
+                for(; x + 4 + reach <= c.width; x += 4) filterPixels4(c, x, y);
+            }
+#endif
+            for(; x < c.width; x++) filterPixel(c, x, y);
+        }
+    });
+}
+
+}
+
+bool denoiseFrame(const DenoiseInput& input, const DenoiseParams& params, std::vector<float>& out){
+    PROFILE_ZONE("denoiseFrame");
+    const uint32_t width = input.width;
+    const uint32_t height = input.height;
+    const size_t pixels = size_t(width) * height;
+    if(pixels == 0 || input.color.size() < pixels * 4 || input.albedo.size() < pixels * 4 ||
+       input.normal.size() < pixels * 4 || (!input.variance.empty() && input.variance.size() < pixels) ||
+       (!input.depth.empty() && input.depth.size() < pixels)){
+        return false;
+    }
+
+    // アルベドで割って照度にする。法線は正規化 (長さ 0 の背景は 0 のまま)
+    Planes planes[2];
+    planes[0].resize(pixels);
+    planes[1].resize(pixels);
+    Normals normals;
+    normals.x.resize(pixels);
+    normals.y.resize(pixels);
+    normals.z.resize(pixels);
+    Guide guide;
+    guide.lum.resize(pixels);
+    guide.invSigma.resize(pixels);
+    parallelRows(height, [&](uint32_t begin, uint32_t end){
+        for(size_t p = size_t(begin) * width; p < size_t(end) * width; p++){
+            const float* a = &input.albedo[p * 4];
+            const float* col = &input.color[p * 4];
+            planes[0].r[p] = col[0] / (a[0] + kAlbedoEpsilon);
+            planes[0].g[p] = col[1] / (a[1] + kAlbedoEpsilon);
+            planes[0].b[p] = col[2] / (a[2] + kAlbedoEpsilon);
+            if(!input.variance.empty()){
+                float la = luminance(a[0], a[1], a[2]) + kAlbedoEpsilon;
+                planes[0].var[p] = input.variance[p] / (la * la);
+            }
+
+            const float* n = &input.normal[p * 4];
+            float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            float inv = len > 1e-6f ? 1.0f / len : 0.0f;
+            normals.x[p] = n[0] * inv;
+            normals.y[p] = n[1] * inv;
+            normals.z[p] = n[2] * inv;
+        }
+    });
+
+    // 分散が無ければ 3x3 の輝度の分散で代用する
+    if(input.variance.empty()){
+        parallelRows(height, [&](uint32_t begin, uint32_t end){
+            for(uint32_t y = begin; y < end; y++){
+                for(uint32_t x = 0; x < width; x++){
+                    float sum = 0.0f, sum2 = 0.0f;
+                    int count = 0;
+                    for(int qy = std::max(int(y) - 1, 0); qy <= std::min(int(y) + 1, int(height) - 1); qy++){
+                        for(int qx = std::max(int(x) - 1, 0); qx <= std::min(int(x) + 1, int(width) - 1); qx++){
+                            size_t q = size_t(qy) * width + size_t(qx);
+                            float l = luminance(planes[0].r[q], planes[0].g[q], planes[0].b[q]);
+                            sum += l;
+                            sum2 += l * l;
+                            count++;
+                        }
+                    }
+                    float mean = sum / float(count);
+                    planes[0].var[size_t(y) * width + x] = std::max(sum2 / float(count) - mean * mean, 0.0f);
+                }
+            }
+        });
+    }
+
+    Depths depths;
+    if(!input.depth.empty()) buildDepths(input.depth, width, height, params.sigmaDepth, depths);
+
+    uint32_t current = 0;
+    for(uint32_t i = 0; i < params.iterations; i++){
+        buildGuide(planes[current], width, height, params.sigmaLuminance, guide);
+        PassContext context{planes[current], planes[current ^ 1], guide, normals, depths, width, height, 1 << i, params.normalPowerLog2};
+        atrousPass(context);
+        current ^= 1;
+    }
+
+    // アルベドを掛け戻す
+    out.resize(pixels * 4);
+    const Planes& result = planes[current];
+    parallelRows(height, [&](uint32_t begin, uint32_t end){
+        for(size_t p = size_t(begin) * width; p < size_t(end) * width; p++){
+            const float* a = &input.albedo[p * 4];
+            out[p * 4 + 0] = result.r[p] * (a[0] + kAlbedoEpsilon);
+            out[p * 4 + 1] = result.g[p] * (a[1] + kAlbedoEpsilon);
+            out[p * 4 + 2] = result.b[p] * (a[2] + kAlbedoEpsilon);
+            out[p * 4 + 3] = input.color[p * 4 + 3];
+        }
+    });
+    return true;
+}
@@ -1,14 +1,16 @@
 #include "../include/accel.hpp"
 #include "../include/globals.hpp"
+#include "../include/profiler.hpp"
 #include <algorithm>
 
 void createDescriptor(size_t countSets){
-    size_t imageCount = std::max<size_t>(1, model.images.size());
+    PROFILE_ZONE("createDescriptor");
+    size_t imageCount = std::max<size_t>(1, sceneView.textures.size());
 
     const uint32_t asPerSet      = 1;
-    const uint32_t imgPerSet     = 1;
+    const uint32_t imgPerSet     = 5; // HDR + AOV (albedo, normal, depth, id)
     const uint32_t uboPerSet     = 1;
-    const uint32_t ssboPerSet    = 4;
+    const uint32_t ssboPerSet    = 8;
     const uint32_t texPerSet     = 1 + imageCount; // envMap + texture
     const uint32_t samplerPerset = 2;
 
@@ -32,7 +34,7 @@ void createDescriptor(size_t countSets){
     createInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
     descPool = device->createDescriptorPoolUnique(createInfo);
 
-    std::vector<vk::DescriptorSetLayoutBinding> bindings(11);
+    std::vector<vk::DescriptorSetLayoutBinding> bindings(19);
 
     // Acceleration Structure
     bindings[0].setBinding(0);
@@ -56,13 +58,13 @@ void createDescriptor(size_t countSets){
     bindings[3].setBinding(3);
     bindings[3].setDescriptorType(vk::DescriptorType::eStorageBuffer);
     bindings[3].setDescriptorCount(1);
-    bindings[3].setStageFlags(vk::ShaderStageFlagBits::eClosestHitKHR);
+    bindings[3].setStageFlags(vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eClosestHitKHR);
 
     // index buffer
     bindings[4].setBinding(4);
     bindings[4].setDescriptorType(vk::DescriptorType::eStorageBuffer);
     bindings[4].setDescriptorCount(1);
-    bindings[4].setStageFlags(vk::ShaderStageFlagBits::eClosestHitKHR);
+    bindings[4].setStageFlags(vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eClosestHitKHR);
 
     // material buffer
     bindings[5].setBinding(5);
@@ -110,6 +112,53 @@ void createDescriptor(size_t countSets){
         vk::ShaderStageFlagBits::eAnyHitKHR
     );
 
+    // path stats (debug counter)
+    bindings[11].setBinding(11);
+    bindings[11].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    bindings[11].setDescriptorCount(1);
+    bindings[11].setStageFlags(vk::ShaderStageFlagBits::eRaygenKHR);
+
+    // pixel accumulation (adaptive sampling)
+    bindings[12].setBinding(12);
+    bindings[12].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    bindings[12].setDescriptorCount(1);
+    bindings[12].setStageFlags(vk::ShaderStageFlagBits::eRaygenKHR);
+
+    // active pixel list (adaptive sampling)
+    bindings[13].setBinding(13);
+    bindings[13].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    bindings[13].setDescriptorCount(1);
+    bindings[13].setStageFlags(vk::ShaderStageFlagBits::eRaygenKHR);
+
+    // sobol matrices
+    bindings[14].setBinding(14);
+    bindings[14].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    bindings[14].setDescriptorCount(1);
+    bindings[14].setStageFlags(vk::ShaderStageFlagBits::eRaygenKHR);
+
+    // albedo AOV
+    bindings[15].setBinding(15);
+    bindings[15].setDescriptorType(vk::DescriptorType::eStorageImage);
+    bindings[15].setDescriptorCount(1);
+    bindings[15].setStageFlags(vk::ShaderStageFlagBits::eRaygenKHR);
+
+    // normal AOV
+    bindings[16].setBinding(16);
+    bindings[16].setDescriptorType(vk::DescriptorType::eStorageImage);
+    bindings[16].setDescriptorCount(1);
+    bindings[16].setStageFlags(vk::ShaderStageFlagBits::eRaygenKHR);
+
+    // depth AOV
+    bindings[17].setBinding(17);
+    bindings[17].setDescriptorType(vk::DescriptorType::eStorageImage);
+    bindings[17].setDescriptorCount(1);
+    bindings[17].setStageFlags(vk::ShaderStageFlagBits::eRaygenKHR);
+
+    // primitive / material id AOV
+    bindings[18].setBinding(18);
+    bindings[18].setDescriptorType(vk::DescriptorType::eStorageImage);
+    bindings[18].setDescriptorCount(1);
+    bindings[18].setStageFlags(vk::ShaderStageFlagBits::eRaygenKHR);
 
     vk::DescriptorSetLayoutCreateInfo descSetLayoutCreateInfo{};
     descSetLayoutCreateInfo.setBindings(bindings);
@@ -124,7 +173,7 @@ void createDescriptor(size_t countSets){
 }
 
 void updateDescriptorSet(uint32_t setIndex, vk::ImageView imageView){
-    std::vector<vk::WriteDescriptorSet> writes(11);
+    std::vector<vk::WriteDescriptorSet> writes(19);
 
     // [0]: For AS
     vk::WriteDescriptorSetAccelerationStructureKHR accelInfo{};
@@ -178,7 +227,7 @@ void updateDescriptorSet(uint32_t setIndex, vk::ImageView imageView){
     vk::DescriptorBufferInfo matBufInfo{};
     matBufInfo.setBuffer(materialBuffer.buffer.get());
     matBufInfo.setOffset(0);
-    matBufInfo.setRange(sizeof(Material) * materials.size());
+    matBufInfo.setRange(sizeof(Material) * sceneView.materials.size());
     writes[5].setDstSet(*descSets[setIndex]);
     writes[5].setDstBinding(5);
     writes[5].setDescriptorType(vk::DescriptorType::eStorageBuffer);
@@ -188,7 +237,7 @@ void updateDescriptorSet(uint32_t setIndex, vk::ImageView imageView){
     vk::DescriptorBufferInfo matIdxInfo{};
     matIdxInfo.setBuffer(materialIndexBuffer.buffer.get());
     matIdxInfo.setOffset(0);
-    matIdxInfo.setRange(sizeof(uint32_t) * primitiveMaterialIndices.size());
+    matIdxInfo.setRange(sizeof(uint32_t) * sceneView.primitiveMaterialIndices.size());
     writes[6].setDstSet(*descSets[setIndex]);
     writes[6].setDstBinding(6);
     writes[6].setDescriptorType(vk::DescriptorType::eStorageBuffer);
@@ -236,6 +285,82 @@ void updateDescriptorSet(uint32_t setIndex, vk::ImageView imageView){
     writes[10].setDescriptorType(vk::DescriptorType::eSampler);
     writes[10].setPImageInfo(envSamplerinfo);
 
+    // [11]: For path stats
+    vk::DescriptorBufferInfo statsInfo{};
+    statsInfo.setBuffer(pathStatsBuffer.buffer.get());
+    statsInfo.setOffset(0);
+    statsInfo.setRange(sizeof(PathStats));
+    writes[11].setDstSet(*descSets[setIndex]);
+    writes[11].setDstBinding(11);
+    writes[11].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    writes[11].setBufferInfo(statsInfo);
+
+    // [12]: For pixel accumulation
+    vk::DescriptorBufferInfo accumInfo{};
+    accumInfo.setBuffer(pixelAccumBuffer.buffer.get());
+    accumInfo.setOffset(0);
+    accumInfo.setRange(VK_WHOLE_SIZE);
+    writes[12].setDstSet(*descSets[setIndex]);
+    writes[12].setDstBinding(12);
+    writes[12].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    writes[12].setBufferInfo(accumInfo);
+
+    // [13]: For active pixel list
+    vk::DescriptorBufferInfo activeInfo{};
+    activeInfo.setBuffer(activePixelBuffer.buffer.get());
+    activeInfo.setOffset(0);
+    activeInfo.setRange(VK_WHOLE_SIZE);
+    writes[13].setDstSet(*descSets[setIndex]);
+    writes[13].setDstBinding(13);
+    writes[13].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    writes[13].setBufferInfo(activeInfo);
+
+    // [14]: For sobol matrices
+    vk::DescriptorBufferInfo sobolInfo{};
+    sobolInfo.setBuffer(sobolBuffer.buffer.get());
+    sobolInfo.setOffset(0);
+    sobolInfo.setRange(VK_WHOLE_SIZE);
+    writes[14].setDstSet(*descSets[setIndex]);
+    writes[14].setDstBinding(14);
+    writes[14].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    writes[14].setBufferInfo(sobolInfo);
+
+    // [15]: For albedo AOV
+    vk::DescriptorImageInfo albedoInfo{};
+    albedoInfo.setImageView(albedoView.get());
+    albedoInfo.setImageLayout(vk::ImageLayout::eGeneral);
+    writes[15].setDstSet(*descSets[setIndex]);
+    writes[15].setDstBinding(15);
+    writes[15].setDescriptorType(vk::DescriptorType::eStorageImage);
+    writes[15].setImageInfo(albedoInfo);
+
+    // [16]: For normal AOV
+    vk::DescriptorImageInfo normalInfo{};
+    normalInfo.setImageView(normalView.get());
+    normalInfo.setImageLayout(vk::ImageLayout::eGeneral);
+    writes[16].setDstSet(*descSets[setIndex]);
+    writes[16].setDstBinding(16);
+    writes[16].setDescriptorType(vk::DescriptorType::eStorageImage);
+    writes[16].setImageInfo(normalInfo);
+
+    // [17]: For depth AOV
+    vk::DescriptorImageInfo depthInfo{};
+    depthInfo.setImageView(depthView.get());
+    depthInfo.setImageLayout(vk::ImageLayout::eGeneral);
+    writes[17].setDstSet(*descSets[setIndex]);
+    writes[17].setDstBinding(17);
+    writes[17].setDescriptorType(vk::DescriptorType::eStorageImage);
+    writes[17].setImageInfo(depthInfo);
+
+    // [18]: For id AOV
+    vk::DescriptorImageInfo idInfo{};
+    idInfo.setImageView(idView.get());
+    idInfo.setImageLayout(vk::ImageLayout::eGeneral);
+    writes[18].setDstSet(*descSets[setIndex]);
+    writes[18].setDstBinding(18);
+    writes[18].setDescriptorType(vk::DescriptorType::eStorageImage);
+    writes[18].setImageInfo(idInfo);
+
     // Update
     device->updateDescriptorSets(writes, nullptr);
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+// .spv を uint32_t の配列として埋め込むヘッダに変換する (ビルド時に使う)
+// usage: embed_spirv <input.spv> <output.hpp> <var>
+// 出力は <var>[] (uint32_t) と <var>_size (バイト数)。vk::ShaderModuleCreateInfo::pCode にそのまま渡せる
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t kSpirvMagic = 0x07230203u;
+
+}
+
+int main(int argc, char** argv){
+    if(argc != 4){
+        std::cerr << "usage: embed_spirv <input.spv> <output.hpp> <var>" << std::endl;
+        return 1;
+    }
+    const std::string inputPath = argv[1];
+    const std::string outputPath = argv[2];
+    const std::string var = argv[3];
+
+    std::ifstream ifs(inputPath, std::ios::binary);
+    if(!ifs){
+        std::cerr << "embed_spirv: cannot open " << inputPath << std::endl;
+        return 1;
+    }
+    std::vector<char> bytes((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+    // SPIR-V はワード列なので 4 の倍数で、先頭がマジックのはず
+    std::vector<uint32_t> words(bytes.size() / sizeof(uint32_t));
+    if(bytes.size() % sizeof(uint32_t) == 0 && !words.empty()){
+        std::memcpy(words.data(), bytes.data(), bytes.size());
+    }
+    if(bytes.size() % sizeof(uint32_t) != 0 || words.empty() || words[0] != kSpirvMagic){
+        std::cerr << "embed_spirv: not a SPIR-V module: " << inputPath << std::endl;
+        return 1;
+    }
+
+    // 1 バイトずつ書くと遅いので、まとめて組み立ててから一度に書く
+    std::string out;
+    out.reserve(words.size() * 12 + 256);
+    out += "// generated from " + inputPath + "\n";
+    out += "#pragma once\n#include <cstddef>\n#include <cstdint>\n";
+    out += "static const uint32_t " + var + "[] = {\n";
+    char word[16];
+    for(size_t i = 0; i < words.size(); i++){
+        std::snprintf(word, sizeof(word), "0x%08x,", words[i]);
+        out += (i % 8 == 0) ? "  " : " ";
+        out += word;
+        if(i % 8 == 7 || i + 1 == words.size()) out += '\n';
+    }
+    out += "};\n";
+    out += "static const size_t " + var + "_size = sizeof(" + var + ");\n";
+
+    std::ofstream ofs(outputPath, std::ios::binary | std::ios::trunc);
+    ofs.write(out.data(), std::streamsize(out.size()));
+    if(!ofs){
+        std::cerr << "embed_spirv: cannot write " << outputPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "../include/envmap.hpp"
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+
+glm::vec3 CubemapDirectionFromFaceXY(int face, int x, int y, int faceSize)
+{
+    // [-1,1] に正規化したテクスチャ座標
+    float s = ( (x + 0.5f) / (float)faceSize ) * 2.0f - 1.0f;
+    float t = ( (y + 0.5f) / (float)faceSize ) * 2.0f - 1.0f;
+    t = -t;
+
+    glm::vec3 dir;
+    switch (face)
+    {
+    case 0: // +X
+        dir = glm::vec3( 1.0f,     t,    -s);
+        break;
+    case 1: // -X
+        dir = glm::vec3(-1.0f,     t,     s);
+        break;
+    case 2: // +Y
+        dir = glm::vec3(   s,  1.0f,    -t);
+        break;
+    case 3: // -Y
+        dir = glm::vec3(   s, -1.0f,   t);
+        break;
+    case 4: // +Z
+        dir = glm::vec3(   s,     t,  1.0f);
+        break;
+    case 5: // -Z
+        dir = glm::vec3(  -s,     t, -1.0f);
+        break;
+    }
+    return glm::normalize(dir);
+}
+
+glm::vec4 SampleEquirect(const glm::vec3& dir, const float* src, int w, int h)
+{
+    // dir -> (u,v)
+    float u = std::atan2(dir.z, dir.x) / (2.0f * glm::pi<float>()) + 0.5f;
+    float v = std::acos(std::clamp(dir.y, -1.0f, 1.0f)) / glm::pi<float>();
+
+    int px = std::clamp(int(u * w), 0, w - 1);
+    int py = std::clamp(int(v * h), 0, h - 1);
+
+    const float* p = src + (py * w + px) * 4;
+    return glm::vec4(p[0], p[1], p[2], p[3]);
+}
+
+void convertEquirectToCubemap(const float* src, int w, int h, uint32_t faceSize, std::vector<float>& cube)
+{
+    size_t facePixels = (size_t)faceSize * (size_t)faceSize;
+    cube.resize(6ull * facePixels * 4);
+    for (int face = 0; face < 6; ++face) {
+        for (int y = 0; y < (int)faceSize; ++y) {
+            for (int x = 0; x < (int)faceSize; ++x) {
+                glm::vec3 dir = CubemapDirectionFromFaceXY(face, x, y, faceSize);
+                glm::vec4 c   = SampleEquirect(dir, src, w, h);
+                size_t idx = ( (size_t)face * facePixels + y * faceSize + x ) * 4;
+                cube[idx + 0] = c.r;
+                cube[idx + 1] = c.g;
+                cube[idx + 2] = c.b;
+                cube[idx + 3] = c.a;
+            }
+        }
+    }
+}
@@ -0,0 +1,304 @@
+#include "../include/frame_output.hpp"
+#include "../include/png_encoder.hpp"
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+struct FormatInfo {
+    OutputFormat format;
+    const char* name;
+    const char* extension;
+    bool hdr;
+};
+
+constexpr FormatInfo kFormats[] = {
+    {OutputFormat::Png,      "png",       "png", false},
+    {OutputFormat::PngFast,  "png-fast",  "png", false},
+    {OutputFormat::PngStore, "png-store", "png", false},
+    {OutputFormat::Exr,      "exr",       "exr", true},
+    {OutputFormat::Pfm,      "pfm",       "pfm", true},
+};
+
+const FormatInfo& formatInfo(OutputFormat format){
+    for(const auto& info : kFormats){
+        if(info.format == format) return info;
+    }
+    return kFormats[0];
+}
+
+void put8(std::vector<uint8_t>& out, uint8_t v){ out.push_back(v); }
+
+void put32le(std::vector<uint8_t>& out, uint32_t v){
+    for(int i = 0; i < 4; i++) out.push_back(uint8_t(v >> (8 * i)));
+}
+
+void put64le(std::vector<uint8_t>& out, uint64_t v){
+    for(int i = 0; i < 8; i++) out.push_back(uint8_t(v >> (8 * i)));
+}
+
+void putFloat(std::vector<uint8_t>& out, float v){
+    uint32_t bits;
+    std::memcpy(&bits, &v, 4);
+    put32le(out, bits);
+}
+
+void putString(std::vector<uint8_t>& out, const char* s){
+    out.insert(out.end(), s, s + std::strlen(s) + 1);
+}
+
+// ---- OpenEXR (シングルパート, スキャンライン, 無圧縮) ----
+
+enum ExrPixelType : uint32_t {
+    kExrUint = 0,
+    kExrHalf = 1,
+    kExrFloat = 2,
+};
+
+// 1 チャンネル分。data[(y * width + x) * stride + offset] を読む
+struct ExrChannel {
+    const char* name;
+    ExrPixelType type;
+    const void* data;       // type が kExrUint なら uint32_t, それ以外は float
+    uint32_t stride;
+    uint32_t offset;
+};
+
+bool encodeExrChannels(uint32_t width, uint32_t height, std::vector<ExrChannel> channels, std::vector<uint8_t>& out){
+    // チャンネルは名前順に並べる
+    std::sort(channels.begin(), channels.end(), [](const ExrChannel& a, const ExrChannel& b){
+        return std::strcmp(a.name, b.name) < 0;
+    });
+
+    out.clear();
+    put32le(out, 20000630);   // magic
+    put32le(out, 2);          // version 2, フラグ無し (シングルパートのスキャンライン)
+
+    auto attribute = [&](const char* name, const char* type, uint32_t size){
+        putString(out, name);
+        putString(out, type);
+        put32le(out, size);
+    };
+
+    uint32_t chlistSize = 1;
+    uint32_t lineBytes = 0;
+    for(const auto& ch : channels){
+        chlistSize += uint32_t(std::strlen(ch.name)) + 1 + 16;
+        lineBytes += width * (ch.type == kExrHalf ? 2 : 4);
+    }
+    attribute("channels", "chlist", chlistSize);
+    for(const auto& ch : channels){
+        putString(out, ch.name);
+        put32le(out, ch.type);
+        put32le(out, 0);                  // pLinear + reserved
+        put32le(out, 1);                  // xSampling
+        put32le(out, 1);                  // ySampling
+    }
+    put8(out, 0);
+
+    attribute("compression", "compression", 1);
+    put8(out, 0);                         // NO_COMPRESSION
+
+    for(const char* window : {"dataWindow", "displayWindow"}){
+        attribute(window, "box2i", 16);
+        put32le(out, 0);
+        put32le(out, 0);
+        put32le(out, width - 1);
+        put32le(out, height - 1);
+    }
+
+    attribute("lineOrder", "lineOrder", 1);
+    put8(out, 0);                         // INCREASING_Y
+
+    attribute("pixelAspectRatio", "float", 4);
+    putFloat(out, 1.0f);
+
+    attribute("screenWindowCenter", "v2f", 8);
+    putFloat(out, 0.0f);
+    putFloat(out, 0.0f);
+
+    attribute("screenWindowWidth", "float", 4);
+    putFloat(out, 1.0f);
+
+    put8(out, 0);                         // ヘッダ終端
+
+    // 無圧縮は1ブロック1行
+    const uint64_t tableAt = out.size();
+    const uint64_t blockBytes = 8 + lineBytes;
+    out.reserve(tableAt + 8ull * height + blockBytes * height);
+    for(uint32_t y = 0; y < height; y++){
+        put64le(out, tableAt + 8ull * height + blockBytes * y);
+    }
+
+    for(uint32_t y = 0; y < height; y++){
+        put32le(out, y);
+        put32le(out, lineBytes);
+        for(const auto& ch : channels){
+            const size_t rowStart = size_t(y) * width * ch.stride + ch.offset;
+            for(uint32_t x = 0; x < width; x++){
+                const size_t i = rowStart + size_t(x) * ch.stride;
+                if(ch.type == kExrUint){
+                    put32le(out, static_cast<const uint32_t*>(ch.data)[i]);
+                }else if(ch.type == kExrFloat){
+                    putFloat(out, static_cast<const float*>(ch.data)[i]);
+                }else{
+                    uint16_t h = floatToHalf(static_cast<const float*>(ch.data)[i]);
+                    out.push_back(uint8_t(h));
+                    out.push_back(uint8_t(h >> 8));
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// HALF の R/G/B/A
+bool encodeExr(const OutputFrame& frame, std::vector<uint8_t>& out){
+    const float* hdr = frame.hdr.data();
+    return encodeExrChannels(frame.width, frame.height, {
+        {"R", kExrHalf, hdr, 4, 0},
+        {"G", kExrHalf, hdr, 4, 1},
+        {"B", kExrHalf, hdr, 4, 2},
+        {"A", kExrHalf, hdr, 4, 3},
+    }, out);
+}
+
+// ---- PFM (RGB float, 下の行から, 負のスケールでリトルエンディアン) ----
+
+bool encodePfm(const OutputFrame& frame, std::vector<uint8_t>& out){
+    char header[64];
+    int headerSize = std::snprintf(header, sizeof(header), "PF\n%u %u\n-1.0\n", frame.width, frame.height);
+    out.assign(header, header + headerSize);
+    out.reserve(out.size() + size_t(frame.width) * frame.height * 12);
+    for(uint32_t y = frame.height; y-- > 0;){
+        const float* row = frame.hdr.data() + size_t(y) * frame.width * 4;
+        for(uint32_t x = 0; x < frame.width; x++){
+            putFloat(out, row[x * 4 + 0]);
+            putFloat(out, row[x * 4 + 1]);
+            putFloat(out, row[x * 4 + 2]);
+        }
+    }
+    return true;
+}
+
+}
+
+bool parseOutputFormat(std::string_view name, OutputFormat& format){
+    for(const auto& info : kFormats){
+        if(name == info.name){
+            format = info.format;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* outputFormatName(OutputFormat format){
+    return formatInfo(format).name;
+}
+
+const char* outputExtension(OutputFormat format){
+    return formatInfo(format).extension;
+}
+
+bool outputNeedsHdr(OutputFormat format){
+    return formatInfo(format).hdr;
+}
+
+uint16_t floatToHalf(float value){
+    uint32_t x;
+    std::memcpy(&x, &value, 4);
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t exponent = (x >> 23) & 0xff;
+    uint32_t mantissa = x & 0x7fffff;
+
+    if(exponent == 0xff) return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+    int e = int(exponent) - 127 + 15;
+    if(e >= 31) return uint16_t(sign | 0x7c00);
+    if(e <= 0){
+        // half の非正規化数
+        if(e < -10) return uint16_t(sign);
+        mantissa |= 0x800000;
+        uint32_t shift = uint32_t(14 - e);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if(rest > halfway || (rest == halfway && (half & 1))) half++;
+        return uint16_t(sign | half);
+    }
+
+    // 丸めの繰り上がりで指数が増えても (最大なら Inf) そのまま正しい
+    uint32_t half = (uint32_t(e) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if(rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+    return uint16_t(sign | half);
+}
+
+bool encodeFrame(OutputFormat format, const OutputFrame& frame, std::vector<uint8_t>& out){
+    const size_t pixels = size_t(frame.width) * frame.height;
+    if(outputNeedsHdr(format) ? frame.hdr.size() < pixels * 4 : frame.ldr.size() < pixels * 4) return false;
+
+    switch(format){
+    case OutputFormat::Png:      return encodePng(frame.ldr, frame.width, frame.height, PngOptions{6}, out);
+    case OutputFormat::PngFast:  return encodePng(frame.ldr, frame.width, frame.height, PngOptions{1}, out);
+    case OutputFormat::PngStore: return encodePng(frame.ldr, frame.width, frame.height, PngOptions{0}, out);
+    case OutputFormat::Exr:      return encodeExr(frame, out);
+    case OutputFormat::Pfm:      return encodePfm(frame, out);
+    }
+    return false;
+}
+
+bool encodeAovFrame(const OutputFrame& frame, std::vector<uint8_t>& out){
+    const size_t pixels = size_t(frame.width) * frame.height;
+    if(frame.albedo.size() < pixels * 4 || frame.normal.size() < pixels * 4 ||
+       frame.depth.size() < pixels || frame.ids.size() < pixels * 2) return false;
+
+    const float* albedo = frame.albedo.data();
+    const float* normal = frame.normal.data();
+    return encodeExrChannels(frame.width, frame.height, {
+        {"albedo.R",     kExrHalf,  albedo,              4, 0},
+        {"albedo.G",     kExrHalf,  albedo,              4, 1},
+        {"albedo.B",     kExrHalf,  albedo,              4, 2},
+        {"N.X",          kExrHalf,  normal,              4, 0},
+        {"N.Y",          kExrHalf,  normal,              4, 1},
+        {"N.Z",          kExrHalf,  normal,              4, 2},
+        {"Z",            kExrFloat, frame.depth.data(),  1, 0},
+        {"id.primitive", kExrUint,  frame.ids.data(),    2, 0},
+        {"id.material",  kExrUint,  frame.ids.data(),    2, 1},
+    }, out);
+}
+
+namespace {
+
+bool writeFile(const std::filesystem::path& path, const std::vector<uint8_t>& data){
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    ofs.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+    return bool(ofs);
+}
+
+}
+
+bool writeFrame(const std::filesystem::path& path, OutputFormat format, const OutputFrame& frame){
+    PROFILE_ZONE("writeFrame");
+    std::vector<uint8_t> encoded;
+    {
+        PROFILE_ZONE("encodeFrame");
+        if(!encodeFrame(format, frame, encoded)) return false;
+    }
+    return writeFile(path, encoded);
+}
+
+bool writeAovFrame(const std::filesystem::path& path, const OutputFrame& frame){
+    PROFILE_ZONE("writeAovFrame");
+    std::vector<uint8_t> encoded;
+    {
+        PROFILE_ZONE("encodeAovFrame");
+        if(!encodeAovFrame(frame, encoded)) return false;
+    }
+    return writeFile(path, encoded);
+}
@@ -0,0 +1,73 @@
+#include "../include/frame_queue.hpp"
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+
+FrameQueue::FrameQueue(Consumer frameConsumer, size_t maxPendingFrames)
+    : consumer(std::move(frameConsumer)), maxPending(std::max<size_t>(1, maxPendingFrames)) {
+    worker = std::thread([this]{ run(); });
+}
+
+FrameQueue::~FrameQueue(){
+    finish();
+}
+
+void FrameQueue::push(uint32_t index, const OutputFrame& frame){
+    PROFILE_ZONE("queue frame");
+    Job job;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]{ return pending.size() < maxPending; });
+        if(!spare.empty()){
+            job = std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+    job.index = index;
+    job.width = frame.width;
+    job.height = frame.height;
+    job.ldr.assign(frame.ldr.begin(), frame.ldr.end());
+    job.hdr.assign(frame.hdr.begin(), frame.hdr.end());
+    job.albedo.assign(frame.albedo.begin(), frame.albedo.end());
+    job.normal.assign(frame.normal.begin(), frame.normal.end());
+    job.depth.assign(frame.depth.begin(), frame.depth.end());
+    job.ids.assign(frame.ids.begin(), frame.ids.end());
+    job.variance.assign(frame.variance.begin(), frame.variance.end());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(std::move(job));
+    }
+    changed.notify_all();
+}
+
+void FrameQueue::finish(){
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(!worker.joinable()) return;
+        stopping = true;
+    }
+    changed.notify_all();
+    worker.join();
+}
+
+void FrameQueue::run(){
+    profileThread.track = kTrackWriter;
+    for(;;){
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]{ return !pending.empty() || stopping; });
+            if(pending.empty()) return;
+            job = std::move(pending.front());
+            pending.pop_front();
+        }
+        changed.notify_all();
+
+        profileThread.frame = job.index;
+        OutputFrame frame{job.width, job.height, job.ldr, job.hdr, job.albedo, job.normal, job.depth, job.ids, job.variance};
+        consumer(job.index, frame);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        spare.push_back(std::move(job));
+    }
+}
@@ -1,9 +1,11 @@
 #include "../include/globals.hpp"
 #include "../include/buffer.hpp"
 #include "../include/accel.hpp"
+#include "../include/profiler.hpp"
 #include <iostream>
 
 void createBLAS(){
+    PROFILE_ZONE("createBLAS");
     vk::BufferUsageFlags bufferUsage{
         vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR |
         vk::BufferUsageFlagBits::eShaderDeviceAddress |
@@ -13,12 +15,12 @@ void createBLAS(){
         vk::MemoryPropertyFlagBits::eHostCoherent};
 
     vertexBuffer.init(
-        physicalDevice, *device, vertices.size() * sizeof(vertices[0]),
-        bufferUsage, memoryProperty, vertices.data());
+        physicalDevice, *device, sceneView.vertices.size() * sizeof(Vertex),
+        bufferUsage, memoryProperty, sceneView.vertices.data());
 
     indexBuffer.init(
-        physicalDevice, *device, indices.size() * sizeof(uint32_t),
-        bufferUsage, memoryProperty, indices.data());
+        physicalDevice, *device, sceneView.indices.size() * sizeof(uint32_t),
+        bufferUsage, memoryProperty, sceneView.indices.data());
 
     vk::BufferDeviceAddressInfoKHR vertAddress{};
     vk::BufferDeviceAddressInfoKHR indexAddress{};
@@ -30,7 +32,7 @@ void createBLAS(){
     triangles.setVertexFormat(vk::Format::eR32G32B32Sfloat);
     triangles.setVertexData(device->getBufferAddressKHR(&vertAddress));
     triangles.setVertexStride(sizeof(Vertex));
-    triangles.setMaxVertex(static_cast<uint32_t>(vertices.size()));
+    triangles.setMaxVertex(static_cast<uint32_t>(sceneView.vertices.size()));
     triangles.setIndexType(vk::IndexType::eUint32);
     triangles.setIndexData(device->getBufferAddressKHR(&indexAddress));
 
@@ -39,7 +41,7 @@ void createBLAS(){
     geometry.setGeometry({triangles});
     geometry.setFlags(vk::GeometryFlagBitsKHR::eOpaque);
 
-    uint32_t primitiveCount = static_cast<uint32_t>(indices.size() / 3);
+    uint32_t primitiveCount = static_cast<uint32_t>(sceneView.indices.size() / 3);
     bottomAccel.init(
         physicalDevice, *device, commandPool.get(), queue,
         vk::AccelerationStructureTypeKHR::eBottomLevel,
@@ -47,6 +49,7 @@ void createBLAS(){
 }
 
 void createTLAS(){
+    PROFILE_ZONE("createTLAS");
     vk::TransformMatrixKHR transform = std::array{
         std::array{1.0f, 0.0f, 0.0f, 0.0f},
         std::array{0.0f, 1.0f, 0.0f, 0.0f},
@@ -14,17 +14,21 @@ uint32_t alignUp(uint32_t size, uint32_t alignment) {
 
 SceneUBO scene = {
     {
-        glm::vec4(glm::normalize(glm::vec3(1.0f, -2.0f, -3.0f)), 0.0f), // Light dir
-        glm::vec4(0.2f, 0.2f, 0.2f, 0.0f) // Light color
+        glm::vec4(glm::normalize(glm::vec3(1.0f, -2.0f, -3.0f)), 0.0f), // Light dir (光の進む向き)
+        glm::vec4(0.2f, 0.2f, 0.2f, 0.0f) // Light color (太陽方向に垂直な面での放射照度)
     },
-    glm::vec4(-1.0f, -2.0f, 3.0f, 1.0f) // Camera Position
+    glm::vec4(-1.0f, -2.0f, 3.0f, 0.41421356f), // Camera Position (w: tan(縦の画角 / 2))
+    glm::vec4(0.0f, 0.0f, -1.0f, 0.0f),  // Camera Forward
+    glm::vec4(1.0f, 0.0f, 0.0f, 0.0f),   // Camera Right
+    glm::vec4(0.0f, 1.0f, 0.0f, 0.0f),   // Camera Up
+    glm::uvec4(0u)                        // Sampling
 };
 void* sceneData;
 
-std::vector<Vertex> vertices;
-std::vector<uint32_t> indices;
-std::vector<Material> materials;
-std::vector<uint32_t> primitiveMaterialIndices;
+SceneAssets assets;
+CameraTimeline cameraTimeline;
+SceneCache sceneCache;
+SceneView sceneView;
 
 //GLFWwindow* window;
 std::vector<const char*> extensions;
@@ -43,9 +47,12 @@ vk::Queue queue;
 uint32_t queueFamily = (uint32_t)-1;
 
 vk::UniqueCommandPool commandPool;
+vk::UniqueQueryPool timestampQueryPool;
 std::vector<vk::UniqueCommandBuffer> cmdBufs;
 
+vk::UniquePipelineCache pipelineCache;
 vk::UniquePipeline pipeline;
+ShaderConstants pipelineConstants{};
 vk::UniquePipelineLayout pipelineLayout;
 
 vk::UniqueShaderModule vertShader;
@@ -60,13 +67,61 @@ Buffer indexBuffer;
 Buffer materialBuffer;
 Buffer materialIndexBuffer;
 Buffer sceneBuffer;
+Buffer sobolBuffer;
 std::vector<Buffer> textureBuffers;
 std::vector<Buffer> envTexBuffers(1);
 
 Buffer outputBuffer;
+Buffer hdrBuffer;
+Buffer albedoBuffer;
+Buffer normalBuffer;
+Buffer depthBuffer;
+Buffer idBuffer;
+Buffer pathStatsBuffer;
+void* pathStatsData;
+Buffer pixelAccumBuffer;
+void* pixelAccumData;
+Buffer activePixelBuffer;
+void* activePixelData;
+vk::UniqueImage hdrImage;
+vk::UniqueDeviceMemory hdrMemory;
+vk::UniqueImageView hdrView;
 vk::UniqueImage outputImage;
 vk::UniqueDeviceMemory outputMemory;
 vk::UniqueImageView outputView;
+vk::UniqueImage albedoImage;
+vk::UniqueDeviceMemory albedoMemory;
+vk::UniqueImageView albedoView;
+vk::UniqueImage normalImage;
+vk::UniqueDeviceMemory normalMemory;
+vk::UniqueImageView normalView;
+vk::UniqueImage depthImage;
+vk::UniqueDeviceMemory depthMemory;
+vk::UniqueImageView depthView;
+vk::UniqueImage idImage;
+vk::UniqueDeviceMemory idMemory;
+vk::UniqueImageView idView;
+
+vk::UniqueShaderModule tonemapShader;
+vk::UniqueDescriptorSetLayout tonemapDescSetLayout;
+vk::UniqueDescriptorPool tonemapDescPool;
+vk::UniqueDescriptorSet tonemapDescSet;
+vk::UniquePipelineLayout tonemapPipelineLayout;
+vk::UniquePipeline tonemapPipeline;
+
+std::vector<vk::UniqueImage> historyColorImages;
+std::vector<vk::UniqueDeviceMemory> historyColorMemorys;
+std::vector<vk::UniqueImageView> historyColorViews;
+std::vector<vk::UniqueImage> historyGeometryImages;
+std::vector<vk::UniqueDeviceMemory> historyGeometryMemorys;
+std::vector<vk::UniqueImageView> historyGeometryViews;
+
+vk::UniqueShaderModule temporalShader;
+vk::UniqueDescriptorSetLayout temporalDescSetLayout;
+vk::UniqueDescriptorPool temporalDescPool;
+std::vector<vk::UniqueDescriptorSet> temporalDescSets;
+vk::UniquePipelineLayout temporalPipelineLayout;
+vk::UniquePipeline temporalPipeline;
 
 vk::UniqueImage image;
 
@@ -90,10 +145,8 @@ std::vector<vk::UniqueDescriptorSet> descSets;
 AccelStruct bottomAccel{};
 AccelStruct topAccel{};
 
-Buffer sbt{};
+Buffer sbt;
 vk::StridedDeviceAddressRegionKHR raygenRegion{};
 vk::StridedDeviceAddressRegionKHR missRegion{};
 vk::StridedDeviceAddressRegionKHR hitRegion{};
 
-tinygltf::Model model;
-tinygltf::TinyGLTF loader;
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "../include/gltf_source.hpp"
+#include "../include/profiler.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr uint32_t kGlbMagic     = 0x46546C67; // "glTF"
+constexpr uint32_t kGlbChunkJson = 0x4E4F534A; // "JSON"
+constexpr uint32_t kGlbChunkBin  = 0x004E4942; // "BIN\0"
+
+// tinygltf に渡す中身の無いバッファ (1 byte)。本物は GltfSource::buffers にある
+const char* kStubBufferUri = "data:application/octet-stream;base64,AA==";
+
+uint32_t readU32(const uint8_t* p){
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+bool isDataUri(const std::string& uri){
+    return uri.rfind("data:", 0) == 0;
+}
+
+std::filesystem::path pathFromUtf8(const std::string& s){
+    return std::filesystem::path(std::u8string(s.begin(), s.end()));
+}
+
+int hexDigit(char c){
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// "%20" などをデコードする。16 進 2 桁が続かない % はそのまま残す
+std::string decodeUri(const std::string& uri){
+    std::string out;
+    out.reserve(uri.size());
+    for(size_t i = 0; i < uri.size(); i++){
+        if(uri[i] == '%' && i + 2 < uri.size()){
+            int hi = hexDigit(uri[i + 1]);
+            int lo = hexDigit(uri[i + 2]);
+            if(hi >= 0 && lo >= 0){
+                out += char(hi * 16 + lo);
+                i += 2;
+                continue;
+            }
+        }
+        out += uri[i];
+    }
+    return out;
+}
+
+bool splitGlb(std::span<const uint8_t> file, std::span<const uint8_t>& json, std::span<const uint8_t>& bin, std::string& err){
+    if(file.size() < 20 || readU32(file.data() + 4) != 2){
+        err = "unsupported GLB header";
+        return false;
+    }
+    uint32_t length = readU32(file.data() + 8);
+    if(length > file.size()){
+        err = "GLB length exceeds file size";
+        return false;
+    }
+    size_t offset = 12;
+    while(offset + 8 <= length){
+        uint32_t chunkLength = readU32(file.data() + offset);
+        uint32_t chunkType   = readU32(file.data() + offset + 4);
+        offset += 8;
+        if(chunkLength > length - offset){
+            err = "GLB chunk exceeds file size";
+            return false;
+        }
+        if(chunkType == kGlbChunkJson && json.empty()) json = file.subspan(offset, chunkLength);
+        else if(chunkType == kGlbChunkBin && bin.empty()) bin = file.subspan(offset, chunkLength);
+        offset += (chunkLength + 3) & ~3u;
+    }
+    if(json.empty()){
+        err = "GLB has no JSON chunk";
+        return false;
+    }
+    return true;
+}
+
+}
+
+std::vector<std::span<const uint8_t>> modelBufferSpans(const tinygltf::Model& model){
+    std::vector<std::span<const uint8_t>> spans;
+    spans.reserve(model.buffers.size());
+    for(const auto& buffer : model.buffers){
+        spans.emplace_back(buffer.data.data(), buffer.data.size());
+    }
+    return spans;
+}
+
+bool openGltf(const std::filesystem::path& path, GltfSource& source, std::string& err){
+    PROFILE_ZONE("openGltf");
+    source = {};
+    std::filesystem::path baseDir = path.parent_path();
+
+    MappedFile file;
+    if(!file.open(path)){
+        err = "failed to open " + path.string();
+        return false;
+    }
+    source.sourceFiles.push_back(path);
+
+    std::span<const uint8_t> json;
+    std::span<const uint8_t> bin;
+    bool isGlb = file.size >= 4 && readU32(file.data) == kGlbMagic;
+    if(isGlb){
+        if(!splitGlb(file.bytes(), json, bin, err)) return false;
+    }else{
+        json = file.bytes();
+    }
+
+    nlohmann::json doc = nlohmann::json::parse(json.begin(), json.end(), nullptr, false);
+    if(doc.is_discarded()){
+        err = "failed to parse JSON in " + path.string();
+        return false;
+    }
+    source.mappings.push_back(std::move(file));
+
+    // バッファを解決して、tinygltf には中身の無いバッファを見せる
+    if(doc.contains("buffers")){
+        for(auto& b : doc["buffers"]){
+            size_t byteLength = b.value("byteLength", size_t(0));
+            std::string uri = b.value("uri", std::string());
+            std::span<const uint8_t> data;
+
+            if(uri.empty()){
+                if(!isGlb || source.buffers.size() != 0 || bin.size() < byteLength){
+                    err = "buffer without uri must be the GLB BIN chunk";
+                    return false;
+                }
+                data = bin.first(byteLength);
+            }else if(isDataUri(uri)){
+                std::vector<unsigned char> decoded;
+                std::string mimeType;
+                if(!tinygltf::DecodeDataURI(&decoded, mimeType, uri, byteLength, true)){
+                    err = "failed to decode data URI buffer";
+                    return false;
+                }
+                source.ownedBuffers.push_back(std::move(decoded));
+                data = {source.ownedBuffers.back().data(), byteLength};
+            }else{
+                std::filesystem::path binPath = baseDir / pathFromUtf8(decodeUri(uri));
+                MappedFile binFile;
+                if(!binFile.open(binPath) || binFile.size < byteLength){
+                    err = "failed to map buffer " + binPath.string();
+                    return false;
+                }
+                data = {binFile.data, byteLength};
+                source.mappings.push_back(std::move(binFile));
+                source.sourceFiles.push_back(binPath);
+            }
+            source.buffers.push_back(data);
+            b = {{"byteLength", 1}, {"uri", kStubBufferUri}};
+        }
+    }
+
+    // 画像のデコードは scene.cpp 側で行うので tinygltf には読ませない
+    nlohmann::json images = nlohmann::json::array();
+    if(doc.contains("images")){
+        images = std::move(doc["images"]);
+        doc["images"] = nlohmann::json::array();
+    }
+
+    std::string stripped = doc.dump();
+    tinygltf::TinyGLTF loader;
+    std::string warn;
+    bool ok = loader.LoadASCIIFromString(&source.model, &err, &warn,
+                                         stripped.c_str(), unsigned(stripped.size()), baseDir.string());
+    if(!warn.empty()) std::cerr << "[tinygltf warn] " << warn << "\n";
+    if(!ok) return false;
+
+    for(const auto& img : images){
+        GltfImage image;
+        image.mimeType = img.value("mimeType", std::string());
+        std::string uri = img.value("uri", std::string());
+        int bufferView = img.value("bufferView", -1);
+        if(bufferView >= 0){
+            if(size_t(bufferView) >= source.model.bufferViews.size()){
+                err = "image bufferView out of range";
+                return false;
+            }
+            const auto& view = source.model.bufferViews[bufferView];
+            const auto& buffer = source.buffers.at(view.buffer);
+            if(view.byteOffset > buffer.size() || view.byteLength > buffer.size() - view.byteOffset){
+                err = "image bufferView out of bounds";
+                return false;
+            }
+            image.bytes = buffer.subspan(view.byteOffset, view.byteLength);
+        }else if(isDataUri(uri)){
+            std::vector<unsigned char> decoded;
+            if(!tinygltf::DecodeDataURI(&decoded, image.mimeType, uri, 0, false)){
+                err = "failed to decode data URI image";
+                return false;
+            }
+            source.ownedBuffers.push_back(std::move(decoded));
+            image.bytes = source.ownedBuffers.back();
+        }else{
+            image.uri = decodeUri(uri);
+        }
+        source.images.push_back(std::move(image));
+    }
+    return true;
+}
@@ -0,0 +1,90 @@
+#include "../include/globals.hpp"
+#include "../include/gpu_profiler.hpp"
+#include "../include/profiler.hpp"
+
+namespace {
+
+constexpr uint32_t kMaxTimestampQueries = 64;
+
+struct GpuZone {
+    const char* name;
+    uint32_t beginQuery;
+    uint32_t endQuery;
+};
+
+double timestampPeriodNs = 0.0;
+uint64_t timestampMask = 0;
+uint32_t queryCount = 0;
+std::vector<GpuZone> zones;
+std::vector<uint32_t> openZones;
+
+bool enabled(){
+    return static_cast<bool>(timestampQueryPool);
+}
+
+}
+
+void createTimestampQueryPool(){
+    vk::PhysicalDeviceProperties props = physicalDevice.getProperties();
+    uint32_t validBits = physicalDevice.getQueueFamilyProperties()[queueFamily].timestampValidBits;
+    if (validBits == 0 || props.limits.timestampPeriod <= 0.0f) {
+        std::cout << "timestamp queries not supported, GPU zones disabled" << std::endl;
+        return;
+    }
+
+    timestampPeriodNs = props.limits.timestampPeriod;
+    timestampMask = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+
+    vk::QueryPoolCreateInfo createInfo{};
+    createInfo.setQueryType(vk::QueryType::eTimestamp);
+    createInfo.setQueryCount(kMaxTimestampQueries);
+    timestampQueryPool = device->createQueryPoolUnique(createInfo);
+}
+
+void gpuTimerBegin(vk::CommandBuffer cmdBuf){
+    queryCount = 0;
+    zones.clear();
+    openZones.clear();
+    if (!enabled()) return;
+    cmdBuf.resetQueryPool(timestampQueryPool.get(), 0, kMaxTimestampQueries);
+}
+
+void gpuZoneBegin(vk::CommandBuffer cmdBuf, const char* name){
+    if (!enabled() || queryCount + 2 > kMaxTimestampQueries) return;
+    uint32_t query = queryCount++;
+    cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestampQueryPool.get(), query);
+    openZones.push_back(static_cast<uint32_t>(zones.size()));
+    zones.push_back({name, query, query});
+}
+
+void gpuZoneEnd(vk::CommandBuffer cmdBuf){
+    if (!enabled() || openZones.empty()) return;
+    uint32_t query = queryCount++;
+    cmdBuf.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestampQueryPool.get(), query);
+    zones[openZones.back()].endQuery = query;
+    openZones.pop_back();
+}
+
+void gpuTimerCollect(double submitUs){
+    if (!enabled() || queryCount == 0) return;
+
+    std::vector<uint64_t> ticks(queryCount);
+    auto result = device->getQueryPoolResults(
+        timestampQueryPool.get(), 0, queryCount,
+        ticks.size() * sizeof(uint64_t), ticks.data(), sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+    if (result != vk::Result::eSuccess) return;
+
+    // GPU と CPU の時計は揃っていないので、最初の timestamp を submit 時刻に合わせる
+    const uint64_t first = ticks[0] & timestampMask;
+    for (const auto& z : zones) {
+        if (z.endQuery == z.beginQuery) continue;
+        uint64_t begin = ticks[z.beginQuery] & timestampMask;
+        uint64_t end = ticks[z.endQuery] & timestampMask;
+        double startUs = submitUs + double(begin - first) * timestampPeriodNs / 1000.0;
+        double durationUs = double(end - begin) * timestampPeriodNs / 1000.0;
+        profiler.addEvent(z.name, kTrackGpu, startUs, durationUs);
+    }
+    queryCount = 0;
+    zones.clear();
+}
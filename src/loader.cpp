@@ -1,391 +1,168 @@
 #include "../include/globals.hpp"
 #include "../include/buffer.hpp"
+#include "../include/profiler.hpp"
+#include "../include/scene.hpp"
+#include "../include/scene_cache.hpp"
+#include "../include/mipmap.hpp"
+#include <algorithm>
+#include <cstring>
 #include <glm/glm.hpp>
 #include <iostream>
 
-glm::vec3 CubemapDirectionFromFaceXY(int face, int x, int y, int faceSize)
-{
-    // [-1,1] に正規化したテクスチャ座標
-    float s = ( (x + 0.5f) / (float)faceSize ) * 2.0f - 1.0f;
-    float t = ( (y + 0.5f) / (float)faceSize ) * 2.0f - 1.0f;
-    t = -t;
+// SceneView (SceneAssets か mmap したシーンキャッシュ) を GPU にアップロードするバックエンド
 
-    glm::vec3 dir;
-    switch (face)
-    {
-    case 0: // +X
-        dir = glm::vec3( 1.0f,     t,    -s);
-        break;
-    case 1: // -X
-        dir = glm::vec3(-1.0f,     t,     s);
-        break;
-    case 2: // +Y
-        dir = glm::vec3(   s,  1.0f,    -t);
-        break;
-    case 3: // -Y
-        dir = glm::vec3(   s, -1.0f,   t);
-        break;
-    case 4: // +Z
-        dir = glm::vec3(   s,     t,  1.0f);
-        break;
-    case 5: // -Z
-        dir = glm::vec3(  -s,     t, -1.0f);
-        break;
-    }
-    return glm::normalize(dir);
-}
-
-glm::vec4 SampleEquirect(const glm::vec3& dir, const float* src, int w, int h)
-{
-    // dir -> (u,v)
-    float u = std::atan2(dir.z, dir.x) / (2.0f * float(M_PI)) + 0.5f;
-    float v = std::acos(std::clamp(dir.y, -1.0f, 1.0f)) / float(M_PI);
-
-    int px = std::clamp(int(u * w), 0, w - 1);
-    int py = std::clamp(int(v * h), 0, h - 1);
-
-    const float* p = src + (py * w + px) * 4;
-    return glm::vec4(p[0], p[1], p[2], p[3]);
-}
+namespace {
 
-void loadModel(std::string resourcePath){
-    std::string gltfPath = resourcePath + "\\mesh\\test.gltf";
-    std::string err, warn;
-
-    bool ret = loader.LoadASCIIFromFile(&model, &err, &warn, gltfPath);
-    if(!warn.empty()) std::cerr << "[tinygltf warn] " << warn << "\n";
-    if(!ret){
-        std::cerr << "[tinygltf err] " << err << "\n";
-        std::cerr << "Failed to load: " << gltfPath << "\n";
-        std::cerr << "Working dir: " << std::filesystem::current_path().string() << "\n";
-        std::abort();
-    }
-
-    size_t meshCount = 0;
-    for (size_t gltfMeshIndex = 0; gltfMeshIndex < model.meshes.size(); gltfMeshIndex++) {
-        auto& gltfMesh = model.meshes.at(gltfMeshIndex);
-        meshCount += gltfMesh.primitives.size();
-    }
-
-    size_t meshIndex = 0;
-    for(int gltfMeshIndex = 0; gltfMeshIndex < model.meshes.size(); gltfMeshIndex++){
-        auto& gltfMesh = model.meshes.at(gltfMeshIndex);
-        for(const auto& gltfPrimitive : gltfMesh.primitives){
-            uint32_t vertexOffset = static_cast<uint32_t>(vertices.size());
-
-            // Vertex Attributes
-            auto& attributes = gltfPrimitive.attributes;
-
-            assert(attributes.find("POSITION") != attributes.end());
-            int positionIndex = attributes.find("POSITION")->second;
-            tinygltf::Accessor* positionAccessor = &model.accessors[positionIndex];
-            tinygltf::BufferView* positionBufferView = &model.bufferViews[positionAccessor->bufferView];
-
-            tinygltf::Accessor* normalAccessor = nullptr;
-            tinygltf::BufferView* normalBufferView = nullptr;
-            if(attributes.find("NORMAL") != attributes.end()){
-                int normalIndex = attributes.find("NORMAL")->second;
-                normalAccessor = &model.accessors[normalIndex];
-                normalBufferView = &model.bufferViews[normalAccessor->bufferView];
-            }
-
-            tinygltf::Accessor* texCoordAccessor = nullptr;
-            tinygltf::BufferView* texCoordBufferView = nullptr;
-            if(attributes.find("TEXCOORD_0") != attributes.end()){
-                int texCoordIndex = attributes.find("TEXCOORD_0")->second;
-                texCoordAccessor = &model.accessors[texCoordIndex];
-                texCoordBufferView = &model.bufferViews[texCoordAccessor->bufferView];
-            }
-
-            const auto getByteStride = [&](tinygltf::BufferView* bufferView, size_t defaultSize)->size_t{
-                if(bufferView->byteStride > 0){
-                    return bufferView->byteStride;
-                }
-                return defaultSize;
-            };
-
-            for(size_t i = 0; i < positionAccessor->count; i++){
-                Vertex v{};
-                {
-                    size_t byteStride = getByteStride(positionBufferView, sizeof(glm::vec3));
-                    size_t positionByteOffset = positionAccessor->byteOffset +
-                                                positionBufferView->byteOffset + i * byteStride;
-                    v.pos = *reinterpret_cast<const glm::vec3*>(
-                        &(model.buffers[positionBufferView->buffer].data[positionByteOffset]));
-                }
-
-                if(normalBufferView){
-                    size_t byteStride = getByteStride(normalBufferView, sizeof(glm::vec3));
-                    size_t normalByteOffset = normalAccessor->byteOffset +
-                                                normalBufferView->byteOffset + i * byteStride;
-                    v.normal = *reinterpret_cast<const glm::vec3*>(
-                        &(model.buffers[normalBufferView->buffer].data[normalByteOffset]));
-                }
-                if(texCoordBufferView){
-                    size_t byteStride = getByteStride(texCoordBufferView, sizeof(glm::vec2));
-                    size_t texCoordByteOffset = texCoordAccessor->byteOffset +
-                                                texCoordBufferView->byteOffset + i * byteStride;
-                    v.texCoord = *reinterpret_cast<const glm::vec2*>(
-                        &(model.buffers[texCoordBufferView->buffer].data[texCoordByteOffset]));
-                }
-                vertices.push_back(v);
-            }
-
-            {
-                auto& accessor   = model.accessors[gltfPrimitive.indices];
-                size_t indexCount = accessor.count;
-                size_t triCount   = indexCount / 3;
-
-                uint32_t matId = (gltfPrimitive.material >= 0) ? (uint32_t)gltfPrimitive.material : 0u;
-
-                for(size_t t = 0; t < triCount; ++t){
-                    primitiveMaterialIndices.push_back(matId);
-                }
-
-                vk::BufferUsageFlags bufferUsage{vk::BufferUsageFlagBits::eStorageBuffer};
-                vk::MemoryPropertyFlags memoryProperty{
-                    vk::MemoryPropertyFlagBits::eHostVisible |
-                    vk::MemoryPropertyFlagBits::eHostCoherent};
-
-                materialIndexBuffer.init(
-                    physicalDevice, *device, sizeof(uint32_t) * primitiveMaterialIndices.size(),
-                    bufferUsage, memoryProperty, primitiveMaterialIndices.data());
-            }
-
-            {
-                auto& accessor = model.accessors[gltfPrimitive.indices];
-                auto& bufferView = model.bufferViews[accessor.bufferView];
-                auto& buffer = model.buffers[bufferView.buffer];
-
-                size_t indicesCount = accessor.count;
-                switch(accessor.componentType){
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-                        uint32_t* buf = new uint32_t[indicesCount];
-                        size_t size = indicesCount * sizeof(uint32_t);
-                        std::memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset],
-                                    size);
-                        for (size_t i = 0; i < indicesCount; i++) {
-                            indices.push_back(buf[i] + vertexOffset);
-                        }
-                        break;
-                    }
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-                        uint16_t* buf = new uint16_t[indicesCount];
-                        size_t size = indicesCount * sizeof(uint16_t);
-                        std::memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset],
-                                    size);
-                        for (size_t i = 0; i < indicesCount; i++) {
-                            indices.push_back(buf[i] + vertexOffset);
-                        }
-                        break;
-                    }
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-                        uint8_t* buf = new uint8_t[indicesCount];
-                        size_t size = indicesCount * sizeof(uint8_t);
-                        std::memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset],
-                                    size);
-                        for (size_t i = 0; i < indicesCount; i++) {
-                            indices.push_back(buf[i] + vertexOffset);
-                        }
-                        break;
-                    }
-                    default:
-                        return;
-                }
-            }
+uint32_t findDeviceLocalMemory(const vk::MemoryRequirements& memReq){
+    auto memProps = physicalDevice.getMemoryProperties();
+    for(uint32_t i = 0; i < memProps.memoryTypeCount; i++){
+        if((memReq.memoryTypeBits & (1 << i)) &&
+        (memProps.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal))
+        {
+            return i;
         }
     }
+    return 0;
 }
 
-void loadTexture(std::string resourcePath){
-    std::string gltfPath = resourcePath + "\\mesh\\test.gltf";
-    std::string envMapPath = resourcePath + "\\envmap\\env.hdr";
+// sRGB のテクスチャはサンプリング時にハードウェアで線形に戻す (BC4/BC5 はデータ用なので UNORM のまま)
+vk::Format textureVkFormat(TextureFormat format, bool srgb){
+    switch(format){
+    case TextureFormat::BC1: return srgb ? vk::Format::eBc1RgbaSrgbBlock : vk::Format::eBc1RgbaUnormBlock;
+    case TextureFormat::BC4: return vk::Format::eBc4UnormBlock;
+    case TextureFormat::BC5: return vk::Format::eBc5UnormBlock;
+    case TextureFormat::BC7: return srgb ? vk::Format::eBc7SrgbBlock : vk::Format::eBc7UnormBlock;
+    default: return srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+    }
+}
 
-    textureImages.clear();
-    textureMemorys.clear();
-    textureImageViews.clear();
+struct ImageUpload {
+    vk::Image image;
+    uint32_t levelCount;
+    uint32_t layerCount;
+    std::vector<vk::BufferImageCopy> copies;
+};
 
-    std::string baseDir = gltfPath.substr(0, gltfPath.find_last_of("/\\") + 1);
+// 1つの staging バッファから複数の画像へまとめてコピーし、ShaderReadOnly に遷移させる
+void uploadImages(vk::Buffer staging, const std::vector<ImageUpload>& uploads){
+    if(uploads.empty()) return;
+    vk::CommandBufferAllocateInfo tmpCmdBufAllocInfo;
+    tmpCmdBufAllocInfo.commandPool = commandPool.get();
+    tmpCmdBufAllocInfo.commandBufferCount = 1;
+    tmpCmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
+    std::vector<vk::UniqueCommandBuffer> tmpCmdBufs = device->allocateCommandBuffersUnique(tmpCmdBufAllocInfo);
 
-    if(model.images.size() == 0){
-        const unsigned char* data = nullptr;
-        std::string texPath = baseDir + "../texture/dummy.jpg";
-        int width = 0;
-        int height = 0;
-        int comp = 4;
-        auto loaded = stbi_load(texPath.c_str(), &width, &height, &comp, STBI_rgb_alpha);
+    vk::CommandBufferBeginInfo cmdBeginInfo;
+    cmdBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
 
-        size_t imgDataSize = 4 * width * height;
+    const auto makeBarrier = [](const ImageUpload& upload, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+                                vk::AccessFlags srcAccess, vk::AccessFlags dstAccess){
+        vk::ImageMemoryBarrier barrior;
+        barrior.oldLayout = oldLayout;
+        barrior.newLayout = newLayout;
+        barrior.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrior.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrior.image = upload.image;
+        barrior.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+        barrior.subresourceRange.baseMipLevel = 0;
+        barrior.subresourceRange.levelCount = upload.levelCount;
+        barrior.subresourceRange.baseArrayLayer = 0;
+        barrior.subresourceRange.layerCount = upload.layerCount;
+        barrior.srcAccessMask = srcAccess;
+        barrior.dstAccessMask = dstAccess;
+        return barrior;
+    };
+
+    std::vector<vk::ImageMemoryBarrier> toTransfer, toShader;
+    for(const auto& upload : uploads){
+        toTransfer.push_back(makeBarrier(upload, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+                                         {}, vk::AccessFlagBits::eTransferWrite));
+        toShader.push_back(makeBarrier(upload, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+                                       vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead));
+    }
 
-        Buffer buffer;
-        buffer.init(
-            physicalDevice, *device, imgDataSize,
-            vk::BufferUsageFlagBits::eTransferSrc,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-            data);
-        textureBuffers.push_back(std::move(buffer));
-        stbi_image_free((void*)data);
+    tmpCmdBufs[0]->begin(cmdBeginInfo);
+    tmpCmdBufs[0]->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTopOfPipe,
+        vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, toTransfer);
+    for(const auto& upload : uploads){
+        tmpCmdBufs[0]->copyBufferToImage(staging, upload.image, vk::ImageLayout::eTransferDstOptimal, upload.copies);
+    }
+    tmpCmdBufs[0]->pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eRayTracingShaderKHR, {}, {}, {}, toShader);
+    tmpCmdBufs[0]->end();
 
-        vk::ImageCreateInfo imgCI{};
-        imgCI.setImageType(vk::ImageType::e2D);
-        imgCI.setExtent(vk::Extent3D{(uint32_t)width, (uint32_t)height, 1});
-        imgCI.setMipLevels(1); imgCI.setArrayLayers(1);
-        imgCI.setFormat(vk::Format::eR8G8B8A8Unorm);
-        imgCI.setTiling(vk::ImageTiling::eOptimal);
-        imgCI.setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
-        imgCI.setSamples(vk::SampleCountFlagBits::e1);
-        imgCI.setSharingMode(vk::SharingMode::eExclusive);
+    vk::CommandBuffer submitCmdBuf[1] = {tmpCmdBufs[0].get()};
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBufferCount(1);
+    submitInfo.setPCommandBuffers(submitCmdBuf);
 
-        auto image = device->createImageUnique(imgCI);
-        auto memReq = device->getImageMemoryRequirements(image.get());
-        uint32_t memIndex = 0;
-        for(uint32_t i = 0; i < physicalDevice.getMemoryProperties().memoryTypeCount; i++){
-            if((memReq.memoryTypeBits & (1 << i)) &&
-            (physicalDevice.getMemoryProperties().memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal))
-            {
-                memIndex = i; break;
-            }
-        }
+    queue.submit({submitInfo});
+    queue.waitIdle();
+}
 
-        vk::MemoryAllocateInfo mAI{memReq.size, memIndex};
-        auto mem = device->allocateMemoryUnique(mAI);
-        device->bindImageMemory(image.get(), mem.get(), 0);
+}
 
-        vk::CommandBufferAllocateInfo tmpCmdBufAllocInfo;
-        tmpCmdBufAllocInfo.commandPool = commandPool.get();
-        tmpCmdBufAllocInfo.commandBufferCount = 1;
-        tmpCmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
-        std::vector<vk::UniqueCommandBuffer> tmpCmdBufs = device->allocateCommandBuffersUnique(tmpCmdBufAllocInfo);
+void uploadGeometry(){
+    PROFILE_ZONE("uploadGeometry");
+    vk::BufferUsageFlags bufferUsage{vk::BufferUsageFlagBits::eStorageBuffer};
+    vk::MemoryPropertyFlags memoryProperty{
+        vk::MemoryPropertyFlagBits::eHostVisible |
+        vk::MemoryPropertyFlagBits::eHostCoherent};
 
-        vk::CommandBufferBeginInfo cmdBeginInfo;
-        cmdBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    materialIndexBuffer.init(
+        physicalDevice, *device, sizeof(uint32_t) * sceneView.primitiveMaterialIndices.size(),
+        bufferUsage, memoryProperty, sceneView.primitiveMaterialIndices.data());
+}
 
-        tmpCmdBufs[0]->begin(cmdBeginInfo);
-        {
-            vk::ImageMemoryBarrier barrior;
-            barrior.oldLayout = vk::ImageLayout::eUndefined;
-            barrior.newLayout = vk::ImageLayout::eTransferDstOptimal;
-            barrior.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrior.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrior.image = image.get();
-            barrior.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-            barrior.subresourceRange.baseMipLevel = 0;
-            barrior.subresourceRange.levelCount = 1;
-            barrior.subresourceRange.baseArrayLayer = 0;
-            barrior.subresourceRange.layerCount = 1;
-            barrior.srcAccessMask = {};
-            barrior.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-
-            tmpCmdBufs[0]->pipelineBarrier(
-                vk::PipelineStageFlagBits::eTopOfPipe,
-                vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, {barrior});
-        }
-        {
-            vk::BufferImageCopy imgCopyRegion;
-            imgCopyRegion.setBufferOffset(0);
-            imgCopyRegion.imageSubresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
-            imgCopyRegion.imageSubresource.setMipLevel(0);
-            imgCopyRegion.imageSubresource.setBaseArrayLayer(0);
-            imgCopyRegion.imageSubresource.setLayerCount(1);
-            imgCopyRegion.setImageOffset(vk::Offset3D{0, 0, 0});
-            imgCopyRegion.setImageExtent({uint32_t(width), uint32_t(height), 1});
-            imgCopyRegion.setBufferRowLength(0);
-            imgCopyRegion.setBufferImageHeight(0);
+void uploadTextures(){
+    PROFILE_ZONE("uploadTextures");
+    textureImages.clear();
+    textureMemorys.clear();
+    textureImageViews.clear();
+    textureBuffers.clear();
 
-            auto& staging = textureBuffers.back();
-            tmpCmdBufs[0]->copyBufferToImage(
-                staging.buffer.get(),
-                image.get(), vk::ImageLayout::eTransferDstOptimal, { imgCopyRegion });
+    // 圧縮済みテクスチャ (.mtex) はブロックのまま転送する
+    for(const auto& tex : sceneView.textures){
+        if(tex.format != TextureFormat::RGBA8 && !physicalDevice.getFeatures().textureCompressionBC){
+            std::cerr << "BC 圧縮テクスチャに対応していないデバイスです。mesh/test.mtex を削除してください" << std::endl;
+            std::abort();
         }
-        {
-            vk::ImageMemoryBarrier barrior;
-            barrior.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-            barrior.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-            barrior.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrior.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrior.image = image.get();
-            barrior.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-            barrior.subresourceRange.baseMipLevel = 0;
-            barrior.subresourceRange.levelCount = 1;
-            barrior.subresourceRange.baseArrayLayer = 0;
-            barrior.subresourceRange.layerCount = 1;
-            barrior.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-            barrior.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-            tmpCmdBufs[0]->pipelineBarrier(
-                vk::PipelineStageFlagBits::eTransfer,
-                vk::PipelineStageFlagBits::eRayTracingShaderKHR, {}, {}, {}, {barrior});
-        }
-        tmpCmdBufs[0]->end();
-
-        vk::CommandBuffer submitCmdBuf[1] = {tmpCmdBufs[0].get()};
-        vk::SubmitInfo submitInfo;
-        submitInfo.setCommandBufferCount(1);
-        submitInfo.setPCommandBuffers(submitCmdBuf);
-
-        queue.submit({submitInfo});
-        queue.waitIdle();
-
-        vk::ImageViewCreateInfo texImgViewCreateInfo;
-        texImgViewCreateInfo.image = image.get();
-        texImgViewCreateInfo.viewType = vk::ImageViewType::e2D;
-        texImgViewCreateInfo.format = vk::Format::eR8G8B8A8Unorm;
-        texImgViewCreateInfo.components.r = vk::ComponentSwizzle::eIdentity;
-        texImgViewCreateInfo.components.g = vk::ComponentSwizzle::eIdentity;
-        texImgViewCreateInfo.components.b = vk::ComponentSwizzle::eIdentity;
-        texImgViewCreateInfo.components.a = vk::ComponentSwizzle::eIdentity;
-        texImgViewCreateInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-        texImgViewCreateInfo.subresourceRange.baseMipLevel = 0;
-        texImgViewCreateInfo.subresourceRange.levelCount = 1;
-        texImgViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-        texImgViewCreateInfo.subresourceRange.layerCount = 1;
-        vk::UniqueImageView texImgView = device->createImageViewUnique(texImgViewCreateInfo);
+    }
 
-        textureImages.push_back(std::move(image));
-        textureMemorys.push_back(std::move(mem));
-        textureImageViews.push_back(std::move(texImgView));
+    // 全テクスチャの全ミップを1つの staging バッファに詰めて1回で転送する
+    std::vector<vk::DeviceSize> stagingOffsets;
+    vk::DeviceSize stagingSize = 0;
+    for(const auto& tex : sceneView.textures){
+        stagingSize = (stagingSize + 15) & ~vk::DeviceSize(15);
+        stagingOffsets.push_back(stagingSize);
+        stagingSize += tex.pixels.size();
     }
 
-    for(const auto& img : model.images){
-        const unsigned char* data = nullptr;
-        int width = 0;
-        int height = 0;
-        int comp = 4;
-        bool needfree = false;
-
-        if(!img.uri.empty()){
-            std::string texPath = baseDir + "../texture/" + img.uri;
-            int comp;
-            auto loaded = stbi_load(texPath.c_str(), &width, &height, &comp, STBI_rgb_alpha);
-            if(loaded == nullptr) {
-                std::cerr << "画像ファイルの読み込みに失敗しました。" << std::endl;
-                return;
-            }
-            data = loaded;
-            needfree = true;
-        }else if(img.bufferView >= 0){
-            data = img.image.data();
-            width = img.width;
-            height = img.height;
-            comp = img.component;
+    Buffer staging;
+    staging.init(
+        physicalDevice, *device, std::max<vk::DeviceSize>(stagingSize, 16),
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    {
+        auto* mapped = static_cast<uint8_t*>(device->mapMemory(staging.memory.get(), 0, VK_WHOLE_SIZE));
+        for(size_t i = 0; i < sceneView.textures.size(); i++){
+            const auto& pixels = sceneView.textures[i].pixels;
+            std::memcpy(mapped + stagingOffsets[i], pixels.data(), pixels.size());
         }
+        device->unmapMemory(staging.memory.get());
+    }
 
-        size_t imgDataSize = 4 * width * height;
-
-        Buffer buffer;
-        buffer.init(
-            physicalDevice, *device, imgDataSize,
-            vk::BufferUsageFlagBits::eTransferSrc,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-            data);
-        textureBuffers.push_back(std::move(buffer));
-
-        if(needfree) stbi_image_free((void*)data);
+    std::vector<ImageUpload> uploads;
+    for(size_t i = 0; i < sceneView.textures.size(); i++){
+        const auto& tex = sceneView.textures[i];
 
         vk::ImageCreateInfo imgCI{};
         imgCI.setImageType(vk::ImageType::e2D);
-        imgCI.setExtent(vk::Extent3D{(uint32_t)width, (uint32_t)height, 1});
-        imgCI.setMipLevels(1); imgCI.setArrayLayers(1);
-        imgCI.setFormat(vk::Format::eR8G8B8A8Unorm);
+        imgCI.setExtent(vk::Extent3D{tex.width, tex.height, 1});
+        imgCI.setMipLevels(tex.mipLevels); imgCI.setArrayLayers(1);
+        imgCI.setFormat(textureVkFormat(tex.format, tex.srgb));
         imgCI.setTiling(vk::ImageTiling::eOptimal);
         imgCI.setUsage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled);
         imgCI.setSamples(vk::SampleCountFlagBits::e1);
@@ -393,132 +170,80 @@ void loadTexture(std::string resourcePath){
 
         auto image = device->createImageUnique(imgCI);
         auto memReq = device->getImageMemoryRequirements(image.get());
-        uint32_t memIndex = 0;
-        for(uint32_t i = 0; i < physicalDevice.getMemoryProperties().memoryTypeCount; i++){
-            if((memReq.memoryTypeBits & (1 << i)) &&
-            (physicalDevice.getMemoryProperties().memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal))
-            {
-                memIndex = i; break;
-            }
-        }
 
-        vk::MemoryAllocateInfo mAI{memReq.size, memIndex};
+        vk::MemoryAllocateInfo mAI{memReq.size, findDeviceLocalMemory(memReq)};
         auto mem = device->allocateMemoryUnique(mAI);
         device->bindImageMemory(image.get(), mem.get(), 0);
 
-        vk::CommandBufferAllocateInfo tmpCmdBufAllocInfo;
-        tmpCmdBufAllocInfo.commandPool = commandPool.get();
-        tmpCmdBufAllocInfo.commandBufferCount = 1;
-        tmpCmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
-        std::vector<vk::UniqueCommandBuffer> tmpCmdBufs = device->allocateCommandBuffersUnique(tmpCmdBufAllocInfo);
-
-        vk::CommandBufferBeginInfo cmdBeginInfo;
-        cmdBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-
-        tmpCmdBufs[0]->begin(cmdBeginInfo);
-        {
-            vk::ImageMemoryBarrier barrior;
-            barrior.oldLayout = vk::ImageLayout::eUndefined;
-            barrior.newLayout = vk::ImageLayout::eTransferDstOptimal;
-            barrior.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrior.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrior.image = image.get();
-            barrior.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-            barrior.subresourceRange.baseMipLevel = 0;
-            barrior.subresourceRange.levelCount = 1;
-            barrior.subresourceRange.baseArrayLayer = 0;
-            barrior.subresourceRange.layerCount = 1;
-            barrior.srcAccessMask = {};
-            barrior.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-
-            tmpCmdBufs[0]->pipelineBarrier(
-                vk::PipelineStageFlagBits::eTopOfPipe,
-                vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, {barrior});
-        }
-        {
+        ImageUpload upload{image.get(), tex.mipLevels, 1, {}};
+        for(uint32_t level = 0; level < tex.mipLevels; level++){
             vk::BufferImageCopy imgCopyRegion;
-            imgCopyRegion.setBufferOffset(0);
+            imgCopyRegion.setBufferOffset(stagingOffsets[i] + mipLevelOffset(tex.width, tex.height, level, tex.format));
             imgCopyRegion.imageSubresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
-            imgCopyRegion.imageSubresource.setMipLevel(0);
+            imgCopyRegion.imageSubresource.setMipLevel(level);
             imgCopyRegion.imageSubresource.setBaseArrayLayer(0);
             imgCopyRegion.imageSubresource.setLayerCount(1);
             imgCopyRegion.setImageOffset(vk::Offset3D{0, 0, 0});
-            imgCopyRegion.setImageExtent({uint32_t(width), uint32_t(height), 1});
+            imgCopyRegion.setImageExtent({mipExtent(tex.width, level), mipExtent(tex.height, level), 1});
             imgCopyRegion.setBufferRowLength(0);
             imgCopyRegion.setBufferImageHeight(0);
-
-            auto& staging = textureBuffers.back();
-            tmpCmdBufs[0]->copyBufferToImage(
-                staging.buffer.get(),
-                image.get(), vk::ImageLayout::eTransferDstOptimal, { imgCopyRegion });
+            upload.copies.push_back(imgCopyRegion);
         }
-        {
-            vk::ImageMemoryBarrier barrior;
-            barrior.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-            barrior.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-            barrior.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrior.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            barrior.image = image.get();
-            barrior.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-            barrior.subresourceRange.baseMipLevel = 0;
-            barrior.subresourceRange.levelCount = 1;
-            barrior.subresourceRange.baseArrayLayer = 0;
-            barrior.subresourceRange.layerCount = 1;
-            barrior.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-            barrior.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-            tmpCmdBufs[0]->pipelineBarrier(
-                vk::PipelineStageFlagBits::eTransfer,
-                vk::PipelineStageFlagBits::eRayTracingShaderKHR, {}, {}, {}, {barrior});
-        }
-        tmpCmdBufs[0]->end();
-
-        vk::CommandBuffer submitCmdBuf[1] = {tmpCmdBufs[0].get()};
-        vk::SubmitInfo submitInfo;
-        submitInfo.setCommandBufferCount(1);
-        submitInfo.setPCommandBuffers(submitCmdBuf);
+        uploads.push_back(std::move(upload));
 
-        queue.submit({submitInfo});
-        queue.waitIdle();
+        textureImages.push_back(std::move(image));
+        textureMemorys.push_back(std::move(mem));
+    }
+    uploadImages(staging.buffer.get(), uploads);
+    textureBuffers.push_back(std::move(staging));
 
+    for(size_t i = 0; i < sceneView.textures.size(); i++){
         vk::ImageViewCreateInfo texImgViewCreateInfo;
-        texImgViewCreateInfo.image = image.get();
+        texImgViewCreateInfo.image = textureImages[i].get();
         texImgViewCreateInfo.viewType = vk::ImageViewType::e2D;
-        texImgViewCreateInfo.format = vk::Format::eR8G8B8A8Unorm;
+        texImgViewCreateInfo.format = textureVkFormat(sceneView.textures[i].format, sceneView.textures[i].srgb);
         texImgViewCreateInfo.components.r = vk::ComponentSwizzle::eIdentity;
         texImgViewCreateInfo.components.g = vk::ComponentSwizzle::eIdentity;
         texImgViewCreateInfo.components.b = vk::ComponentSwizzle::eIdentity;
         texImgViewCreateInfo.components.a = vk::ComponentSwizzle::eIdentity;
         texImgViewCreateInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
         texImgViewCreateInfo.subresourceRange.baseMipLevel = 0;
-        texImgViewCreateInfo.subresourceRange.levelCount = 1;
+        texImgViewCreateInfo.subresourceRange.levelCount = sceneView.textures[i].mipLevels;
         texImgViewCreateInfo.subresourceRange.baseArrayLayer = 0;
         texImgViewCreateInfo.subresourceRange.layerCount = 1;
-        vk::UniqueImageView texImgView = device->createImageViewUnique(texImgViewCreateInfo);
-
-        textureImages.push_back(std::move(image));
-        textureMemorys.push_back(std::move(mem));
-        textureImageViews.push_back(std::move(texImgView));
+        textureImageViews.push_back(device->createImageViewUnique(texImgViewCreateInfo));
     }
 
-    int envWidth, envHeight, envCh;
-    uint32_t faceSize = 1024;
-    size_t   facePixels = (size_t)faceSize * (size_t)faceSize;
-    size_t   faceBytes  = facePixels * 4 * sizeof(float);   // RGBA32F
-    size_t   totalBytes = faceBytes * 6;
-
-    auto pEnvData = stbi_loadf(envMapPath.c_str(), &envWidth, &envHeight, &envCh, STBI_rgb_alpha);
+    vk::SamplerCreateInfo samplerCreateInfo;
+    samplerCreateInfo.magFilter = vk::Filter::eLinear;
+    samplerCreateInfo.minFilter = vk::Filter::eLinear;
+    samplerCreateInfo.addressModeU = vk::SamplerAddressMode::eRepeat;
+    samplerCreateInfo.addressModeV = vk::SamplerAddressMode::eRepeat;
+    samplerCreateInfo.addressModeW = vk::SamplerAddressMode::eRepeat;
+    samplerCreateInfo.anisotropyEnable = false;
+    samplerCreateInfo.maxAnisotropy = 1.0f;
+    samplerCreateInfo.borderColor = vk::BorderColor::eIntOpaqueBlack;
+    samplerCreateInfo.unnormalizedCoordinates = false;
+    samplerCreateInfo.compareEnable = false;
+    samplerCreateInfo.compareOp = vk::CompareOp::eAlways;
+    samplerCreateInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
+    samplerCreateInfo.mipLodBias = 0.0f;
+    samplerCreateInfo.minLod = 0.0f;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
 
-    if(pEnvData == nullptr) {
-        std::cerr << "画像ファイルの読み込みに失敗しました。" << std::endl;
-        return;
-    }
+    sampler = device->createSamplerUnique(samplerCreateInfo);
+    envSampler = device->createSamplerUnique(samplerCreateInfo);
+}
 
-    size_t envDataSize = 4 * envWidth * envHeight * sizeof(float);
+void uploadEnvMap(){
+    PROFILE_ZONE("uploadEnvMap");
+    uint32_t faceSize = sceneView.envFaceSize;
+    size_t   faceBytes  = (size_t)faceSize * (size_t)faceSize * 4 * sizeof(float);   // RGBA32F
 
     vk::ImageCreateInfo envCI{};
     envCI.setFlags(vk::ImageCreateFlagBits::eCubeCompatible);
     envCI.setImageType(vk::ImageType::e2D);
-    envCI.setExtent({(uint32_t)faceSize, (uint32_t)faceSize, 1});
+    envCI.setExtent({faceSize, faceSize, 1});
     envCI.setMipLevels(1); envCI.setArrayLayers(6);
     envCI.setFormat(vk::Format::eR32G32B32A32Sfloat);
     envCI.setTiling(vk::ImageTiling::eOptimal);
@@ -529,148 +254,38 @@ void loadTexture(std::string resourcePath){
     envTexImage = device->createImageUnique(envCI);
 
     auto memReq = device->getImageMemoryRequirements(envTexImage.get());
-    uint32_t memIndex = 0;
-    for(uint32_t i = 0; i < physicalDevice.getMemoryProperties().memoryTypeCount; i++){
-        if((memReq.memoryTypeBits & (1 << i)) &&
-        (physicalDevice.getMemoryProperties().memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal))
-        {
-            memIndex = i; break;
-        }
-    }
-    vk::MemoryAllocateInfo envMAI{memReq.size, memIndex};
+    vk::MemoryAllocateInfo envMAI{memReq.size, findDeviceLocalMemory(memReq)};
     envTexMemory = device->allocateMemoryUnique(envMAI);
     device->bindImageMemory(envTexImage.get(), envTexMemory.get(), 0);
 
-    vk::CommandBufferAllocateInfo tmpCmdBufAllocInfo;
-    tmpCmdBufAllocInfo.commandPool = commandPool.get();
-    tmpCmdBufAllocInfo.commandBufferCount = 1;
-    tmpCmdBufAllocInfo.level = vk::CommandBufferLevel::ePrimary;
-    std::vector<vk::UniqueCommandBuffer> tmpCmdBufs = device->allocateCommandBuffersUnique(tmpCmdBufAllocInfo);
-
-    vk::CommandBufferBeginInfo cmdBeginInfo;
-    cmdBeginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-
-    tmpCmdBufs[0]->begin(cmdBeginInfo);
-
+    envTexBuffers[0].init(
+        physicalDevice, *device,
+        faceBytes * 6,
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        sceneView.envFaces.data()
+    );
+
+    std::vector<vk::BufferImageCopy> copies;
+    copies.reserve(6);
+    for (uint32_t face = 0; face < 6; ++face)
     {
-        vk::ImageMemoryBarrier barrior;
-        barrior.oldLayout = vk::ImageLayout::eUndefined;
-        barrior.newLayout = vk::ImageLayout::eTransferDstOptimal;
-        barrior.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrior.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrior.image = envTexImage.get();
-        barrior.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-        barrior.subresourceRange.baseMipLevel = 0;
-        barrior.subresourceRange.levelCount = 1;
-        barrior.subresourceRange.baseArrayLayer = 0;
-        barrior.subresourceRange.layerCount = 6;
-        barrior.srcAccessMask = {};
-        barrior.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-
-        tmpCmdBufs[0]->pipelineBarrier(
-            vk::PipelineStageFlagBits::eTopOfPipe,
-            vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, {barrior});
-    }
-    {
-        std::vector<float> cube(6ull * facePixels * 4);
-        std::cout << "before convert hdr to cubemap" << std::endl;
-        for (int face = 0; face < 6; ++face) {
-            for (int y = 0; y < faceSize; ++y) {
-                for (int x = 0; x < faceSize; ++x) {
-                    glm::vec3 dir = CubemapDirectionFromFaceXY(face, x, y, faceSize);
-                    glm::vec4 c   = SampleEquirect(dir, pEnvData, envWidth, envHeight);
-                    size_t idx = ( (size_t)face * facePixels + y * faceSize + x ) * 4;
-                    cube[idx + 0] = c.r;
-                    cube[idx + 1] = c.g;
-                    cube[idx + 2] = c.b;
-                    cube[idx + 3] = c.a;
-                }
-            }
-        }
-        envTexBuffers[0].init(
-            physicalDevice, *device,
-            totalBytes,
-            vk::BufferUsageFlagBits::eTransferSrc,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-            cube.data()
-        );
-
-        std::vector<vk::BufferImageCopy> copies;
-        copies.reserve(6);
-
-        for (uint32_t face = 0; face < 6; ++face)
-        {
-            vk::BufferImageCopy copy{};
-            copy.bufferOffset = faceBytes * face;
-            copy.bufferRowLength   = 0;
-            copy.bufferImageHeight = 0;
-
-            copy.imageSubresource.aspectMask     = vk::ImageAspectFlagBits::eColor;
-            copy.imageSubresource.mipLevel       = 0;
-            copy.imageSubresource.baseArrayLayer = face;
-            copy.imageSubresource.layerCount     = 1;
-
-            copy.imageOffset = vk::Offset3D{0, 0, 0};
-            copy.imageExtent = vk::Extent3D{
-                (uint32_t)faceSize,
-                (uint32_t)faceSize,
-                1
-            };
-
-            copies.push_back(copy);
-        }
-        tmpCmdBufs[0]->copyBufferToImage(
-            envTexBuffers[0].buffer.get(),
-            envTexImage.get(), vk::ImageLayout::eTransferDstOptimal, copies);
-    }
-    {
-        vk::ImageMemoryBarrier barrior;
-        barrior.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-        barrior.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-        barrior.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrior.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrior.image = envTexImage.get();
-        barrior.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-        barrior.subresourceRange.baseMipLevel = 0;
-        barrior.subresourceRange.levelCount = 1;
-        barrior.subresourceRange.baseArrayLayer = 0;
-        barrior.subresourceRange.layerCount = 6;
-        barrior.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-        barrior.dstAccessMask = vk::AccessFlagBits::eShaderRead;
-        tmpCmdBufs[0]->pipelineBarrier(
-            vk::PipelineStageFlagBits::eTransfer,
-            vk::PipelineStageFlagBits::eRayTracingShaderKHR, {}, {}, {}, {barrior});
-    }
-
-    tmpCmdBufs[0]->end();
-
-    vk::CommandBuffer submitCmdBuf[1] = {tmpCmdBufs[0].get()};
-    vk::SubmitInfo submitInfo;
-    submitInfo.setCommandBufferCount(1);
-    submitInfo.setPCommandBuffers(submitCmdBuf);
+        vk::BufferImageCopy copy{};
+        copy.bufferOffset = faceBytes * face;
+        copy.bufferRowLength   = 0;
+        copy.bufferImageHeight = 0;
 
-    queue.submit({submitInfo});
-    queue.waitIdle();
+        copy.imageSubresource.aspectMask     = vk::ImageAspectFlagBits::eColor;
+        copy.imageSubresource.mipLevel       = 0;
+        copy.imageSubresource.baseArrayLayer = face;
+        copy.imageSubresource.layerCount     = 1;
 
-    vk::SamplerCreateInfo samplerCreateInfo;
-    samplerCreateInfo.magFilter = vk::Filter::eLinear;
-    samplerCreateInfo.minFilter = vk::Filter::eLinear;
-    samplerCreateInfo.addressModeU = vk::SamplerAddressMode::eRepeat;
-    samplerCreateInfo.addressModeV = vk::SamplerAddressMode::eRepeat;
-    samplerCreateInfo.addressModeW = vk::SamplerAddressMode::eRepeat;
-    samplerCreateInfo.anisotropyEnable = false;
-    samplerCreateInfo.maxAnisotropy = 1.0f;
-    samplerCreateInfo.borderColor = vk::BorderColor::eIntOpaqueBlack;
-    samplerCreateInfo.unnormalizedCoordinates = false;
-    samplerCreateInfo.compareEnable = false;
-    samplerCreateInfo.compareOp = vk::CompareOp::eAlways;
-    samplerCreateInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
-    samplerCreateInfo.mipLodBias = 0.0f;
-    samplerCreateInfo.minLod = 0.0f;
-    samplerCreateInfo.maxLod = 0.0f;
+        copy.imageOffset = vk::Offset3D{0, 0, 0};
+        copy.imageExtent = vk::Extent3D{faceSize, faceSize, 1};
 
-    sampler = device->createSamplerUnique(samplerCreateInfo);
-    envSampler = device->createSamplerUnique(samplerCreateInfo);
+        copies.push_back(copy);
+    }
+    uploadImages(envTexBuffers[0].buffer.get(), {ImageUpload{envTexImage.get(), 1, 6, copies}});
 
     vk::ImageViewCreateInfo envTexImageViewCI;
     envTexImageViewCI.image = envTexImage.get();
@@ -688,102 +303,49 @@ void loadTexture(std::string resourcePath){
     envImageView = device->createImageViewUnique(envTexImageViewCI);
 }
 
-void loadMaterial(){
-    materials.clear();
-    materials.reserve(model.materials.size());
-
-    for(const auto& mat : model.materials){
-        Material m;
-        m.baseColorTextureIndex = -1;
-        m.matallicRoughnessTextureIndex = -1;
-        m.normalTextureIndex = -1;
-        m.occulusionTextureIndex = -1;
-        m.emissiveTextureIndex = -1;
-
-        const auto& pbr = mat.pbrMetallicRoughness;
-
-        if (pbr.baseColorFactor.size() == 4) {
-            m.baseColorFactor = glm::vec4(
-                (float)pbr.baseColorFactor[0],
-                (float)pbr.baseColorFactor[1],
-                (float)pbr.baseColorFactor[2],
-                (float)pbr.baseColorFactor[3]
-            );
-        } else {
-            m.baseColorFactor = glm::vec4(1.0f);
-        }
-
-        m.metallicFactor  = (float)pbr.metallicFactor;
-        m.roughnessFactor = (float)pbr.roughnessFactor;
-
-        if (pbr.baseColorTexture.index >= 0) {
-            m.baseColorTextureIndex = pbr.baseColorTexture.index;
-        }
-
-        if (pbr.metallicRoughnessTexture.index >= 0) {
-            m.matallicRoughnessTextureIndex = pbr.metallicRoughnessTexture.index;
-        }
-
-        if (mat.normalTexture.index >= 0) {
-            m.normalTextureIndex = mat.normalTexture.index;
-        }
-
-        if (mat.occlusionTexture.index >= 0) {
-            m.occulusionTextureIndex = mat.occlusionTexture.index;
-        }
-
-        if (mat.emissiveTexture.index >= 0) {
-            m.emissiveTextureIndex = mat.emissiveTexture.index;
-        }
-
-        if (mat.emissiveFactor.size() == 3) {
-            m.emissiveFactor = glm::vec4(
-                (float)mat.emissiveFactor[0],
-                (float)mat.emissiveFactor[1],
-                (float)mat.emissiveFactor[2],
-                1.0f
-            );
-        } else {
-            m.emissiveFactor = glm::vec4(0.0f);
-        }
-
-        m.transmission = 0.0f;
-        auto extTransmission = mat.extensions.find("KHR_materials_transmission");
-        if(extTransmission != mat.extensions.end()){
-            const tinygltf::Value& ext = extTransmission->second;
-            if(ext.Has("transmission")){
-                m.transmission = (float)ext.Get("transmission").GetNumberAsDouble();
-            }
-        }
-
-        m.ior = 1.5f;
-        auto extIor = mat.extensions.find("KHR_materials_ior");
-        if (extIor != mat.extensions.end()) {
-            const tinygltf::Value& ext = extIor->second;
-            if (ext.Has("ior")) {
-                m.ior = (float)ext.Get("ior").GetNumberAsDouble();
-            }
-        }
-
-        materials.push_back(m);
-    }
-
+void uploadMaterials(){
+    PROFILE_ZONE("uploadMaterials");
     vk::BufferUsageFlags bufferUsage{vk::BufferUsageFlagBits::eStorageBuffer};
     vk::MemoryPropertyFlags memoryProperty{
         vk::MemoryPropertyFlagBits::eHostVisible |
         vk::MemoryPropertyFlagBits::eHostCoherent};
 
     materialBuffer.init(
-        physicalDevice, *device, sizeof(Material) * materials.size(),
-        bufferUsage, memoryProperty, materials.data());
+        physicalDevice, *device, sizeof(Material) * sceneView.materials.size(),
+        bufferUsage, memoryProperty, sceneView.materials.data());
 }
 
 void loadResources(std::filesystem::path exeDir){
-    std::string resourcePath = (exeDir / "resource").string();
-    loadModel(resourcePath);
-    std::cout << "after loadModel" << std::endl;
-    loadMaterial();
-    std::cout << "after loadMaterial" << std::endl;
-    loadTexture(resourcePath);
-    std::cout << "after loadTexture" << std::endl;
-}
\ No newline at end of file
+    PROFILE_ZONE("loadResources");
+    std::filesystem::path resourceDir = exeDir / "resource";
+    std::filesystem::path cachePath = exeDir / "cache" / "scene.cache";
+
+    // 2回目以降は mmap したキャッシュからそのまま staging に流す
+    if(sceneCache.open(cachePath)){
+        sceneView = sceneCache.view;
+        std::cout << "scene cache hit: " << cachePath.string() << std::endl;
+    }else{
+        if(!loadScene(resourceDir, assets)){
+            std::abort();
+        }
+        if(!writeSceneCache(cachePath, assets)){
+            std::cerr << "failed to write scene cache: " << cachePath.string() << std::endl;
+        }
+        sceneView = makeSceneView(assets);
+        std::cout << "after loadScene" << std::endl;
+    }
+    // resource/camera.json があれば glTF のカメラより優先する
+    std::filesystem::path cameraPath = resourceDir / "camera.json";
+    if(std::filesystem::exists(cameraPath)){
+        if(!loadCameraKeys(cameraPath, cameraTimeline.keys)){
+            std::abort();
+        }
+    }else{
+        cameraTimeline.keys.assign(sceneView.cameraKeys.begin(), sceneView.cameraKeys.end());
+    }
+    uploadGeometry();
+    uploadMaterials();
+    uploadTextures();
+    uploadEnvMap();
+    std::cout << "after upload" << std::endl;
+}
@@ -7,23 +7,97 @@
 #include "../include/shaders.hpp"
 #include "../include/render.hpp"
 #include "../include/output.hpp"
+#include "../include/tonemap.hpp"
+#include "../include/temporal.hpp"
+#include "../include/profiler.hpp"
+#include "../include/gpu_profiler.hpp"
+#include <cstdlib>
 #include <iostream>
 
-int main(){
+int main(int argc, char** argv){
+    RenderOptions options;
+    bool usePipelineCache = true;
+    bool usageError = false;
+    for(int i = 1; i < argc && !usageError; i++){
+        std::string arg = argv[i];
+        if(arg == "--format" && i + 1 < argc && parseOutputFormat(argv[i + 1], options.outputFormat)){
+            i++;
+        }else if(arg == "--video" && i + 1 < argc && parseVideoSink(argv[i + 1], options.videoSink)){
+            i++;
+        }else if(arg == "--video-out" && i + 1 < argc){
+            options.videoPath = argv[++i];
+        }else if(arg == "--no-images"){
+            options.writeImages = false;
+        }else if(arg == "--denoise"){
+            options.denoise = true;
+        }else if(arg == "--aov"){
+            options.writeAovs = true;
+        }else if(arg == "--temporal"){
+            options.temporal = true;
+        }else if(arg == "--spp" && i + 1 < argc && std::atoi(argv[i + 1]) > 0){
+            options.maxSamples = uint32_t(std::atoi(argv[++i]));
+        }else if(arg == "--resume"){
+            options.resume = true;
+        }else if(arg == "--max-depth" && i + 1 < argc && std::atoi(argv[i + 1]) > 0){
+            options.shaderConstants.maxDepth = uint32_t(std::atoi(argv[++i]));
+        }else if(arg == "--rr-depth" && i + 1 < argc && std::atoi(argv[i + 1]) >= 0){
+            options.shaderConstants.rouletteMinDepth = uint32_t(std::atoi(argv[++i]));
+        }else if(arg == "--no-nee"){
+            options.shaderConstants.sunNee = 0;
+        }else if(arg == "--no-roulette"){
+            options.shaderConstants.russianRoulette = 0;
+        }else if(arg == "--stats"){
+            options.shaderConstants.pathStats = 1;
+        }else if(arg == "--watch-shaders"){
+            options.watchShaders = true;
+        }else if(arg == "--no-pipeline-cache"){
+            usePipelineCache = false;
+        }else{
+            usageError = true;
+        }
+    }
+    // 何も書き出さない指定は誤り
+    // --watch-shaders は同じフレームを何度も描くので動画には書けない
+    if(usageError || (!options.writeImages && !options.writeAovs && options.videoSink == VideoSink::None) ||
+       (options.watchShaders && options.videoSink != VideoSink::None)){
+        std::cerr << "usage: maple [--format png|png-fast|png-store|exr|pfm] [--video ffmpeg|y4m] [--video-out path] [--no-images] [--aov] [--denoise] [--temporal] [--spp n] [--resume] [--max-depth n] [--rr-depth n] [--no-nee] [--no-roulette] [--stats] [--watch-shaders] [--no-pipeline-cache]\n";
+        return 1;
+    }
+
     auto exeDir = std::filesystem::current_path();
     SetupVulkan();
+    createTimestampQueryPool();
     createOutputBuffer();
+    createPathStatsBuffer();
+    createAdaptiveBuffers();
     createUniformBuffer();
+    createSobolBuffer();
     loadResources(exeDir);
     createDescriptor(1);
     createBLAS();
     createTLAS();
     prepareShaders();
-    createRayTracingPipeline();
-    createShaderBindingTable();
-    std::cout << "metallic: " << model.materials[0].pbrMetallicRoughness.metallicFactor << std::endl;
-    std::cout << "roughness: " << model.materials[0].pbrMetallicRoughness.roughnessFactor << std::endl;
-    std::cout << "emissive: " << model.materials[0].emissiveFactor[0] << ", " << model.materials[0].emissiveFactor[1] << ", " << model.materials[0].emissiveFactor[2] << std::endl;
-    drawCall(exeDir);
+    // RT パイプラインのコンパイルは起動時間の大きな部分なので、ドライバのキャッシュをディスクに残す
+    const std::filesystem::path pipelineCachePath = usePipelineCache ? exeDir / "cache" / "pipeline.cache" : std::filesystem::path();
+    createPipelineCache(pipelineCachePath);
+    // 深さや NEE の有無は特殊化定数なので、シェーダを作り直さずに変えられる
+    createRayTracingPipeline(options.shaderConstants);
+    createTonemapPipeline();
+    if(options.temporal){
+        createTemporalHistory();
+        createTemporalPipeline();
+    }
+    savePipelineCache(pipelineCachePath);
+    // キャッシュから読んだときは assets が空なので、どちらの経路でも埋まる sceneView を見る
+    if(!sceneView.materials.empty()){
+        const Material& m = sceneView.materials[0];
+        std::cout << "metallic: " << m.metallicFactor << std::endl;
+        std::cout << "roughness: " << m.roughnessFactor << std::endl;
+        std::cout << "emissive: " << m.emissiveFactor.r << ", " << m.emissiveFactor.g << ", " << m.emissiveFactor.b << std::endl;
+    }
+    drawCall(exeDir, options);
+
+    profiler.writeChromeTrace(exeDir / "profile_trace.json");
+    profiler.printSummary();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "../include/mipmap.hpp"
+#include "../include/parallel.hpp"
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define MAPLE_MIPMAP_SSE2 1
+#endif
+
+namespace {
+
+// sRGB <-> 線形の変換テーブル
+struct SrgbTables {
+    std::array<float, 256> toLinear;
+    std::vector<uint8_t> fromLinear; // 線形値 * kEncodeScale で引く
+};
+
+constexpr uint32_t kEncodeScale = 65535;
+
+const SrgbTables& srgbTables(){
+    static const SrgbTables tables = []{
+        SrgbTables t;
+        for(uint32_t i = 0; i < 256; i++){
+            float c = float(i) / 255.0f;
+            t.toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        t.fromLinear.resize(kEncodeScale + 1);
+        for(uint32_t i = 0; i <= kEncodeScale; i++){
+            float l = float(i) / float(kEncodeScale);
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            t.fromLinear[i] = uint8_t(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+        return t;
+    }();
+    return tables;
+}
+
+#ifdef MAPLE_MIPMAP_SSE2
+// 線形 RGBA8 の 2x2 平均を 4 texel 分まとめて作る (src は 8 texel x 2 行)
+// 和は最大 4 * 255 なので 16bit で足りる。丸めはスカラー版と同じ (sum + 2) / 4
+void downsample4Linear(const uint8_t* row0, const uint8_t* row1, uint8_t* out){
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(2);
+    __m128i packed[2];
+    for(int k = 0; k < 2; k++){
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + k * 16));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + k * 16));
+        // texel 0,1 と 2,3 の縦の和
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        // 横に隣り合う texel を足す: (0 + 1, 2 + 3)
+        __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+        packed[k] = _mm_srli_epi16(_mm_add_epi16(sum, half), 2);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(packed[0], packed[1]));
+}
+#endif
+
+// dst の [rowBegin, rowEnd) 行を src から 2x2 平均で作る
+// 段の大きさは切り捨て (Vulkan と同じ) なので、奇数サイズの最後の行・列は端の出力に畳み込む (2x3, 3x3 平均)
+void downsampleRows(
+    const uint8_t* src, uint32_t sw, uint32_t sh,
+    uint8_t* dst, uint32_t dw, uint32_t dh,
+    uint32_t rowBegin, uint32_t rowEnd, bool srgb)
+{
+    const SrgbTables& tables = srgbTables();
+    for(uint32_t y = rowBegin; y < rowEnd; y++){
+        // 最後の行は残りの 1〜3 行をまとめる
+        const uint32_t ny = y + 1 == dh ? sh - 2 * y : 2;
+        const uint8_t* row = src + size_t(2 * y) * sw * 4;
+        uint8_t* out = dst + size_t(y) * dw * 4;
+        uint32_t x = 0;
+#ifdef MAPLE_MIPMAP_SSE2
+        // 線形のテクスチャで 2x2 にまとめる範囲 (端の 3 texel 平均より手前) だけ 4 texel ずつ
+        // sRGB はテーブル引きで gather が要るのでスカラーのまま
+        if(!srgb && ny == 2){
+            const uint32_t pairs = (sw & 1) ? dw - 1 : dw;
+            for(; x + 4 <= pairs; x += 4){
+                downsample4Linear(row + size_t(2 * x) * 4, row + (size_t(sw) + 2 * x) * 4, out + size_t(x) * 4);
+            }
+        }
+#endif
+        for(; x < dw; x++){
+            const uint32_t nx = x + 1 == dw ? sw - 2 * x : 2;
+            const uint32_t n = nx * ny;
+            for(uint32_t c = 0; c < 4; c++){
+                if(srgb && c < 3){
+                    float l = 0.0f;
+                    for(uint32_t j = 0; j < ny; j++){
+                        for(uint32_t i = 0; i < nx; i++) l += tables.toLinear[row[(size_t(j) * sw + 2 * x + i) * 4 + c]];
+                    }
+                    l /= float(n);
+                    out[x * 4 + c] = tables.fromLinear[uint32_t(l * float(kEncodeScale) + 0.5f)];
+                }else{
+                    uint32_t sum = 0;
+                    for(uint32_t j = 0; j < ny; j++){
+                        for(uint32_t i = 0; i < nx; i++) sum += row[(size_t(j) * sw + 2 * x + i) * 4 + c];
+                    }
+                    out[x * 4 + c] = uint8_t((sum + n / 2) / n);
+                }
+            }
+        }
+    }
+}
+
+}
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height){
+    uint32_t levels = 1;
+    while((width >> levels) > 0 || (height >> levels) > 0) levels++;
+    return levels;
+}
+
+size_t textureBlockBytes(TextureFormat format){
+    switch(format){
+    case TextureFormat::BC1:
+    case TextureFormat::BC4: return 8;
+    case TextureFormat::BC5:
+    case TextureFormat::BC7: return 16;
+    default: return 0;
+    }
+}
+
+size_t mipLevelSize(uint32_t width, uint32_t height, uint32_t level, TextureFormat format){
+    size_t w = mipExtent(width, level), h = mipExtent(height, level);
+    size_t blockBytes = textureBlockBytes(format);
+    if(blockBytes == 0) return w * h * 4;
+    return ((w + 3) / 4) * ((h + 3) / 4) * blockBytes;
+}
+
+size_t mipLevelOffset(uint32_t width, uint32_t height, uint32_t level, TextureFormat format){
+    size_t offset = 0;
+    for(uint32_t l = 0; l < level; l++){
+        offset += mipLevelSize(width, height, l, format);
+    }
+    return offset;
+}
+
+void generateMips(std::vector<TextureData>& textures, const std::vector<bool>& srgb){
+    PROFILE_ZONE("generateMips");
+    for(size_t i = 0; i < textures.size(); i++){
+        TextureData& tex = textures[i];
+        if(tex.width == 0 || tex.height == 0 || tex.format != TextureFormat::RGBA8) continue;
+        bool isSrgb = i < srgb.size() && srgb[i];
+
+        uint32_t levels = mipLevelCount(tex.width, tex.height);
+        tex.pixels.resize(mipLevelOffset(tex.width, tex.height, levels));
+        for(uint32_t level = 1; level < levels; level++){
+            const uint8_t* src = tex.pixels.data() + mipLevelOffset(tex.width, tex.height, level - 1);
+            uint8_t* dst = tex.pixels.data() + mipLevelOffset(tex.width, tex.height, level);
+            uint32_t sw = mipExtent(tex.width, level - 1), sh = mipExtent(tex.height, level - 1);
+            uint32_t dw = mipExtent(tex.width, level), dh = mipExtent(tex.height, level);
+            parallelRows(dh, [&](uint32_t begin, uint32_t end){
+                downsampleRows(src, sw, sh, dst, dw, dh, begin, end, isSrgb);
+            });
+        }
+        tex.mipLevels = levels;
+    }
+}
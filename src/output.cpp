@@ -1,26 +1,24 @@
 #include "../include/globals.hpp"
+#include "../include/adaptive.hpp"
+#include "../include/profiler.hpp"
 
-void createOutputBuffer(){
-    vk::DeviceSize size = width * height * 4;
-    outputBuffer.init(
-        physicalDevice, *device, size,
-        vk::BufferUsageFlagBits::eTransferDst,
-        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
-    );
-    
+namespace {
+
+void createStorageImage(vk::Format format, vk::ImageUsageFlags usage,
+                        vk::UniqueImage& image, vk::UniqueDeviceMemory& memory, vk::UniqueImageView& view){
     vk::ImageCreateInfo ci{};
     ci.setImageType(vk::ImageType::e2D);
     ci.setExtent({uint32_t(width), uint32_t(height), 1});
     ci.setMipLevels(1); ci.setArrayLayers(1);
-    ci.setFormat(vk::Format::eR8G8B8A8Unorm);
+    ci.setFormat(format);
     ci.setTiling(vk::ImageTiling::eOptimal);
-    ci.setUsage(vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc);
+    ci.setUsage(vk::ImageUsageFlagBits::eStorage | usage);
     ci.setSamples(vk::SampleCountFlagBits::e1);
     ci.setSharingMode(vk::SharingMode::eExclusive);
 
-    outputImage = device->createImageUnique(ci);
+    image = device->createImageUnique(ci);
 
-    auto req = device->getImageMemoryRequirements(outputImage.get());
+    auto req = device->getImageMemoryRequirements(image.get());
     uint32_t memIndex = 0;
     for (uint32_t i = 0; i < physicalDevice.getMemoryProperties().memoryTypeCount; ++i) {
         if ((req.memoryTypeBits & (1u << i)) &&
@@ -28,13 +26,111 @@ void createOutputBuffer(){
             memIndex = i; break;
         }
     }
-    outputMemory = device->allocateMemoryUnique({req.size, memIndex});
-    device->bindImageMemory(outputImage.get(), outputMemory.get(), 0);
+    memory = device->allocateMemoryUnique({req.size, memIndex});
+    device->bindImageMemory(image.get(), memory.get(), 0);
 
     vk::ImageViewCreateInfo vci{};
-    vci.image = outputImage.get();
+    vci.image = image.get();
     vci.viewType = vk::ImageViewType::e2D;
     vci.format = ci.format;
     vci.subresourceRange = { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
-    outputView = device->createImageViewUnique(vci);
+    view = device->createImageViewUnique(vci);
+}
+
+}
+
+void createOutputBuffer(){
+    PROFILE_ZONE("createOutputBuffer");
+    vk::DeviceSize size = width * height * 4;
+    outputBuffer.init(
+        physicalDevice, *device, size,
+        vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+
+    // EXR / PFM で書き出すときだけ使う
+    hdrBuffer.init(
+        physicalDevice, *device, size * sizeof(float),
+        vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+
+    // AOV の読み戻し (--aov か --denoise のときだけ使う)
+    // albedo, normal は RGBA32F, depth は R32F, id は R32G32_UINT
+    const vk::DeviceSize pixelCount = vk::DeviceSize(width) * height;
+    std::pair<Buffer*, vk::DeviceSize> aovBuffers[] = {
+        {&albedoBuffer, pixelCount * 16},
+        {&normalBuffer, pixelCount * 16},
+        {&depthBuffer,  pixelCount * 4},
+        {&idBuffer,     pixelCount * 8},
+    };
+    for(auto& [buffer, bytes] : aovBuffers){
+        buffer->init(
+            physicalDevice, *device, bytes,
+            vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+        );
+    }
+
+    // raygen が書く線形 HDR。トーンマップ後の 8bit 画像 (outputImage) だけを読み戻す
+    createStorageImage(vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eTransferSrc,
+                       hdrImage, hdrMemory, hdrView);
+    createStorageImage(vk::Format::eR8G8B8A8Unorm, vk::ImageUsageFlagBits::eTransferSrc,
+                       outputImage, outputMemory, outputView);
+    createStorageImage(vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eTransferSrc,
+                       albedoImage, albedoMemory, albedoView);
+    createStorageImage(vk::Format::eR32G32B32A32Sfloat, vk::ImageUsageFlagBits::eTransferSrc,
+                       normalImage, normalMemory, normalView);
+    createStorageImage(vk::Format::eR32Sfloat, vk::ImageUsageFlagBits::eTransferSrc,
+                       depthImage, depthMemory, depthView);
+    createStorageImage(vk::Format::eR32G32Uint, vk::ImageUsageFlagBits::eTransferSrc,
+                       idImage, idMemory, idView);
+}
+
+void createTemporalHistory(){
+    PROFILE_ZONE("createTemporalHistory");
+    // color: rgb + 累積フレーム数, geometry: 法線 + 線形深度。どちらも compute からしか触らない
+    historyColorImages.resize(2);
+    historyColorMemorys.resize(2);
+    historyColorViews.resize(2);
+    historyGeometryImages.resize(2);
+    historyGeometryMemorys.resize(2);
+    historyGeometryViews.resize(2);
+    for(size_t i = 0; i < 2; i++){
+        createStorageImage(vk::Format::eR32G32B32A32Sfloat, {},
+                           historyColorImages[i], historyColorMemorys[i], historyColorViews[i]);
+        createStorageImage(vk::Format::eR32G32B32A32Sfloat, {},
+                           historyGeometryImages[i], historyGeometryMemorys[i], historyGeometryViews[i]);
+    }
+}
+
+void createPathStatsBuffer(){
+    PROFILE_ZONE("createPathStatsBuffer");
+    PathStats zero{};
+    pathStatsBuffer.init(
+        physicalDevice, *device, sizeof(PathStats),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        &zero
+    );
+    pathStatsData = device->mapMemory(pathStatsBuffer.memory.get(), 0, sizeof(PathStats));
+}
+
+void createAdaptiveBuffers(){
+    PROFILE_ZONE("createAdaptiveBuffers");
+    // パス間で CPU が収束判定するので host visible に置く
+    vk::DeviceSize pixelCount = vk::DeviceSize(width) * height;
+    pixelAccumBuffer.init(
+        physicalDevice, *device, pixelCount * sizeof(PixelAccum),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+    pixelAccumData = device->mapMemory(pixelAccumBuffer.memory.get(), 0, VK_WHOLE_SIZE);
+
+    activePixelBuffer.init(
+        physicalDevice, *device, pixelCount * sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent
+    );
+    activePixelData = device->mapMemory(activePixelBuffer.memory.get(), 0, VK_WHOLE_SIZE);
 }
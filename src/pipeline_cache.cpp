@@ -0,0 +1,97 @@
+#include "../include/pipeline_cache.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/scene_cache.hpp"
+#include "../include/profiler.hpp"
+
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+constexpr char kPipelineCacheMagic[8] = {'M', 'A', 'P', 'L', 'E', 'P', 'S', 'O'};
+
+struct PipelineCacheFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[16];
+    uint64_t dataSize;
+    uint64_t dataHash;
+};
+
+// Vulkan 自身のキャッシュヘッダ (VkPipelineCacheHeaderVersionOne)
+struct VulkanCacheHeader {
+    uint32_t headerSize;
+    uint32_t headerVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t pipelineCacheUUID[16];
+};
+constexpr uint32_t kVulkanCacheHeaderVersionOne = 1;
+
+bool matches(const PipelineCacheKey& key, uint32_t vendorID, uint32_t deviceID, const uint8_t* uuid){
+    return key.vendorID == vendorID && key.deviceID == deviceID &&
+           std::memcmp(key.pipelineCacheUUID, uuid, sizeof(key.pipelineCacheUUID)) == 0;
+}
+
+}
+
+bool readPipelineCache(const std::filesystem::path& path, const PipelineCacheKey& key, std::vector<uint8_t>& data){
+    PROFILE_ZONE("readPipelineCache");
+    data.clear();
+    MappedFile file;
+    if(!file.open(path)) return false;
+
+    PipelineCacheFileHeader header{};
+    if(file.size < sizeof(header)) return false;
+    std::memcpy(&header, file.data, sizeof(header));
+    if(std::memcmp(header.magic, kPipelineCacheMagic, sizeof(kPipelineCacheMagic)) != 0) return false;
+    if(header.version != kPipelineCacheFileVersion) return false;
+    if(!matches(key, header.vendorID, header.deviceID, header.pipelineCacheUUID) || header.driverVersion != key.driverVersion) return false;
+    if(header.dataSize != file.size - sizeof(header)) return false;
+
+    std::span<const uint8_t> payload = file.bytes().subspan(sizeof(header));
+    if(hashBytes(payload) != header.dataHash) return false;
+
+    // 中身の Vulkan ヘッダも同じ GPU のものか確かめる
+    VulkanCacheHeader vkHeader{};
+    if(payload.size() < sizeof(vkHeader)) return false;
+    std::memcpy(&vkHeader, payload.data(), sizeof(vkHeader));
+    if(vkHeader.headerSize < sizeof(vkHeader) || vkHeader.headerSize > payload.size() ||
+       vkHeader.headerVersion != kVulkanCacheHeaderVersionOne ||
+       !matches(key, vkHeader.vendorID, vkHeader.deviceID, vkHeader.pipelineCacheUUID)) return false;
+
+    data.assign(payload.begin(), payload.end());
+    return true;
+}
+
+bool writePipelineCache(const std::filesystem::path& path, const PipelineCacheKey& key, std::span<const uint8_t> data){
+    PROFILE_ZONE("writePipelineCache");
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    PipelineCacheFileHeader header{};
+    std::memcpy(header.magic, kPipelineCacheMagic, sizeof(kPipelineCacheMagic));
+    header.version = kPipelineCacheFileVersion;
+    header.vendorID = key.vendorID;
+    header.deviceID = key.deviceID;
+    header.driverVersion = key.driverVersion;
+    std::memcpy(header.pipelineCacheUUID, key.pipelineCacheUUID, sizeof(header.pipelineCacheUUID));
+    header.dataSize = data.size();
+    header.dataHash = hashBytes(data);
+
+    // 書きかけのファイルを読まないように一時ファイルに書いてから置き換える
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!ofs) return false;
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+        if(!ofs) return false;
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
@@ -0,0 +1,746 @@
+#include "../include/png_encoder.hpp"
+#include "../include/parallel.hpp"
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define MAPLE_PNG_SSE2 1
+#endif
+
+namespace {
+
+// ---- レベルごとの設定 ----
+
+struct LevelParams {
+    bool adaptiveFilter;    // 行ごとに 5 種のフィルタから選ぶ。false なら Sub 固定 (レベル 0 は None)
+    bool lazy;              // 1 バイト先の一致が長ければそちらを使う
+    uint32_t maxChain;      // ハッシュチェーンを辿る上限
+    uint32_t niceLength;    // これ以上の一致が見つかったら探索を打ち切る
+    uint32_t maxInsert;     // 貪欲: これより長い一致の途中はハッシュに入れない / 遅延: これ以上の一致なら次を探さない
+};
+
+// zlib のレベル表に近い値
+constexpr LevelParams kLevels[10] = {
+    {false, false,    0,   0,   0},
+    {false, false,    4,  16,   8},
+    {true,  false,    8,  32,  16},
+    {true,  false,   16,  64,  32},
+    {true,  true,    16,  32,   8},
+    {true,  true,    32,  64,  16},
+    {true,  true,   128, 128,  16},
+    {true,  true,   256, 128,  32},
+    {true,  true,  1024, 258, 128},
+    {true,  true,  4096, 258, 258},
+};
+
+// ---- CRC-32 / Adler-32 ----
+
+const std::array<uint32_t, 256>& crcTable(){
+    static const std::array<uint32_t, 256> table = []{
+        std::array<uint32_t, 256> t{};
+        for(uint32_t n = 0; n < 256; n++){
+            uint32_t c = n;
+            for(int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            t[n] = c;
+        }
+        return t;
+    }();
+    return table;
+}
+
+uint32_t crc32(const uint8_t* data, size_t size){
+    const auto& table = crcTable();
+    uint32_t crc = 0xffffffffu;
+    for(size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffffu;
+}
+
+constexpr uint32_t kAdlerBase = 65521;
+
+uint32_t adler32(const uint8_t* data, size_t size){
+    uint32_t a = 1, b = 0;
+    while(size > 0){
+        // 5552 バイトまでは 32bit であふれない
+        size_t n = std::min<size_t>(size, 5552);
+        for(size_t i = 0; i < n; i++){
+            a += data[i];
+            b += a;
+        }
+        a %= kAdlerBase;
+        b %= kAdlerBase;
+        data += n;
+        size -= n;
+    }
+    return (b << 16) | a;
+}
+
+// adler32(A) と adler32(B) から adler32(A + B) を作る (zlib の adler32_combine と同じ)
+uint32_t adler32Combine(uint32_t adler1, uint32_t adler2, size_t size2){
+    uint32_t rem = uint32_t(size2 % kAdlerBase);
+    uint32_t sum1 = adler1 & 0xffff;
+    uint32_t sum2 = uint32_t((uint64_t(rem) * sum1) % kAdlerBase);
+    sum1 += (adler2 & 0xffff) + kAdlerBase - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + kAdlerBase - rem;
+    if(sum1 >= kAdlerBase) sum1 -= kAdlerBase;
+    if(sum1 >= kAdlerBase) sum1 -= kAdlerBase;
+    if(sum2 >= 2 * kAdlerBase) sum2 -= 2 * kAdlerBase;
+    if(sum2 >= kAdlerBase) sum2 -= kAdlerBase;
+    return (sum2 << 16) | sum1;
+}
+
+void put32be(std::vector<uint8_t>& out, uint32_t v){
+    for(int i = 3; i >= 0; i--) out.push_back(uint8_t(v >> (8 * i)));
+}
+
+void putChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size){
+    put32be(out, uint32_t(size));
+    size_t typeAt = out.size();
+    out.insert(out.end(), type, type + 4);
+    if(size > 0) out.insert(out.end(), data, data + size);
+    put32be(out, crc32(out.data() + typeAt, out.size() - typeAt));
+}
+
+// ---- フィルタ ----
+
+enum : uint8_t { kFilterNone = 0, kFilterSub = 1, kFilterUp = 2, kFilterAverage = 3, kFilterPaeth = 4 };
+
+constexpr size_t kBpp = 4;
+
+uint8_t paethPredict(int a, int b, int c){
+    int pa = std::abs(b - c);
+    int pb = std::abs(a - c);
+    int pc = std::abs(a + b - 2 * c);
+    if(pa <= pb && pa <= pc) return uint8_t(a);
+    return uint8_t(pb <= pc ? b : c);
+}
+
+#ifdef MAPLE_PNG_SSE2
+__m128i load16(const uint8_t* p){ return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+
+// 1 画素左。行頭はゼロ
+__m128i loadLeft(const uint8_t* row, size_t x){
+    return x == 0 ? _mm_slli_si128(load16(row), kBpp) : load16(row + x - kBpp);
+}
+
+__m128i abs16(__m128i v){ return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v)); }
+
+// 16bit レーンでの Paeth 予測
+__m128i paeth16(__m128i a, __m128i b, __m128i c){
+    __m128i bc = _mm_sub_epi16(b, c);
+    __m128i ac = _mm_sub_epi16(a, c);
+    __m128i pa = abs16(bc);
+    __m128i pb = abs16(ac);
+    __m128i pc = abs16(_mm_add_epi16(bc, ac));
+    __m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+    __m128i useC = _mm_cmpgt_epi16(pb, pc);
+    __m128i bOrC = _mm_or_si128(_mm_and_si128(useC, c), _mm_andnot_si128(useC, b));
+    return _mm_or_si128(_mm_andnot_si128(notA, a), _mm_and_si128(notA, bOrC));
+}
+#endif
+
+// cur を prior (前の行, 先頭行ならゼロ) を使ってフィルタし out に書く
+template<uint8_t Type>
+void filterRow(const uint8_t* cur, const uint8_t* prior, uint8_t* out, size_t n){
+    size_t x = 0;
+#ifdef MAPLE_PNG_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for(; x + 16 <= n; x += 16){
+        __m128i v = load16(cur + x);
+        __m128i r = v;
+        if constexpr(Type == kFilterSub){
+            r = _mm_sub_epi8(v, loadLeft(cur, x));
+        }else if constexpr(Type == kFilterUp){
+            r = _mm_sub_epi8(v, load16(prior + x));
+        }else if constexpr(Type == kFilterAverage){
+            __m128i a = loadLeft(cur, x);
+            __m128i b = load16(prior + x);
+            // avg_epu8 は切り上げなので切り捨てに直す
+            __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+            r = _mm_sub_epi8(v, avg);
+        }else if constexpr(Type == kFilterPaeth){
+            __m128i a = loadLeft(cur, x);
+            __m128i b = load16(prior + x);
+            __m128i c = loadLeft(prior, x);
+            __m128i lo = paeth16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+            __m128i hi = paeth16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+            r = _mm_sub_epi8(v, _mm_packus_epi16(lo, hi));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), r);
+    }
+#endif
+    for(; x < n; x++){
+        int a = x >= kBpp ? cur[x - kBpp] : 0;
+        int b = prior[x];
+        int c = x >= kBpp ? prior[x - kBpp] : 0;
+        int pred = 0;
+        if constexpr(Type == kFilterSub) pred = a;
+        else if constexpr(Type == kFilterUp) pred = b;
+        else if constexpr(Type == kFilterAverage) pred = (a + b) >> 1;
+        else if constexpr(Type == kFilterPaeth) pred = paethPredict(a, b, c);
+        out[x] = uint8_t(cur[x] - pred);
+    }
+}
+
+void filterRow(uint8_t type, const uint8_t* cur, const uint8_t* prior, uint8_t* out, size_t n){
+    switch(type){
+    case kFilterSub:     filterRow<kFilterSub>(cur, prior, out, n); break;
+    case kFilterUp:      filterRow<kFilterUp>(cur, prior, out, n); break;
+    case kFilterAverage: filterRow<kFilterAverage>(cur, prior, out, n); break;
+    case kFilterPaeth:   filterRow<kFilterPaeth>(cur, prior, out, n); break;
+    default:             filterRow<kFilterNone>(cur, prior, out, n); break;
+    }
+}
+
+// フィルタ選択の目安 (libpng と同じ、符号付きとみなした絶対値の和)
+uint64_t filterCost(const uint8_t* row, size_t n){
+    uint64_t sum = 0;
+    size_t x = 0;
+#ifdef MAPLE_PNG_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for(; x + 16 <= n; x += 16){
+        __m128i v = load16(row + x);
+        __m128i m = _mm_min_epu8(v, _mm_sub_epi8(zero, v));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(m, zero));
+    }
+    sum = uint64_t(uint32_t(_mm_cvtsi128_si32(acc))) + uint64_t(uint32_t(_mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc))));
+#endif
+    for(; x < n; x++) sum += std::min<uint32_t>(row[x], 256 - row[x]);
+    return sum;
+}
+
+// ---- deflate ----
+
+constexpr uint32_t kWindowSize = 32768;
+constexpr uint32_t kMinMatch = 4;       // 4 バイトのハッシュなので 3 バイトの一致は探さない
+constexpr uint32_t kMaxMatch = 258;
+constexpr uint32_t kHashBits = 15;
+constexpr size_t kBlockTokens = 1 << 15;
+
+constexpr uint8_t kLengthExtra[29] = {0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0};
+constexpr uint8_t kDistExtra[30] = {0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
+constexpr uint8_t kCodeLengthOrder[19] = {16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15};
+
+// length (3..258) -> 符号 257..285 と拡張ビット
+uint32_t lengthCode(uint32_t length, uint32_t& extra){
+    uint32_t v = length - 3;
+    if(length == 258){ extra = 0; return 285; }
+    if(v < 8){ extra = 0; return 257 + v; }
+    uint32_t nb = 31 - uint32_t(std::countl_zero(v));
+    extra = v & ((1u << (nb - 2)) - 1);
+    return 257 + (nb - 1) * 4 + ((v >> (nb - 2)) & 3);
+}
+
+// distance (1..32768) -> 符号 0..29 と拡張ビット
+uint32_t distCode(uint32_t dist, uint32_t& extra){
+    uint32_t v = dist - 1;
+    if(v < 4){ extra = 0; return v; }
+    uint32_t nb = 31 - uint32_t(std::countl_zero(v));
+    extra = v & ((1u << (nb - 1)) - 1);
+    return nb * 2 + ((v >> (nb - 1)) & 1);
+}
+
+struct Token {
+    uint16_t value;     // リテラル (distance == 0) か一致長
+    uint16_t distance;
+};
+
+// LSB から詰める deflate のビット列
+struct BitWriter {
+    std::vector<uint8_t>& out;
+    uint64_t bits = 0;
+    uint32_t count = 0;
+
+    void put(uint32_t value, uint32_t n){
+        bits |= uint64_t(value) << count;
+        count += n;
+        if(count >= 32){
+            uint8_t b[4] = {uint8_t(bits), uint8_t(bits >> 8), uint8_t(bits >> 16), uint8_t(bits >> 24)};
+            out.insert(out.end(), b, b + 4);
+            bits >>= 32;
+            count -= 32;
+        }
+    }
+
+    void align(){
+        while(count > 0){
+            out.push_back(uint8_t(bits));
+            bits >>= 8;
+            count = count > 8 ? count - 8 : 0;
+        }
+        bits = 0;
+    }
+};
+
+// 頻度から最大 maxBits の符号長を作る。はみ出した分はクラフトの不等式を満たすまで短い符号を割る
+void buildCodeLengths(const uint32_t* freq, int n, int maxBits, uint8_t* lengths){
+    std::fill(lengths, lengths + n, uint8_t(0));
+    std::vector<int> symbols;
+    for(int i = 0; i < n; i++){
+        if(freq[i]) symbols.push_back(i);
+    }
+    if(symbols.empty()) return;
+    if(symbols.size() == 1){
+        // 符号が 1 つだと不完全になるのでダミーを足す
+        lengths[symbols[0]] = 1;
+        lengths[symbols[0] == 0 ? 1 : 0] = 1;
+        return;
+    }
+    std::sort(symbols.begin(), symbols.end(), [&](int a, int b){
+        return freq[a] != freq[b] ? freq[a] < freq[b] : a < b;
+    });
+
+    // 葉と内部節点のキュー 2 本でハフマン木を作る (内部節点は作った順に重みが単調増加)
+    const size_t leaves = symbols.size();
+    std::vector<uint64_t> weight(2 * leaves - 1);
+    std::vector<uint32_t> parent(2 * leaves - 1);
+    for(size_t i = 0; i < leaves; i++) weight[i] = freq[symbols[i]];
+    size_t leaf = 0, inner = leaves;
+    for(size_t next = leaves; next < 2 * leaves - 1; next++){
+        auto pick = [&]{
+            if(leaf < leaves && (inner >= next || weight[leaf] <= weight[inner])) return leaf++;
+            return inner++;
+        };
+        size_t a = pick();
+        size_t b = pick();
+        weight[next] = weight[a] + weight[b];
+        parent[a] = parent[b] = uint32_t(next);
+    }
+
+    std::vector<uint32_t> depth(2 * leaves - 1, 0);
+    uint32_t count[64] = {};
+    for(size_t i = 2 * leaves - 1; i-- > 0;){
+        if(i + 1 < 2 * leaves - 1) depth[i] = depth[parent[i]] + 1;
+        if(i < leaves) count[std::min<uint32_t>(depth[i], uint32_t(maxBits))]++;
+    }
+
+    uint64_t total = 0;
+    for(int len = 1; len <= maxBits; len++) total += uint64_t(count[len]) << (maxBits - len);
+    while(total > (uint64_t(1) << maxBits)){
+        count[maxBits]--;
+        for(int len = maxBits - 1; len > 0; len--){
+            if(count[len]){
+                count[len]--;
+                count[len + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+
+    // 頻度の低い記号から長い符号を割り当てる
+    size_t index = 0;
+    for(int len = maxBits; len > 0; len--){
+        for(uint32_t k = 0; k < count[len]; k++) lengths[symbols[index++]] = uint8_t(len);
+    }
+}
+
+// 正準ハフマン符号。LSB から書くのでビットを反転しておく
+void buildCodes(const uint8_t* lengths, int n, uint16_t* codes){
+    uint32_t blCount[16] = {};
+    for(int i = 0; i < n; i++){
+        if(lengths[i]) blCount[lengths[i]]++;
+    }
+    uint32_t nextCode[16] = {};
+    uint32_t code = 0;
+    for(int bits = 1; bits < 16; bits++){
+        code = (code + blCount[bits - 1]) << 1;
+        nextCode[bits] = code;
+    }
+    for(int i = 0; i < n; i++){
+        uint32_t len = lengths[i];
+        if(!len) continue;
+        uint32_t c = nextCode[len]++;
+        uint32_t reversed = 0;
+        for(uint32_t b = 0; b < len; b++) reversed |= ((c >> b) & 1) << (len - 1 - b);
+        codes[i] = uint16_t(reversed);
+    }
+}
+
+// 空なら sync flush (長さ 0 の stored ブロック) になる
+void writeStored(BitWriter& bw, const uint8_t* data, size_t size, bool final){
+    size_t pos = 0;
+    do{
+        size_t len = std::min<size_t>(size - pos, 65535);
+        bool last = pos + len == size;
+        bw.put(final && last ? 1 : 0, 3);
+        bw.align();
+        uint8_t header[4] = {uint8_t(len), uint8_t(len >> 8), uint8_t(~len), uint8_t(~len >> 8)};
+        bw.out.insert(bw.out.end(), header, header + 4);
+        if(len > 0) bw.out.insert(bw.out.end(), data + pos, data + pos + len);
+        pos += len;
+    }while(pos < size);
+}
+
+// tokens は raw をちょうど表す。動的ハフマンが stored より大きくなるなら stored で書く
+void writeBlock(BitWriter& bw, const std::vector<Token>& tokens, const uint8_t* raw, size_t rawSize, bool final){
+    uint32_t litFreq[286] = {};
+    uint32_t distFreq[30] = {};
+    uint32_t extra;
+    for(const Token& t : tokens){
+        if(t.distance == 0){
+            litFreq[t.value]++;
+        }else{
+            litFreq[lengthCode(t.value, extra)]++;
+            distFreq[distCode(t.distance, extra)]++;
+        }
+    }
+    litFreq[256] = 1;
+
+    uint8_t lengths[286 + 30];
+    uint8_t* litLengths = lengths;
+    uint8_t* distLengths = lengths + 286;
+    buildCodeLengths(litFreq, 286, 15, litLengths);
+    buildCodeLengths(distFreq, 30, 15, distLengths);
+    if(std::all_of(distLengths, distLengths + 30, [](uint8_t l){ return l == 0; })){
+        distLengths[0] = distLengths[1] = 1;
+    }
+
+    uint32_t hlit = 286;
+    while(hlit > 257 && litLengths[hlit - 1] == 0) hlit--;
+    uint32_t hdist = 30;
+    while(hdist > 1 && distLengths[hdist - 1] == 0) hdist--;
+
+    // 符号長の列を 16 (直前を繰り返し), 17/18 (0 の連続) で詰める
+    uint8_t all[286 + 30];
+    std::memcpy(all, litLengths, hlit);
+    std::memcpy(all + hlit, distLengths, hdist);
+    const uint32_t total = hlit + hdist;
+    struct Rle { uint8_t symbol; uint8_t extra; };
+    std::vector<Rle> rle;
+    uint32_t clFreq[19] = {};
+    for(uint32_t i = 0; i < total;){
+        uint8_t len = all[i];
+        uint32_t run = 1;
+        while(i + run < total && all[i + run] == len) run++;
+        uint32_t used = run;
+        if(len == 0 && run >= 3){
+            used = std::min<uint32_t>(run, 138);
+            rle.push_back(used >= 11 ? Rle{18, uint8_t(used - 11)} : Rle{17, uint8_t(used - 3)});
+        }else if(len != 0 && run >= 4){
+            used = std::min<uint32_t>(run - 1, 6) + 1;
+            rle.push_back({len, 0});
+            rle.push_back({16, uint8_t(used - 4)});
+        }else{
+            used = 1;
+            rle.push_back({len, 0});
+        }
+        i += used;
+    }
+    for(const Rle& r : rle) clFreq[r.symbol]++;
+
+    uint8_t clLengths[19];
+    uint16_t clCodes[19] = {};
+    buildCodeLengths(clFreq, 19, 7, clLengths);
+    buildCodes(clLengths, 19, clCodes);
+    uint32_t hclen = 19;
+    while(hclen > 4 && clLengths[kCodeLengthOrder[hclen - 1]] == 0) hclen--;
+
+    // ビット数を見積もって stored と比べる
+    uint64_t dynamicBits = 3 + 14 + 3 * hclen;
+    for(const Rle& r : rle){
+        dynamicBits += clLengths[r.symbol] + (r.symbol == 16 ? 2 : r.symbol == 17 ? 3 : r.symbol == 18 ? 7 : 0);
+    }
+    for(uint32_t i = 0; i < 286; i++){
+        dynamicBits += uint64_t(litFreq[i]) * (litLengths[i] + (i > 256 ? kLengthExtra[i - 257] : 0));
+    }
+    for(uint32_t i = 0; i < 30; i++) dynamicBits += uint64_t(distFreq[i]) * (distLengths[i] + kDistExtra[i]);
+    uint64_t storedBits = (uint64_t(rawSize) + 5 * (rawSize / 65535 + 1)) * 8 + 8;
+    if(storedBits < dynamicBits){
+        writeStored(bw, raw, rawSize, final);
+        return;
+    }
+
+    uint16_t litCodes[286] = {};
+    uint16_t distCodes[30] = {};
+    buildCodes(litLengths, 286, litCodes);
+    buildCodes(distLengths, 30, distCodes);
+
+    bw.put(final ? 1 : 0, 1);
+    bw.put(2, 2);
+    bw.put(hlit - 257, 5);
+    bw.put(hdist - 1, 5);
+    bw.put(hclen - 4, 4);
+    for(uint32_t i = 0; i < hclen; i++) bw.put(clLengths[kCodeLengthOrder[i]], 3);
+    for(const Rle& r : rle){
+        bw.put(clCodes[r.symbol], clLengths[r.symbol]);
+        if(r.symbol == 16) bw.put(r.extra, 2);
+        else if(r.symbol == 17) bw.put(r.extra, 3);
+        else if(r.symbol == 18) bw.put(r.extra, 7);
+    }
+
+    for(const Token& t : tokens){
+        if(t.distance == 0){
+            bw.put(litCodes[t.value], litLengths[t.value]);
+            continue;
+        }
+        uint32_t lc = lengthCode(t.value, extra);
+        bw.put(litCodes[lc], litLengths[lc]);
+        bw.put(extra, kLengthExtra[lc - 257]);
+        uint32_t dc = distCode(t.distance, extra);
+        bw.put(distCodes[dc], distLengths[dc]);
+        bw.put(extra, kDistExtra[dc]);
+    }
+    bw.put(litCodes[256], litLengths[256]);
+}
+
+uint32_t matchLength(const uint8_t* a, const uint8_t* b, uint32_t limit){
+    uint32_t len = 0;
+    while(len + 8 <= limit){
+        uint64_t x, y;
+        std::memcpy(&x, a + len, 8);
+        std::memcpy(&y, b + len, 8);
+        if(uint64_t diff = x ^ y) return len + uint32_t(std::countr_zero(diff)) / 8;
+        len += 8;
+    }
+    while(len < limit && a[len] == b[len]) len++;
+    return len;
+}
+
+// ハッシュチェーンによる LZ77。位置はフィルタ後のバッファ全体での絶対位置
+struct MatchFinder {
+    const uint8_t* data;
+    size_t size;
+    LevelParams params;
+    std::vector<int32_t> head = std::vector<int32_t>(size_t(1) << kHashBits);
+    std::vector<int32_t> prev = std::vector<int32_t>(kWindowSize);
+
+    // ストリップごとに作り直して、出力がスレッドの割り当てに依存しないようにする
+    void reset(){
+        std::fill(head.begin(), head.end(), -1);
+        std::fill(prev.begin(), prev.end(), -1);
+    }
+
+    uint32_t hash(size_t pos) const {
+        uint32_t v;
+        std::memcpy(&v, data + pos, 4);
+        return (v * 2654435761u) >> (32 - kHashBits);
+    }
+
+    void insert(size_t pos){
+        if(pos + 4 > size) return;
+        uint32_t h = hash(pos);
+        prev[pos & (kWindowSize - 1)] = head[h];
+        head[h] = int32_t(pos);
+    }
+
+    // end を超える一致は作らない (end の先は次のストリップ)
+    uint32_t find(size_t pos, size_t end, uint32_t& bestDist) const {
+        uint32_t limit = uint32_t(std::min<size_t>(kMaxMatch, end - pos));
+        if(limit < kMinMatch || pos + 4 > size) return 0;
+        uint32_t bestLen = kMinMatch - 1;
+        int32_t cand = head[hash(pos)];
+        for(uint32_t chain = params.maxChain; cand >= 0 && chain > 0; chain--){
+            size_t dist = pos - size_t(cand);
+            if(dist > kWindowSize) break;
+            if(data[cand + bestLen] == data[pos + bestLen]){
+                uint32_t len = matchLength(data + cand, data + pos, limit);
+                if(len > bestLen){
+                    bestLen = len;
+                    bestDist = uint32_t(dist);
+                    if(len >= params.niceLength || len == limit) break;
+                }
+            }
+            int32_t next = prev[size_t(cand) & (kWindowSize - 1)];
+            if(next >= cand) break;
+            cand = next;
+        }
+        return bestLen >= kMinMatch ? bestLen : 0;
+    }
+};
+
+// data[begin, end) を deflate する。直前 32KB は辞書としてだけ使う
+// final でなければ sync flush で終えるので、次のストリップの出力をそのまま後ろにつなげられる
+void deflateStrip(MatchFinder& mf, size_t begin, size_t end, bool final, std::vector<uint8_t>& out){
+    BitWriter bw{out};
+    const uint8_t* data = mf.data;
+    if(mf.params.maxChain == 0){
+        writeStored(bw, data + begin, end - begin, final);
+        return;
+    }
+
+    mf.reset();
+    for(size_t p = begin > kWindowSize ? begin - kWindowSize : 0; p < begin; p++) mf.insert(p);
+
+    std::vector<Token> tokens;
+    tokens.reserve(kBlockTokens + 2);
+    size_t blockStart = begin;
+    size_t covered = begin;
+    auto literal = [&](size_t pos){
+        tokens.push_back({data[pos], 0});
+        covered++;
+    };
+    auto match = [&](uint32_t len, uint32_t dist){
+        tokens.push_back({uint16_t(len), uint16_t(dist)});
+        covered += len;
+    };
+    auto flushIfFull = [&]{
+        if(tokens.size() < kBlockTokens) return;
+        writeBlock(bw, tokens, data + blockStart, covered - blockStart, false);
+        tokens.clear();
+        blockStart = covered;
+    };
+
+    if(!mf.params.lazy){
+        size_t pos = begin;
+        while(pos < end){
+            uint32_t dist = 0;
+            uint32_t len = mf.find(pos, end, dist);
+            mf.insert(pos);
+            if(len){
+                match(len, dist);
+                if(len <= mf.params.maxInsert){
+                    for(size_t i = 1; i < len; i++) mf.insert(pos + i);
+                }
+                pos += len;
+            }else{
+                literal(pos);
+                pos++;
+            }
+            flushIfFull();
+        }
+    }else{
+        // 1 つ前の位置の一致を保留しておき、今の位置の一致のほうが長ければリテラルにする
+        uint32_t prevLen = 0, prevDist = 0;
+        bool pending = false;
+        size_t pos = begin;
+        while(pos < end){
+            uint32_t dist = 0;
+            uint32_t len = prevLen >= mf.params.maxInsert ? 0 : mf.find(pos, end, dist);
+            mf.insert(pos);
+            if(prevLen >= kMinMatch && len <= prevLen){
+                match(prevLen, prevDist);
+                size_t matchEnd = pos - 1 + prevLen;
+                for(size_t p = pos + 1; p < matchEnd; p++) mf.insert(p);
+                pos = matchEnd;
+                prevLen = 0;
+                pending = false;
+            }else{
+                if(pending) literal(pos - 1);
+                pending = true;
+                prevLen = len;
+                prevDist = dist;
+                pos++;
+            }
+            flushIfFull();
+        }
+        if(pending) literal(end - 1);
+    }
+
+    writeBlock(bw, tokens, data + blockStart, covered - blockStart, final);
+    if(!final) writeStored(bw, nullptr, 0, false);
+    bw.align();
+}
+
+}
+
+bool encodePng(std::span<const uint8_t> rgba, uint32_t width, uint32_t height, const PngOptions& options, std::vector<uint8_t>& out){
+    PROFILE_ZONE("encodePng");
+    const size_t rowBytes = size_t(width) * 4;
+    if(width == 0 || height == 0 || rgba.size() < rowBytes * height) return false;
+
+    const int level = std::clamp(options.level, 0, 9);
+    const LevelParams& params = kLevels[level];
+    const size_t stride = rowBytes + 1;
+
+    // 行ごとのフィルタ (行の間に依存はない)
+    std::vector<uint8_t> filtered(stride * height);
+    {
+        PROFILE_ZONE("png filter");
+        const std::vector<uint8_t> zeroRow(rowBytes, 0);
+        parallelRows(height, [&](uint32_t begin, uint32_t end){
+            std::array<std::vector<uint8_t>, 5> trial;
+            if(params.adaptiveFilter){
+                for(auto& t : trial) t.resize(rowBytes);
+            }
+            for(uint32_t y = begin; y < end; y++){
+                const uint8_t* cur = rgba.data() + rowBytes * y;
+                const uint8_t* prior = y > 0 ? cur - rowBytes : zeroRow.data();
+                uint8_t* dst = filtered.data() + stride * y;
+                if(!params.adaptiveFilter){
+                    dst[0] = level == 0 ? kFilterNone : kFilterSub;
+                    filterRow(dst[0], cur, prior, dst + 1, rowBytes);
+                    continue;
+                }
+                uint8_t best = 0;
+                uint64_t bestCost = UINT64_MAX;
+                for(uint8_t type = 0; type < 5; type++){
+                    filterRow(type, cur, prior, trial[type].data(), rowBytes);
+                    uint64_t cost = filterCost(trial[type].data(), rowBytes);
+                    if(cost < bestCost){
+                        bestCost = cost;
+                        best = type;
+                    }
+                }
+                dst[0] = best;
+                std::memcpy(dst + 1, trial[best].data(), rowBytes);
+            }
+        });
+    }
+
+    // ストリップの境界は行数だけで決めるので、出力はスレッド数によらない
+    const uint32_t stripRows = uint32_t(std::clamp<size_t>(options.stripBytes / stride, 1, height));
+    const uint32_t stripCount = (height + stripRows - 1) / stripRows;
+    struct Strip {
+        std::vector<uint8_t> chunk;     // IDAT チャンク全体 (長さ, 型, データ, CRC)
+        uint32_t adler = 1;
+        size_t size = 0;
+    };
+    std::vector<Strip> strips(stripCount);
+    {
+        PROFILE_ZONE("png deflate");
+        parallelRows(stripCount, [&](uint32_t first, uint32_t last){
+            MatchFinder mf{filtered.data(), filtered.size(), params};
+            for(uint32_t s = first; s < last; s++){
+                size_t begin = stride * s * stripRows;
+                size_t end = stride * std::min(height, (s + 1) * stripRows);
+                Strip& strip = strips[s];
+                strip.size = end - begin;
+                strip.adler = adler32(filtered.data() + begin, strip.size);
+
+                std::vector<uint8_t>& chunk = strip.chunk;
+                chunk.reserve(strip.size / 2 + 64);
+                chunk.insert(chunk.end(), {0, 0, 0, 0, 'I', 'D', 'A', 'T'});
+                if(s == 0){
+                    // zlib ヘッダ。FLEVEL はレベルの目安
+                    chunk.push_back(0x78);
+                    chunk.push_back(level <= 1 ? 0x01 : level <= 5 ? 0x5e : level == 6 ? 0x9c : 0xda);
+                }
+                deflateStrip(mf, begin, end, s + 1 == stripCount, chunk);
+                uint32_t dataSize = uint32_t(chunk.size() - 8);
+                for(int i = 0; i < 4; i++) chunk[i] = uint8_t(dataSize >> (24 - 8 * i));
+                put32be(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+            }
+        }, 1);
+    }
+
+    uint32_t adler = strips[0].adler;
+    for(uint32_t s = 1; s < stripCount; s++) adler = adler32Combine(adler, strips[s].adler, strips[s].size);
+    size_t total = 8 + 25 + 16 + 12;    // シグネチャ, IHDR, Adler の IDAT, IEND
+    for(const Strip& strip : strips) total += strip.chunk.size();
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    out.clear();
+    out.reserve(total);
+    out.insert(out.end(), signature, signature + 8);
+    uint8_t ihdr[13];
+    for(int i = 0; i < 4; i++){
+        ihdr[i] = uint8_t(width >> (24 - 8 * i));
+        ihdr[4 + i] = uint8_t(height >> (24 - 8 * i));
+    }
+    const uint8_t ihdrTail[5] = {8, 6, 0, 0, 0};   // 8bit RGBA, deflate, 適応フィルタ, インターレース無し
+    std::memcpy(ihdr + 8, ihdrTail, 5);
+    putChunk(out, "IHDR", ihdr, sizeof(ihdr));
+    for(const Strip& strip : strips) out.insert(out.end(), strip.chunk.begin(), strip.chunk.end());
+    // Adler-32 は全ストリップが揃ってからなので別の IDAT にする
+    uint8_t adlerBytes[4] = {uint8_t(adler >> 24), uint8_t(adler >> 16), uint8_t(adler >> 8), uint8_t(adler)};
+    putChunk(out, "IDAT", adlerBytes, 4);
+    putChunk(out, "IEND", nullptr, 0);
+    return true;
+}
@@ -0,0 +1,86 @@
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+
+Profiler profiler;
+thread_local ProfileThread profileThread;
+
+double Profiler::nowUs() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void Profiler::addEvent(const char* name, uint32_t track, double startUs, double durationUs, uint32_t eventFrame){
+    if (eventFrame == kNoFrame) eventFrame = frame;
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back({name, track, eventFrame, startUs, durationUs});
+}
+
+static const char* trackName(uint32_t track){
+    switch (track) {
+    case kTrackGpu: return "gpu";
+    case kTrackWriter: return "io";
+    default: return "cpu";
+    }
+}
+
+static std::string escapeJson(const std::string& s){
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        if (c == '"' || c == '\\') out.push_back('\\');
+        out.push_back(c);
+    }
+    return out;
+}
+
+bool Profiler::writeChromeTrace(const std::filesystem::path& path) const {
+    std::FILE* fp = std::fopen(path.string().c_str(), "w");
+    if (!fp) {
+        std::fprintf(stderr, "failed to open %s\n", path.string().c_str());
+        return false;
+    }
+
+    std::fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    std::fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"CPU\"}},\n", kTrackCpu);
+    std::fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"GPU\"}},\n", kTrackGpu);
+    std::fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"Writer\"}}", kTrackWriter);
+    for (const auto& e : events) {
+        std::fprintf(fp, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+            escapeJson(e.name).c_str(), trackName(e.track), e.track, e.startUs, e.durationUs);
+        if (e.frame != kNoFrame) {
+            std::fprintf(fp, ",\"args\":{\"frame\":%u}", e.frame);
+        }
+        std::fprintf(fp, "}");
+    }
+    std::fprintf(fp, "\n]}\n");
+    std::fclose(fp);
+    return true;
+}
+
+void Profiler::printSummary() const {
+    std::map<std::pair<uint32_t, std::string>, std::vector<double>> groups;
+    for (const auto& e : events) {
+        groups[{e.track, e.name}].push_back(e.durationUs / 1000.0);
+    }
+
+    std::printf("%-4s %-28s %7s %10s %10s %10s %12s\n", "", "phase", "count", "min[ms]", "med[ms]", "p99[ms]", "total[ms]");
+    for (auto& [key, ms] : groups) {
+        std::sort(ms.begin(), ms.end());
+        double total = 0.0;
+        for (double v : ms) total += v;
+        size_t n = ms.size();
+        double median = (n % 2) ? ms[n / 2] : 0.5 * (ms[n / 2 - 1] + ms[n / 2]);
+        double p99 = ms[std::min(n - 1, size_t(0.99 * double(n - 1) + 0.5))];
+        std::printf("%-4s %-28s %7zu %10.3f %10.3f %10.3f %12.3f\n",
+            trackName(key.first), key.second.c_str(), n, ms.front(), median, p99, total);
+    }
+}
+
+ProfileZone::ProfileZone(const char* zoneName)
+    : name(zoneName), startUs(profiler.nowUs()) {}
+
+ProfileZone::~ProfileZone(){
+    profiler.addEvent(name, profileThread.track, startUs, profiler.nowUs() - startUs, profileThread.frame);
+}
@@ -1,14 +1,56 @@
 #include "../include/globals.hpp"
 #include "../include/vk_setup.hpp"
 #include "../include/descriptors.hpp"
+#include "../include/adaptive.hpp"
+#include "../include/profiler.hpp"
+#include "../include/gpu_profiler.hpp"
+#include "../include/tonemap.hpp"
+#include "../include/temporal.hpp"
+#include "../include/render.hpp"
+#include "../include/frame_queue.hpp"
+#include "../include/denoise.hpp"
+#include "../include/checkpoint.hpp"
+#include "../include/shaders.hpp"
+#include <atomic>
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 #include <chrono>
-#include <stb_image_write.h>
-
-
-void drawCall(std::filesystem::path exePath){
+#include <thread>
+
+namespace {
+
+// チェックポイントから再開してよいかの判定に使う。出力が変わる設定はすべて含める
+uint64_t renderConfigHash(const RenderOptions& options, uint32_t frameCount, uint32_t fps){
+    std::vector<uint8_t> bytes;
+    auto add = [&](const auto& value){
+        const auto* p = reinterpret_cast<const uint8_t*>(&value);
+        bytes.insert(bytes.end(), p, p + sizeof(value));
+    };
+    add(width);
+    add(height);
+    add(frameCount);
+    add(fps);
+    add(options.outputFormat);
+    add(options.writeImages);
+    add(options.writeAovs);
+    add(options.denoise);
+    add(options.temporal);
+    add(options.maxSamples);
+    // pathStats は出力を変えないので含めない
+    add(options.shaderConstants.maxDepth);
+    add(options.shaderConstants.rouletteMinDepth);
+    add(options.shaderConstants.sunNee);
+    add(options.shaderConstants.russianRoulette);
+    for(const auto& key : cameraTimeline.keys) add(key);
+    return hashBytes(bytes);
+}
+
+}
+
+void drawCall(std::filesystem::path exePath, const RenderOptions& options){
     std::string fpsTxtPath = (exePath / "fps.txt").string();
     std::ifstream ifs(fpsTxtPath);
     if (!ifs) {
@@ -18,9 +60,127 @@ void drawCall(std::filesystem::path exePath){
     uint32_t fps = 0;
     ifs >> fps;
     float playTime = 3.0;
+    // カメラが動くなら最後のキーまで、キーが無い・1 つだけ (静止カメラ) なら playTime 秒を描く
+    cameraTimeline.fps = float(std::max(1u, fps));
+    const bool animatedCamera = cameraTimeline.keys.size() >= 2 && cameraTimeline.duration() > 0.0f;
+    const uint32_t frameCount = animatedCamera
+        ? uint32_t(std::floor(cameraTimeline.duration() * cameraTimeline.fps)) + 1
+        : uint32_t(fps * playTime);
+    cameraTimeline.frameCount = std::max(1u, frameCount);
 
     int frameIndex = 0;
-    std::cout << "output: " << fps * playTime << " images" << std::endl;
+    if(options.writeImages){
+        std::cout << "output: " << frameCount << " images (" << outputFormatName(options.outputFormat) << ")" << std::endl;
+    }
+    // デノイズは HDR と AOV を CPU に読み戻して書き出しスレッドで行う
+    const bool denoise = options.denoise;
+    const bool readbackHdr = denoise || (options.writeImages && outputNeedsHdr(options.outputFormat));
+    const bool readbackAov = denoise || options.writeAovs;
+    // テンポラル累積は GPU で深度と法線の AOV を使う
+    const bool temporal = options.temporal;
+    const bool writeAovImages = readbackAov || temporal;
+    TonemapParams tonemap{};
+
+    // 書き終えたフレームを記録し、--resume では出力ファイルが記録どおりに残っているフレームを飛ばす
+    // 締め切りで止まったフレームの累積も残すが、AOV とテンポラル履歴は GPU の画像にしか無いので
+    // それらを使うときは止まったフレームを最初から描き直す
+    // --watch-shaders では同じフレームを違うシェーダで描き直すので記録しない
+    const bool useCheckpoint = (options.writeImages || options.writeAovs) && !options.watchShaders;
+    const bool resumablePartial = !writeAovImages;
+    const std::filesystem::path checkpointPath = "render.checkpoint";
+    RenderCheckpoint checkpoint;
+    checkpoint.configHash = renderConfigHash(options, frameCount, fps);
+    checkpoint.frameCount = frameCount;
+    std::vector<bool> finishedFrames(frameCount, false);
+    uint32_t resumeFrame = kNoPartialFrame;
+    uint32_t resumePasses = 0;
+    std::vector<uint8_t> resumeState;
+    if(options.resume && useCheckpoint){
+        RenderCheckpoint previous;
+        if(readCheckpoint(checkpointPath, previous) &&
+           previous.configHash == checkpoint.configHash && previous.frameCount == frameCount){
+            finishedFrames = verifiedFrames(previous);
+            for(auto& frame : previous.frames){
+                if(finishedFrames[frame.index]) checkpoint.recordFrame(std::move(frame));
+            }
+            if(resumablePartial && previous.partialFrame != kNoPartialFrame && !finishedFrames[previous.partialFrame] &&
+               previous.partialState.size() == size_t(width) * height * sizeof(PixelAccum)){
+                resumeFrame = previous.partialFrame;
+                resumePasses = previous.partialPasses;
+                resumeState = std::move(previous.partialState);
+            }
+            std::cout << "resume: " << std::count(finishedFrames.begin(), finishedFrames.end(), true)
+                      << " / " << frameCount << " frames already written" << std::endl;
+        }else{
+            std::cout << "resume: no matching checkpoint, starting from frame 000" << std::endl;
+        }
+        if(options.videoSink != VideoSink::None){
+            std::cout << "resume: the video contains only the frames rendered in this run" << std::endl;
+        }
+    }
+    // 書き出しスレッドは、締め切りで止まったフレームを書き終えたフレームとして記録しない
+    std::atomic<uint32_t> interruptedFrame{kNoPartialFrame};
+
+    VideoWriter video;
+    if(options.videoSink != VideoSink::None){
+        std::filesystem::path videoPath = options.videoPath.empty() ? std::filesystem::path(defaultVideoPath(options.videoSink)) : options.videoPath;
+        if(!video.open(options.videoSink, videoPath, width, height, fps)) return;
+        std::cout << "video: " << videoPath.string() << " (" << videoSinkName(options.videoSink) << ")" << std::endl;
+    }
+
+    // エンコードと書き込みは書き出しスレッドで行い、その間に次のフレームを描く
+    // デノイズ結果は書き出しスレッドだけが触る
+    std::vector<float> denoisedHdr;
+    std::vector<uint8_t> denoisedLdr;
+    FrameQueue frameQueue([&](uint32_t index, const OutputFrame& input){
+        OutputFrame frame = input;
+        if(denoise){
+            DenoiseInput denoiseInput{input.width, input.height, input.hdr, input.albedo, input.normal, input.depth, input.variance};
+            if(denoiseFrame(denoiseInput, DenoiseParams{}, denoisedHdr)){
+                denoisedLdr.resize(size_t(input.width) * input.height * 4);
+                tonemapFrame(denoisedHdr, input.width, input.height, tonemap, denoisedLdr);
+                frame.hdr = denoisedHdr;
+                frame.ldr = denoisedLdr;
+            }else{
+                std::cerr << "failed to denoise frame " << index << "\n";
+            }
+        }
+        CheckpointFrame record{index, {}};
+        bool written = true;
+        if(options.writeImages){
+            char filename[256];
+            std::snprintf(filename, sizeof(filename), "%03u.%s", index, outputExtension(options.outputFormat));
+            if(!writeFrame(filename, options.outputFormat, frame)){
+                std::cerr << "failed to write " << filename << "\n";
+                written = false;
+            }
+            record.files.push_back({filename});
+        }
+        if(options.writeAovs){
+            char filename[256];
+            std::snprintf(filename, sizeof(filename), "%03u_aov.exr", index);
+            if(!writeAovFrame(filename, frame)){
+                std::cerr << "failed to write " << filename << "\n";
+                written = false;
+            }
+            record.files.push_back({filename});
+        }
+        if(useCheckpoint && written && index != interruptedFrame.load()){
+            for(auto& file : record.files){
+                written = written && describeFile(file.path, file);
+            }
+            if(written){
+                checkpoint.recordFrame(std::move(record));
+                if(!writeCheckpoint(checkpointPath, checkpoint)){
+                    std::cerr << "failed to write " << checkpointPath.string() << "\n";
+                }
+            }
+        }
+        if(video.fp && !video.write(frame.ldr)){
+            std::cerr << "failed to write video frame " << index << "\n";
+            video.close();
+        }
+    });
 
     vk::CommandBufferAllocateInfo cmdAllocInfo{};
     cmdAllocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
@@ -50,16 +210,49 @@ void drawCall(std::filesystem::path exePath){
 
     uint32_t currentFrame = 0;
     float time = 0;
-    updateDescriptorSet(0, outputView.get());
+    updateDescriptorSet(0, hdrView.get());
 
     const auto start = std::chrono::system_clock::now();
-    const auto deadline = start + std::chrono::seconds(180);
+    // --watch-shaders は止めるまで変更を待ち続ける
+    const auto deadline = start + std::chrono::seconds(options.watchShaders ? 24 * 3600 : 180);
+    std::unique_ptr<ShaderWatcher> shaderWatcher;
+    if(options.watchShaders) shaderWatcher = createShaderWatcher(exePath / "cache" / "shaders");
 
     int update = 0;
+
+    AdaptiveConfig adaptive{};
+    if(options.maxSamples > 0){
+        adaptive.maxSamples = options.maxSamples;
+        adaptive.minSamples = std::min(adaptive.minSamples, options.maxSamples);
+        adaptive.samplesPerPass = std::min(adaptive.samplesPerPass, options.maxSamples);
+    }
+    std::vector<uint32_t> activePixels;
+    activePixels.reserve(size_t(width) * height);
+    std::vector<float> variance;
+    CameraView previousView{};
+    // この実行で最後に描いたフレーム。飛ばしたフレームの後は画像のレイアウトと履歴を作り直す
+    int lastRendered = -1;
+    uint32_t interruptedPasses = 0;
+    std::vector<uint8_t> interruptedState;
     
     while(
         //frameIndex < 3 && 
-        frameIndex < fps * playTime && std::chrono::system_clock::now() < deadline){
+        (frameIndex < int(frameCount) || shaderWatcher) && std::chrono::system_clock::now() < deadline){
+        if(shaderWatcher){
+            // 描き直しは RT パイプラインだけ。最後に描いたフレームを新しいシェーダでもう一度描く
+            if(reloadRayTracingShaders(*shaderWatcher, options.shaderConstants) && lastRendered >= 0){
+                frameIndex = lastRendered;
+            }
+            // 全フレームを描き終えたら次の変更を待つ
+            if(frameIndex >= int(frameCount)){
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+        }
+        if(finishedFrames[frameIndex]){
+            frameIndex++;
+            continue;
+        }
         {
             auto now = std::chrono::system_clock::now();
             auto remaining = (deadline > now) ? (deadline - now) : std::chrono::system_clock::duration::zero();
@@ -72,82 +265,271 @@ void drawCall(std::filesystem::path exePath){
             }
         }
         auto waitRes = device->waitForFences(inFlight[currentFrame].get(), VK_TRUE, UINT64_MAX);
-        device->resetFences(inFlight[0].get());
+        profiler.frame = frameIndex;
+        PROFILE_ZONE("frame");
+        const bool firstRendered = lastRendered < 0;
+        const bool historyValid = !firstRendered && lastRendered == frameIndex - 1;
 
         //----------------------------------------------------------------------------
         // update uniformbuffer
 
         vk::DeviceSize bufferSize = sizeof(SceneUBO);
 
-        static std::chrono::system_clock::time_point prevTime;
-        static float up = 2.0f;
-        static float theta = M_PI / (fps * playTime);
-        static float d = 4 / (fps * playTime);
-
-        // const auto nowTime = std::chrono::system_clock::now();
-        // const auto delta = 0.05 * std::chrono::duration_cast<std::chrono::microseconds>(nowTime - prevTime).count();
-        //scene.camPos += up * std::sin(delta);
-        scene.camPos.x = 1.5 * std::sin(5/4*M_PI + frameIndex * theta);
-        scene.camPos.y = 3 * std::sin(6/4*M_PI + frameIndex * theta);
-        scene.camPos.z = 4 * std::cos(5/4*M_PI + frameIndex * theta);
-        memcpy(uniformData, &scene, (size_t)bufferSize);
-
-        vk::MappedMemoryRange flushMemoryRange;
-        flushMemoryRange.setMemory(sceneBuffer.memory.get());
-        flushMemoryRange.setOffset(0);
-        flushMemoryRange.setSize(VK_WHOLE_SIZE);
-        device->flushMappedMemoryRanges({flushMemoryRange});
+        // 各フレームのカメラはタイムラインだけから決まる (前のフレームに依存しない)
+        CameraView view = cameraTimeline.view(frameIndex);
+        scene.camPos = glm::vec4(view.position, view.tanHalfFov);
+        scene.camForward = glm::vec4(view.forward, 0.0f);
+        scene.camRight = glm::vec4(view.right, 0.0f);
+        scene.camUp = glm::vec4(view.up, 0.0f);
+        // --stats: パスごとの 32bit カウンタを 64bit で足し合わせる
+        const bool collectStats = options.shaderConstants.pathStats != 0;
+        uint64_t statPaths = 0, statSegments = 0, statRouletteKills = 0, statDeadKills = 0;
+        if(collectStats) std::memset(pathStatsData, 0, sizeof(PathStats));
 
-        //----------------------------------------------------------------------------
+        vk::ImageSubresourceRange range{};
+        range.aspectMask = vk::ImageAspectFlagBits::eColor;
+        range.baseMipLevel = 0; range.levelCount  = 1;
+        range.baseArrayLayer = 0; range.layerCount = 1;
 
         auto& cmdBuf = cmdBufs[0];
-        cmdBuf->reset();
-
         vk::CommandBufferBeginInfo cmdBeginInfo{};
+
+        auto submitAndWait = [&](){
+            vk::CommandBuffer submitCmdBuf[1] = {cmdBuf.get()};
+            vk::SubmitInfo submitInfo{};
+            submitInfo.setCommandBufferCount(1);
+            submitInfo.setPCommandBuffers(submitCmdBuf);
+
+            vk::PipelineStageFlags renderwaitStages[] = {vk::PipelineStageFlagBits::eRayTracingShaderKHR};
+            submitInfo.setPWaitDstStageMask(renderwaitStages);
+
+            device->resetFences(inFlight[0].get());
+            double submitUs = profiler.nowUs();
+            queue.submit({submitInfo}, inFlight[0].get());
+            auto res = device->waitForFences(inFlight[0].get(), VK_TRUE, UINT64_MAX);
+            gpuTimerCollect(submitUs);
+            return res;
+        };
+
+        //----------------------------------------------------------------------------
+        // adaptive sampling
+        // pass 0 は全画素、以降は CPU で収束判定して残った画素だけを1次元で起動する
+
+        // --resume で途中から再開するフレームは、残した累積を戻して続きのパスから回す
+        // 最初の起動はサンプル 0 で全画素を起動し、戻した平均を hdrImage に書くだけ
+        const bool resumed = uint32_t(frameIndex) == resumeFrame && !resumeState.empty();
+        uint32_t firstPass = 0;
+        if(resumed){
+            std::memcpy(pixelAccumData, resumeState.data(), resumeState.size());
+            firstPass = resumePasses;
+            resumeState.clear();
+        }
+        bool restoring = resumed;
+        bool firstLaunch = true;
+        bool interrupted = false;
+
+        uint32_t activeCount = width * height;
+        uint32_t passCount = 0;
+        uint32_t pass = firstPass;
+        while(pass < maxPasses(adaptive) && activeCount > 0){
+            if(!restoring && pass > firstPass && std::chrono::system_clock::now() >= deadline){
+                interrupted = true;
+                break;
+            }
+
+            const bool fullLaunch = pass == 0 || restoring;
+            scene.sampling = glm::uvec4(pass, restoring ? 0u : adaptive.samplesPerPass, fullLaunch ? 0u : 1u,
+                                        writeAovImages && !restoring ? 1u : 0u);
+            memcpy(uniformData, &scene, (size_t)bufferSize);
+
+            vk::MappedMemoryRange flushMemoryRange;
+            flushMemoryRange.setMemory(sceneBuffer.memory.get());
+            flushMemoryRange.setOffset(0);
+            flushMemoryRange.setSize(VK_WHOLE_SIZE);
+            device->flushMappedMemoryRanges({flushMemoryRange});
+
+            PROFILE_ZONE("adaptive pass");
+            cmdBuf->reset();
+            cmdBuf->begin(cmdBeginInfo);
+            gpuTimerBegin(cmdBuf.get());
+
+            if(firstLaunch){
+                // HDR 画像と AOV は General のまま。前フレームのトーンマップと読み戻しが終わるのを待つ
+                vk::Image storageImages[] = {hdrImage.get(), albedoImage.get(), normalImage.get(), depthImage.get(), idImage.get()};
+                vk::ImageMemoryBarrier toGeneral[std::size(storageImages)]{};
+                for(size_t i = 0; i < std::size(storageImages); i++){
+                    toGeneral[i].oldLayout  = firstRendered
+                                    ? vk::ImageLayout::eUndefined
+                                    : vk::ImageLayout::eGeneral;
+                    toGeneral[i].newLayout = vk::ImageLayout::eGeneral;
+                    toGeneral[i].srcAccessMask = firstRendered
+                                    ? vk::AccessFlags{}
+                                    : vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferRead;
+                    toGeneral[i].dstAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead;
+                    toGeneral[i].image = storageImages[i];
+                    toGeneral[i].subresourceRange = range;
+                }
+
+                vk::PipelineStageFlags srcStage =
+                    firstRendered ? vk::PipelineStageFlagBits::eTopOfPipe
+                                    : vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer;
+                vk::PipelineStageFlags dstStage = vk::PipelineStageFlagBits::eRayTracingShaderKHR;
+
+                cmdBuf->pipelineBarrier(
+                    srcStage, dstStage,
+                    {}, nullptr, nullptr, toGeneral);
+                firstLaunch = false;
+            }
+
+            cmdBuf->bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, pipeline.get());
+            cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR, pipelineLayout.get(), 0, {descSets[0].get()}, {});
+            gpuZoneBegin(cmdBuf.get(), "traceRays");
+            if(fullLaunch){
+                cmdBuf->traceRaysKHR(raygenRegion, missRegion, hitRegion, {}, width, height, 1);
+            }else{
+                cmdBuf->traceRaysKHR(raygenRegion, missRegion, hitRegion, {}, activeCount, 1, 1);
+            }
+            gpuZoneEnd(cmdBuf.get());
+
+            // 累積バッファを CPU で読むのと、次のパスの raygen が読むのを待つ
+            vk::MemoryBarrier passBarrier{};
+            passBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            passBarrier.dstAccessMask = vk::AccessFlagBits::eHostRead |
+                                        vk::AccessFlagBits::eShaderRead |
+                                        vk::AccessFlagBits::eShaderWrite;
+            cmdBuf->pipelineBarrier(
+                vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                vk::PipelineStageFlagBits::eHost | vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+                {}, passBarrier, nullptr, nullptr);
+
+            cmdBuf->end();
+            waitRes = submitAndWait();
+            if(collectStats){
+                PathStats stats;
+                std::memcpy(&stats, pathStatsData, sizeof(PathStats));
+                std::memset(pathStatsData, 0, sizeof(PathStats));
+                statPaths += stats.paths;
+                statSegments += stats.segments;
+                statRouletteKills += stats.rouletteKills;
+                statDeadKills += stats.deadKills;
+            }
+            if(restoring){
+                restoring = false;
+            }else{
+                passCount++;
+                pass++;
+            }
+
+            PROFILE_ZONE("convergence mask");
+            const auto* accum = static_cast<const PixelAccum*>(pixelAccumData);
+            activeCount = buildActivePixelList(accum, width, height, adaptive, activePixels);
+#ifndef NDEBUG
+            if(!validateActivePixelList(accum, width, height, adaptive, activePixels)){
+                std::cerr << "[adaptive] invalid active pixel list at pass " << pass << "\n";
+            }
+#endif
+            if(activeCount > 0){
+                std::memcpy(activePixelData, activePixels.data(), sizeof(uint32_t) * activeCount);
+            }
+        }
+        if(interrupted){
+            // 書き出しスレッドに渡す前に印を付ける
+            interruptedFrame = uint32_t(frameIndex);
+            if(useCheckpoint && resumablePartial){
+                PROFILE_ZONE("save partial frame");
+                const auto* accum = static_cast<const uint8_t*>(pixelAccumData);
+                interruptedState.assign(accum, accum + size_t(width) * height * sizeof(PixelAccum));
+                interruptedPasses = pass;
+            }
+        }
+
+        //----------------------------------------------------------------------------
+        // temporal + tonemap + readback
+        // HDR -> 8bit sRGB は compute で行い、読み戻すのは 8bit 画像だけ
+        // --temporal では先に前フレームの履歴を再投影して hdrImage に混ぜる (履歴は compute からしか触らない)
+
+        cmdBuf->reset();
         cmdBuf->begin(cmdBeginInfo);
+        gpuTimerBegin(cmdBuf.get());
+
+        if(temporal){
+            std::vector<vk::ImageMemoryBarrier> temporalBarriers;
+            for(vk::Image image : {hdrImage.get(), normalImage.get(), depthImage.get()}){
+                vk::ImageMemoryBarrier& b = temporalBarriers.emplace_back();
+                b.oldLayout = vk::ImageLayout::eGeneral;
+                b.newLayout = vk::ImageLayout::eGeneral;
+                b.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+                b.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+                b.image = image;
+                b.subresourceRange = range;
+            }
+            for(size_t i = 0; i < 2; i++){
+                for(vk::Image image : {historyColorImages[i].get(), historyGeometryImages[i].get()}){
+                    vk::ImageMemoryBarrier& b = temporalBarriers.emplace_back();
+                    b.oldLayout = firstRendered ? vk::ImageLayout::eUndefined : vk::ImageLayout::eGeneral;
+                    b.newLayout = vk::ImageLayout::eGeneral;
+                    b.srcAccessMask = firstRendered
+                                ? vk::AccessFlags{}
+                                : vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+                    b.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+                    b.image = image;
+                    b.subresourceRange = range;
+                }
+            }
+            cmdBuf->pipelineBarrier(
+                vk::PipelineStageFlagBits::eRayTracingShaderKHR | vk::PipelineStageFlagBits::eComputeShader,
+                vk::PipelineStageFlagBits::eComputeShader,
+                {}, nullptr, nullptr, temporalBarriers);
+
+            TemporalParams temporalParams{};
+            temporalParams.current = makeTemporalCamera(view, width, height);
+            temporalParams.previous = makeTemporalCamera(historyValid ? previousView : view, width, height);
+            temporalParams.historyValid = historyValid ? 1u : 0u;
+            gpuZoneBegin(cmdBuf.get(), "temporal");
+            recordTemporal(cmdBuf.get(), temporalParams, uint32_t(frameIndex) & 1u);
+            gpuZoneEnd(cmdBuf.get());
+        }
+        previousView = view;
 
-        vk::ImageSubresourceRange range{};
-        range.aspectMask = vk::ImageAspectFlagBits::eColor;
-        range.baseMipLevel = 0; range.levelCount  = 1;
-        range.baseArrayLayer = 0; range.layerCount = 1;
+        {
+            vk::ImageMemoryBarrier tonemapBarriers[6]{};
+            tonemapBarriers[0].oldLayout = vk::ImageLayout::eGeneral;
+            tonemapBarriers[0].newLayout = vk::ImageLayout::eGeneral;
+            tonemapBarriers[0].srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            tonemapBarriers[0].dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferRead;
+            tonemapBarriers[0].image = hdrImage.get();
+            tonemapBarriers[0].subresourceRange = range;
+
+            tonemapBarriers[1].oldLayout = firstRendered
+                                ? vk::ImageLayout::eUndefined
+                                : vk::ImageLayout::eTransferSrcOptimal;
+            tonemapBarriers[1].newLayout = vk::ImageLayout::eGeneral;
+            tonemapBarriers[1].srcAccessMask = firstRendered
+                                ? vk::AccessFlags{}
+                                : vk::AccessFlagBits::eTransferRead;
+            tonemapBarriers[1].dstAccessMask = vk::AccessFlagBits::eShaderWrite;
+            tonemapBarriers[1].image = outputImage.get();
+            tonemapBarriers[1].subresourceRange = range;
+
+            // AOV は読み戻すときだけ
+            vk::Image aovImages[] = {albedoImage.get(), normalImage.get(), depthImage.get(), idImage.get()};
+            for(size_t i = 0; i < std::size(aovImages); i++){
+                tonemapBarriers[2 + i] = tonemapBarriers[0];
+                tonemapBarriers[2 + i].dstAccessMask = vk::AccessFlagBits::eTransferRead;
+                tonemapBarriers[2 + i].image = aovImages[i];
+            }
 
-        vk::ImageMemoryBarrier toGeneral{};
-        toGeneral.oldLayout  = (frameIndex == 0)
-                        ? vk::ImageLayout::eUndefined
-                        : vk::ImageLayout::eTransferSrcOptimal;
-        toGeneral.newLayout = vk::ImageLayout::eGeneral;
-        toGeneral.srcAccessMask = (frameIndex == 0)
-                        ? vk::AccessFlags{}
-                        : vk::AccessFlagBits::eTransferRead;
-        toGeneral.dstAccessMask = vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eShaderRead;
-        toGeneral.image = outputImage.get();
-        toGeneral.subresourceRange = range;
-
-        vk::PipelineStageFlags srcStage =
-            (frameIndex == 0) ? vk::PipelineStageFlagBits::eTopOfPipe
-                            : vk::PipelineStageFlagBits::eTransfer;
-        vk::PipelineStageFlags dstStage = vk::PipelineStageFlagBits::eRayTracingShaderKHR;
+            // テンポラル累積が書いた hdrImage も待つ
+            cmdBuf->pipelineBarrier(
+                vk::PipelineStageFlagBits::eRayTracingShaderKHR | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+                vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+                {}, nullptr, nullptr, vk::ArrayProxy<const vk::ImageMemoryBarrier>(readbackAov ? 6u : 2u, tonemapBarriers));
+        }
+
+        gpuZoneBegin(cmdBuf.get(), "tonemap");
+        recordTonemap(cmdBuf.get(), tonemap);
+        gpuZoneEnd(cmdBuf.get());
 
-        cmdBuf->pipelineBarrier(
-            srcStage, dstStage,
-            {}, nullptr, nullptr, toGeneral);
-
-        vk::ClearValue clearVal[1];
-        clearVal[0].color.float32[0] = 0.0f;
-        clearVal[0].color.float32[1] = 0.0f;
-        clearVal[0].color.float32[2] = 0.0f;
-        clearVal[0].color.float32[3] = 1.0f;
-
-        cmdBuf->bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, pipeline.get());
-        cmdBuf->bindDescriptorSets(vk::PipelineBindPoint::eRayTracingKHR, pipelineLayout.get(), 0, {descSets[0].get()}, {});
-        cmdBuf->traceRaysKHR(
-            raygenRegion,
-            missRegion,
-            hitRegion,
-            {},
-            width, height, 1
-        );
-        
         vk::ImageMemoryBarrier toCopy{};
         toCopy.oldLayout = vk::ImageLayout::eGeneral;
         toCopy.newLayout = vk::ImageLayout::eTransferSrcOptimal;
@@ -157,7 +539,7 @@ void drawCall(std::filesystem::path exePath){
         toCopy.subresourceRange = range;
 
         cmdBuf->pipelineBarrier(
-            vk::PipelineStageFlagBits::eRayTracingShaderKHR,
+            vk::PipelineStageFlagBits::eComputeShader,
             vk::PipelineStageFlagBits::eTransfer,
             {}, nullptr, nullptr, toCopy);
 
@@ -172,51 +554,129 @@ void drawCall(std::filesystem::path exePath){
         copy.setImageOffset(vk::Offset3D{0, 0, 0});
         copy.setImageExtent({uint32_t(width), uint32_t{height}, 1});
 
+        gpuZoneBegin(cmdBuf.get(), "copyImageToBuffer");
         cmdBuf->copyImageToBuffer(
             outputImage.get(),
             vk::ImageLayout::eTransferSrcOptimal,
             outputBuffer.buffer.get(),
             { copy }
         );
+        gpuZoneEnd(cmdBuf.get());
+
+        // HDR 形式ではトーンマップ前の線形画像を読み戻す (General のままコピーできる)
+        if(readbackHdr){
+            gpuZoneBegin(cmdBuf.get(), "copyHdrToBuffer");
+            cmdBuf->copyImageToBuffer(hdrImage.get(), vk::ImageLayout::eGeneral, hdrBuffer.buffer.get(), { copy });
+            gpuZoneEnd(cmdBuf.get());
+        }
 
-        vk::BufferMemoryBarrier bufBarrier{};
-        bufBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-        bufBarrier.dstAccessMask = vk::AccessFlagBits::eHostRead;
-        bufBarrier.buffer = outputBuffer.buffer.get();
-        bufBarrier.offset = 0;
-        bufBarrier.size = VK_WHOLE_SIZE;
+        // AOV (--aov / --denoise)。すべて General のままコピーする
+        std::pair<vk::Image, Buffer*> aovCopies[] = {
+            {albedoImage.get(), &albedoBuffer},
+            {normalImage.get(), &normalBuffer},
+            {depthImage.get(),  &depthBuffer},
+            {idImage.get(),     &idBuffer},
+        };
+        if(readbackAov){
+            gpuZoneBegin(cmdBuf.get(), "copyAovToBuffer");
+            for(auto& [aovImage, aovBuffer] : aovCopies){
+                cmdBuf->copyImageToBuffer(aovImage, vk::ImageLayout::eGeneral, aovBuffer->buffer.get(), { copy });
+            }
+            gpuZoneEnd(cmdBuf.get());
+        }
+
+        std::vector<vk::Buffer> readbackBuffers{outputBuffer.buffer.get()};
+        if(readbackHdr) readbackBuffers.push_back(hdrBuffer.buffer.get());
+        if(readbackAov){
+            for(auto& [aovImage, aovBuffer] : aovCopies) readbackBuffers.push_back(aovBuffer->buffer.get());
+        }
+        std::vector<vk::BufferMemoryBarrier> bufBarriers(readbackBuffers.size());
+        for(size_t i = 0; i < bufBarriers.size(); i++){
+            bufBarriers[i].srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            bufBarriers[i].dstAccessMask = vk::AccessFlagBits::eHostRead;
+            bufBarriers[i].buffer = readbackBuffers[i];
+            bufBarriers[i].offset = 0;
+            bufBarriers[i].size = VK_WHOLE_SIZE;
+        }
 
         cmdBuf->pipelineBarrier(
             vk::PipelineStageFlagBits::eTransfer,
             vk::PipelineStageFlagBits::eHost,
-            {}, nullptr, bufBarrier, nullptr
+            {}, nullptr, bufBarriers, nullptr
         );
 
         cmdBuf->end();
+        waitRes = submitAndWait();
+        {
+            size_t size = size_t(width) * size_t(height) * 4;
+            OutputFrame frame{width, height};
+            void* mapped = device->mapMemory(outputBuffer.memory.get(), 0, size);
+            frame.ldr = {static_cast<const uint8_t*>(mapped), size};
+            if(readbackHdr){
+                void* hdrMapped = device->mapMemory(hdrBuffer.memory.get(), 0, size * sizeof(float));
+                frame.hdr = {static_cast<const float*>(hdrMapped), size};
+            }
+            if(readbackAov){
+                const size_t pixels = size_t(width) * height;
+                frame.albedo = {static_cast<const float*>(device->mapMemory(albedoBuffer.memory.get(), 0, VK_WHOLE_SIZE)), pixels * 4};
+                frame.normal = {static_cast<const float*>(device->mapMemory(normalBuffer.memory.get(), 0, VK_WHOLE_SIZE)), pixels * 4};
+                frame.depth = {static_cast<const float*>(device->mapMemory(depthBuffer.memory.get(), 0, VK_WHOLE_SIZE)), pixels};
+                frame.ids = {static_cast<const uint32_t*>(device->mapMemory(idBuffer.memory.get(), 0, VK_WHOLE_SIZE)), pixels * 2};
+            }
+            if(denoise){
+                // 平均の分散 = 標本分散 / サンプル数
+                PROFILE_ZONE("pixel variance");
+                const auto* accum = static_cast<const PixelAccum*>(pixelAccumData);
+                variance.resize(size_t(width) * height);
+                for(size_t i = 0; i < variance.size(); i++){
+                    uint32_t n = accum[i].count;
+                    variance[i] = n >= 2 ? accum[i].lumM2 / float(n - 1) / float(n) : 0.0f;
+                }
+                frame.variance = variance;
+            }
+            frameQueue.push(uint32_t(frameIndex), frame);
+            if(readbackAov){
+                for(auto& [aovImage, aovBuffer] : aovCopies) device->unmapMemory(aovBuffer->memory.get());
+            }
+            if(readbackHdr) device->unmapMemory(hdrBuffer.memory.get());
+            device->unmapMemory(outputBuffer.memory.get());
+        }
 
-        vk::CommandBuffer submitCmdBuf[1] = {cmdBuf.get()};
-        vk::SubmitInfo submitInfo{};
-        submitInfo.setCommandBufferCount(1);
-        submitInfo.setPCommandBuffers(submitCmdBuf);
-
-        vk::PipelineStageFlags renderwaitStages[] = {vk::PipelineStageFlagBits::eRayTracingShaderKHR};
-        submitInfo.setPWaitDstStageMask(renderwaitStages);
-        
-        queue.submit({submitInfo}, inFlight[0].get());
-
-        auto fenceToWait = inFlight[0].get();
-
-        waitRes = device->waitForFences(fenceToWait, VK_TRUE, UINT64_MAX);
-        size_t size = size_t(width) * size_t(height) * 4;
-        void* mapped = device->mapMemory(outputBuffer.memory.get(), 0, size);
-        char filename[256];
-        std::snprintf(filename, sizeof(filename), "%03u.png", frameIndex);
-        stbi_write_png(filename, width, height, 4, mapped, int(width * 4));
-        device->unmapMemory(outputBuffer.memory.get());
+        if (collectStats && statPaths > 0) {
+            std::printf("frame %03d: %u passes, avg spp %.1f, avg path length %.2f (roulette %.1f%%, dead %.1f%%)\n",
+                frameIndex, passCount,
+                double(statPaths) / double(size_t(width) * height),
+                double(statSegments) / double(statPaths),
+                100.0 * double(statRouletteKills) / double(statPaths),
+                100.0 * double(statDeadKills) / double(statPaths));
+        }
 
+        lastRendered = frameIndex;
         frameIndex++;
         currentFrame = (currentFrame + 1) % MAX_FRAMES;
     }
     queue.waitIdle();
+    if(shaderWatcher) shaderWatcher->stop();
+    profiler.frame = kNoFrame;
+    {
+        PROFILE_ZONE("flush frames");
+        frameQueue.finish();
+    }
+    if(!interruptedState.empty()){
+        checkpoint.partialFrame = interruptedFrame.load();
+        checkpoint.partialPasses = interruptedPasses;
+        checkpoint.partialState = std::move(interruptedState);
+        if(writeCheckpoint(checkpointPath, checkpoint)){
+            std::cout << "checkpoint: frame " << checkpoint.partialFrame << " stopped at pass " << checkpoint.partialPasses
+                      << " (--resume to continue)" << std::endl;
+        }else{
+            std::cerr << "failed to write " << checkpointPath.string() << "\n";
+        }
+    }
+    if(options.videoSink != VideoSink::None){
+        uint32_t videoFrames = video.frameCount;
+        if(!video.close()) std::cerr << "video encoder failed\n";
+        else std::cout << "video: " << videoFrames << " frames" << std::endl;
+    }
     return;
 }
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "../include/sampler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace {
+
+// Joe & Kuo の方向数 (new-joe-kuo-6.21201)。0次元目は van der Corput
+struct SobolPolynomial {
+    uint32_t s;
+    uint32_t a;
+    uint32_t m[3];
+};
+
+constexpr SobolPolynomial kJoeKuo[] = {
+    {1, 0, {1, 0, 0}},
+};
+
+uint32_t reverseBits(uint32_t x){
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Burley 2020, "Practical Hash-based Owen Scrambling"
+uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed){
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+float toUnitFloat(uint32_t x){
+    return float(x >> 8) * (1.0f / 16777216.0f);
+}
+
+}
+
+std::vector<uint32_t> buildSobolMatrices(uint32_t dimensions){
+    std::vector<uint32_t> matrices(size_t(dimensions) * kSobolBits);
+    for(uint32_t dim = 0; dim < dimensions; dim++){
+        uint32_t* v = &matrices[size_t(dim) * kSobolBits];
+        if(dim == 0){
+            for(uint32_t k = 0; k < kSobolBits; k++) v[k] = 1u << (31 - k);
+            continue;
+        }
+
+        const SobolPolynomial& p = kJoeKuo[dim - 1];
+        for(uint32_t k = 0; k < kSobolBits; k++){
+            if(k < p.s){
+                v[k] = p.m[k] << (31 - k);
+                continue;
+            }
+            v[k] = v[k - p.s] ^ (v[k - p.s] >> p.s);
+            for(uint32_t j = 1; j < p.s; j++){
+                if((p.a >> (p.s - 1 - j)) & 1u) v[k] ^= v[k - j];
+            }
+        }
+    }
+    return matrices;
+}
+
+uint32_t hashWang(uint32_t key){
+    key = (key ^ 61u) ^ (key >> 16u);
+    key = key + (key << 3u);
+    key = key ^ (key >> 4u);
+    key = key * 0x27D4EB2Du;
+    key = key ^ (key >> 15u);
+    return key;
+}
+
+uint32_t pcg(uint32_t& state){
+    uint32_t prev = state * 747796405u + 2891336453u;
+    uint32_t word = ((prev >> ((prev >> 28u) + 4u)) ^ prev) * 277803737u;
+    state = prev;
+    return (word >> 22u) ^ word;
+}
+
+float randFloat(uint32_t& state){
+    uint32_t val = pcg(state);
+    return float(val) * (1.0f / float(0xffffffffu));
+}
+
+uint32_t sobol(const std::vector<uint32_t>& matrices, uint32_t index, uint32_t dim){
+    const uint32_t* v = &matrices[size_t(dim) * kSobolBits];
+    uint32_t x = 0;
+    for(uint32_t bit = 0; index != 0; bit++, index >>= 1){
+        if(index & 1u) x ^= v[bit];
+    }
+    return x;
+}
+
+uint32_t nestedUniformScramble(uint32_t x, uint32_t seed){
+    x = reverseBits(x);
+    x = laineKarrasPermutation(x, seed);
+    return reverseBits(x);
+}
+
+uint32_t hashCombine(uint32_t seed, uint32_t v){
+    return seed ^ (hashWang(v) + (seed << 6) + (seed >> 2));
+}
+
+std::array<float, 3> sampleGGX(float roughness, float u, float v){
+    constexpr float kPi = 3.14159265358979f;
+    // util.slang と同じ下限 (pdf 側と揃える)
+    float alpha = std::max(roughness * roughness, 1e-3f);
+    float theta = std::atan(alpha * std::sqrt(v) / std::sqrt(1.0f - v));
+    float phi = 2.0f * kPi * u;
+    return { std::sin(phi) * std::sin(theta), std::cos(phi) * std::sin(theta), std::cos(theta) };
+}
+
+float SobolSampler::next1D(){
+    uint32_t s = hashCombine(seed, dimension++);
+    uint32_t i = nestedUniformScramble(index, s);
+    return toUnitFloat(nestedUniformScramble(sobol(*matrices, i, 0), hashCombine(s, 0)));
+}
+
+void SobolSampler::next2D(float& u, float& v){
+    uint32_t s = hashCombine(seed, dimension++);
+    uint32_t i = nestedUniformScramble(index, s);
+    u = toUnitFloat(nestedUniformScramble(sobol(*matrices, i, 0), hashCombine(s, 0)));
+    v = toUnitFloat(nestedUniformScramble(sobol(*matrices, i, 1), hashCombine(s, 1)));
+}
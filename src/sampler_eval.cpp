@@ -0,0 +1,139 @@
+// pcg のホワイトノイズと Owen scramble Sobol の比較
+// 2次元のL2スター discrepancy と、解析解のある被積分関数の RMSE を spp ごとに出す
+#include "../include/sampler.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+constexpr double kPi = 3.141592653589793;
+
+struct Point2 { double x, y; };
+
+// Warnock の式 O(N^2)
+double l2StarDiscrepancy(const std::vector<Point2>& pts)
+{
+    const double n = double(pts.size());
+    double sum1 = 0.0;
+    for (const auto& p : pts) {
+        sum1 += (1.0 - p.x * p.x) * (1.0 - p.y * p.y);
+    }
+    double sum2 = 0.0;
+    for (const auto& a : pts) {
+        for (const auto& b : pts) {
+            sum2 += (1.0 - std::max(a.x, b.x)) * (1.0 - std::max(a.y, b.y));
+        }
+    }
+    double d2 = 1.0 / 9.0 - sum1 / (2.0 * n) + sum2 / (n * n);
+    return std::sqrt(std::max(d2, 0.0));
+}
+
+// 旧 raygen と同じく画素ごとに Hash_Wang で初期化した pcg を順に引く
+std::vector<Point2> pcgPoints(uint32_t pixel, uint32_t count)
+{
+    uint32_t state = hashWang(pixel);
+    std::vector<Point2> pts(count);
+    for (auto& p : pts) {
+        p.x = randFloat(state);
+        p.y = randFloat(state);
+    }
+    return pts;
+}
+
+std::vector<Point2> sobolPoints(const std::vector<uint32_t>& matrices, uint32_t pixel, uint32_t count)
+{
+    std::vector<Point2> pts(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        SobolSampler s{&matrices, i, hashWang(pixel)};
+        float u, v;
+        s.next2D(u, v);
+        pts[i] = {u, v};
+    }
+    return pts;
+}
+
+struct Integrand {
+    const char* name;
+    std::function<double(double, double)> f;
+    double reference;
+};
+
+int main(int argc, char** argv)
+{
+    uint32_t pixelCount = 256;
+    if (argc > 1) pixelCount = uint32_t(std::atoi(argv[1]));
+
+    const auto matrices = buildSobolMatrices(kSobolDimensions);
+
+    const double sigma = 0.1;
+    const double g1d = std::sqrt(2.0 * kPi) * sigma * std::erf(0.5 / (sigma * std::sqrt(2.0)));
+    const std::vector<Integrand> integrands = {
+        // エッジ (不連続) の代わり
+        {"disk", [](double x, double y) { return (x * x + y * y < 1.0) ? 1.0 : 0.0; }, kPi / 4.0},
+        // 滑らかなハイライトの代わり
+        {"gaussian", [sigma](double x, double y) {
+            double dx = x - 0.5, dy = y - 0.5;
+            return std::exp(-(dx * dx + dy * dy) / (2.0 * sigma * sigma));
+        }, g1d * g1d},
+    };
+
+    const uint32_t sppList[] = {1, 2, 4, 8, 16, 32, 64, 128, 225, 256};
+
+    std::printf("pixels: %u\n\n", pixelCount);
+    std::printf("%6s %14s %14s", "spp", "L2*disc pcg", "L2*disc sobol");
+    for (const auto& it : integrands) {
+        std::printf(" %9s pcg %9s sob", it.name, it.name);
+    }
+    std::printf("\n");
+
+    std::vector<std::vector<double>> rmsePcg(integrands.size()), rmseSobol(integrands.size());
+
+    for (uint32_t spp : sppList) {
+        double discPcg = 0.0, discSobol = 0.0;
+        std::vector<double> errPcg(integrands.size(), 0.0), errSobol(integrands.size(), 0.0);
+
+        for (uint32_t pixel = 0; pixel < pixelCount; ++pixel) {
+            auto a = pcgPoints(pixel, spp);
+            auto b = sobolPoints(matrices, pixel, spp);
+            discPcg += l2StarDiscrepancy(a);
+            discSobol += l2StarDiscrepancy(b);
+
+            for (size_t k = 0; k < integrands.size(); ++k) {
+                double ea = 0.0, eb = 0.0;
+                for (uint32_t i = 0; i < spp; ++i) {
+                    ea += integrands[k].f(a[i].x, a[i].y);
+                    eb += integrands[k].f(b[i].x, b[i].y);
+                }
+                ea = ea / spp - integrands[k].reference;
+                eb = eb / spp - integrands[k].reference;
+                errPcg[k] += ea * ea;
+                errSobol[k] += eb * eb;
+            }
+        }
+
+        std::printf("%6u %14.6f %14.6f", spp, discPcg / pixelCount, discSobol / pixelCount);
+        for (size_t k = 0; k < integrands.size(); ++k) {
+            double rp = std::sqrt(errPcg[k] / pixelCount);
+            double rs = std::sqrt(errSobol[k] / pixelCount);
+            rmsePcg[k].push_back(rp);
+            rmseSobol[k].push_back(rs);
+            std::printf(" %14.6f %14.6f", rp, rs);
+        }
+        std::printf("\n");
+    }
+
+    // pcg 225spp と同じノイズになる Sobol の spp
+    std::printf("\n");
+    const size_t ref = 8; // 225spp
+    for (size_t k = 0; k < integrands.size(); ++k) {
+        uint32_t equal = 0;
+        for (size_t i = 0; i < std::size(sppList); ++i) {
+            if (rmseSobol[k][i] <= rmsePcg[k][ref]) { equal = sppList[i]; break; }
+        }
+        std::printf("%-10s sobol spp at pcg 225spp noise: %u\n", integrands[k].name, equal);
+    }
+    return 0;
+}
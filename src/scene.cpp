@@ -0,0 +1,218 @@
+#include "../include/scene.hpp"
+#include "../include/scene_decode.hpp"
+#include "../include/gltf_source.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/mipmap.hpp"
+#include "../include/scene_cache.hpp"
+#include "../include/texture_compress.hpp"
+#include "../include/envmap.hpp"
+#include "../include/profiler.hpp"
+
+#include <stb_image.h>
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+SceneView makeSceneView(const SceneAssets& assets){
+    SceneView view;
+    view.vertices = assets.vertices;
+    view.indices = assets.indices;
+    view.primitiveMaterialIndices = assets.primitiveMaterialIndices;
+    view.materials = assets.materials;
+    for(const auto& tex : assets.textures){
+        view.textures.push_back({tex.width, tex.height, tex.mipLevels, tex.format, tex.srgb, tex.pixels});
+    }
+    view.envFaceSize = assets.envMap.faceSize;
+    view.envFaces = assets.envMap.faces;
+    view.cameraKeys = assets.cameraKeys;
+    return view;
+}
+
+namespace {
+
+bool decodeTexture(std::span<const uint8_t> bytes, TextureData& tex){
+    int width = 0, height = 0, comp = 0;
+    stbi_uc* loaded = stbi_load_from_memory(bytes.data(), int(bytes.size()), &width, &height, &comp, STBI_rgb_alpha);
+    if(loaded == nullptr) return false;
+    tex.width = uint32_t(width);
+    tex.height = uint32_t(height);
+    tex.pixels.assign(loaded, loaded + size_t(width) * height * 4);
+    stbi_image_free(loaded);
+    return true;
+}
+
+bool loadTextureFile(const std::filesystem::path& path, TextureData& tex){
+    MappedFile file;
+    if(!file.open(path) || !decodeTexture(file.bytes(), tex)){
+        std::cerr << "画像ファイルの読み込みに失敗しました: " << path.string() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::filesystem::path imageFilePath(const std::filesystem::path& textureDir, const GltfImage& img){
+    return textureDir / std::filesystem::path(std::u8string(img.uri.begin(), img.uri.end()));
+}
+
+bool loadEnvMap(const std::filesystem::path& envMapPath, EnvMapData& envMap){
+    PROFILE_ZONE("loadEnvMap");
+    MappedFile file;
+    int envWidth, envHeight, envCh;
+    float* pEnvData = nullptr;
+    if(file.open(envMapPath)){
+        pEnvData = stbi_loadf_from_memory(file.data, int(file.size), &envWidth, &envHeight, &envCh, STBI_rgb_alpha);
+    }
+    if(pEnvData == nullptr) {
+        std::cerr << "画像ファイルの読み込みに失敗しました: " << envMapPath.string() << std::endl;
+        return false;
+    }
+
+    std::cout << "before convert hdr to cubemap" << std::endl;
+    envMap.faceSize = kEnvFaceSize;
+    convertEquirectToCubemap(pEnvData, envWidth, envHeight, envMap.faceSize, envMap.faces);
+    stbi_image_free(pEnvData);
+    return true;
+}
+
+}
+
+bool loadTextures(
+    const GltfSource& gltf, const std::filesystem::path& textureDir, const std::vector<Material>& materials,
+    std::vector<TextureData>& textures, std::vector<std::string>& sourceFiles)
+{
+    PROFILE_ZONE("loadTexture");
+    textures.clear();
+
+    // テクスチャが無いモデルでもディスクリプタを埋めるためのダミー
+    if(gltf.images.size() == 0){
+        TextureData tex;
+        std::filesystem::path texPath = textureDir / "dummy.jpg";
+        if(loadTextureFile(texPath, tex)){
+            sourceFiles.push_back(texPath.string());
+        }else{
+            tex.width = tex.height = 1;
+            tex.pixels = {255, 255, 255, 255};
+        }
+        textures.push_back(std::move(tex));
+    }
+
+    for(const auto& img : gltf.images){
+        TextureData tex;
+        if(!img.uri.empty()){
+            std::filesystem::path texPath = imageFilePath(textureDir, img);
+            if(!loadTextureFile(texPath, tex)) return false;
+            sourceFiles.push_back(texPath.string());
+        }else if(!decodeTexture(img.bytes, tex)){
+            std::cerr << "埋め込み画像のデコードに失敗しました (" << img.mimeType << ")" << std::endl;
+            return false;
+        }
+        textures.push_back(std::move(tex));
+    }
+
+    // baseColor / emissive は sRGB で格納されているので線形空間で縮小する
+    generateMips(textures, srgbTextureFlags(materials, textures.size()));
+    return true;
+}
+
+std::filesystem::path textureContainerPath(const std::filesystem::path& scenePath){
+    std::filesystem::path path = scenePath;
+    path.replace_extension(".mtex");
+    return path;
+}
+
+bool textureSourceHash(
+    const GltfSource& gltf, const std::filesystem::path& textureDir, const std::vector<Material>& materials,
+    uint64_t& hash, std::vector<std::string>& sourceFiles)
+{
+    PROFILE_ZONE("textureSourceHash");
+    // 画像の中身と、マテリアルからの参照 (圧縮形式と sRGB の判定に使う) を混ぜる
+    hash = 14695981039346656037ull;
+    auto mix = [&](uint64_t v){ hash = (hash ^ v) * 1099511628211ull; };
+    for(const auto& img : gltf.images){
+        if(img.uri.empty()){
+            mix(hashBytes(img.bytes));
+            continue;
+        }
+        std::filesystem::path texPath = imageFilePath(textureDir, img);
+        MappedFile file;
+        if(!file.open(texPath)) return false;
+        mix(hashBytes(file.bytes()));
+        sourceFiles.push_back(texPath.string());
+    }
+    for(const auto& m : materials){
+        for(int index : {m.baseColorTextureIndex, m.matallicRoughnessTextureIndex, m.normalTextureIndex,
+                         m.occulusionTextureIndex, m.emissiveTextureIndex}){
+            mix(uint64_t(int64_t(index)));
+        }
+    }
+    return true;
+}
+
+std::filesystem::path findSceneFile(const std::filesystem::path& resourceDir){
+    std::filesystem::path glb = resourceDir / "mesh" / "test.glb";
+    if(std::filesystem::exists(glb)) return glb;
+    return resourceDir / "mesh" / "test.gltf";
+}
+
+bool loadScene(const std::filesystem::path& resourceDir, SceneAssets& assets){
+    PROFILE_ZONE("loadScene");
+    std::filesystem::path scenePath = findSceneFile(resourceDir);
+    std::filesystem::path textureDir = resourceDir / "texture";
+    std::filesystem::path envMapPath = resourceDir / "envmap" / "env.hdr";
+
+    GltfSource gltf;
+    {
+        PROFILE_ZONE("loadModel");
+        std::string err;
+        if(!openGltf(scenePath, gltf, err)){
+            std::cerr << "[gltf err] " << err << "\n";
+            std::cerr << "Failed to load: " << scenePath.string() << "\n";
+            std::cerr << "Working dir: " << std::filesystem::current_path().string() << "\n";
+            return false;
+        }
+
+        assets.sourceFiles.clear();
+        assets.probedFiles = {(resourceDir / "mesh" / "test.glb").string(), textureContainerPath(scenePath).string()};
+        for(const auto& src : gltf.sourceFiles){
+            assets.sourceFiles.push_back(src.string());
+        }
+
+        assets.vertices.clear();
+        assets.indices.clear();
+        assets.primitiveMaterialIndices.clear();
+        if(!decodeGeometry(gltf.model, gltf.buffers, assets.vertices, assets.indices, assets.primitiveMaterialIndices)){
+            std::cerr << "Unsupported or out-of-range index/attribute data in: " << scenePath.string() << "\n";
+            return false;
+        }
+        if(!decodeCameraKeys(gltf.model, gltf.buffers, assets.cameraKeys)){
+            std::cerr << "Unsupported or out-of-range camera animation in: " << scenePath.string() << "\n";
+            return false;
+        }
+    }
+    {
+        PROFILE_ZONE("loadMaterial");
+        assets.materials = translateMaterials(gltf.model);
+    }
+    // compress_textures で作った圧縮済みテクスチャがあり、入力と一致すればそれを使う
+    bool compressed = false;
+    std::filesystem::path containerPath = textureContainerPath(scenePath);
+    if(!gltf.images.empty() && std::filesystem::exists(containerPath)){
+        std::vector<std::string> imageFiles;
+        uint64_t hash = 0;
+        if(textureSourceHash(gltf, textureDir, assets.materials, hash, imageFiles) &&
+           readTextureContainer(containerPath, hash, assets.textures)){
+            compressed = true;
+            assets.sourceFiles.insert(assets.sourceFiles.end(), imageFiles.begin(), imageFiles.end());
+            assets.sourceFiles.push_back(containerPath.string());
+        }
+    }
+    if(!compressed && !loadTextures(gltf, textureDir, assets.materials, assets.textures, assets.sourceFiles)) return false;
+    {
+        std::vector<bool> srgb = srgbTextureFlags(assets.materials, assets.textures.size());
+        for(size_t i = 0; i < assets.textures.size(); i++) assets.textures[i].srgb = srgb[i];
+    }
+    if(!loadEnvMap(envMapPath, assets.envMap)) return false;
+    assets.sourceFiles.push_back(envMapPath.string());
+    return true;
+}
@@ -0,0 +1,275 @@
+#include "../include/scene_cache.hpp"
+#include "../include/mipmap.hpp"
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr char kCacheMagic[8] = {'M', 'A', 'P', 'L', 'E', 'S', 'C', 'N'};
+
+// 各セクションの先頭はこの境界に揃える (Vertex/Material を mmap 上でそのまま参照するため)
+constexpr uint64_t kSectionAlignment = 64;
+
+enum CacheSection : uint32_t {
+    kSectionInputs,
+    kSectionStrings,
+    kSectionVertices,
+    kSectionIndices,
+    kSectionPrimitiveMaterials,
+    kSectionMaterials,
+    kSectionTextures,
+    kSectionTexturePixels,
+    kSectionEnvFaces,
+    kSectionCameraKeys,
+    kSectionCount
+};
+
+struct CacheRange {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t vertexStride;
+    uint32_t materialStride;
+    uint32_t cameraKeyStride;
+    uint32_t envFaceSize;
+    uint64_t fileSize;
+    CacheRange sections[kSectionCount];
+};
+
+struct CacheInput {
+    uint64_t size;
+    int64_t mtime;
+    uint64_t hash;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t present;   // probedFiles は書き出し時に無かったら 0 (size/mtime/hash も 0)
+    uint32_t pad;
+};
+
+struct CacheTexture {
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    TextureFormat format;
+    uint32_t srgb;
+    uint32_t pad;
+    uint64_t offset;    // kSectionTexturePixels 内のオフセット
+    uint64_t size;      // 全ミップの合計
+};
+
+uint64_t alignUp64(uint64_t v, uint64_t a){
+    return (v + a - 1) / a * a;
+}
+
+int64_t fileMtime(const std::filesystem::path& path, std::error_code& ec){
+    return int64_t(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+}
+
+bool hashFile(const std::filesystem::path& path, uint64_t& hash){
+    MappedFile file;
+    if(!file.open(path)) return false;
+    hash = hashBytes(file.bytes());
+    return true;
+}
+
+template<typename T>
+std::span<const T> sectionSpan(const MappedFile& file, const CacheRange& range){
+    return {reinterpret_cast<const T*>(file.data + range.offset), size_t(range.size / sizeof(T))};
+}
+
+}
+
+uint64_t hashBytes(std::span<const uint8_t> bytes){
+    uint64_t h = 14695981039346656037ull;
+    for(uint8_t b : bytes){
+        h ^= b;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool writeSceneCache(const std::filesystem::path& path, const SceneAssets& assets){
+    PROFILE_ZONE("writeSceneCache");
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    std::vector<CacheInput> inputs;
+    std::string strings;
+    auto addInput = [&](const std::string& src, bool probed){
+        CacheInput in{};
+        in.present = 1;
+        if(probed && !std::filesystem::exists(src, ec)){
+            in.present = 0;
+        }else{
+            in.size = std::filesystem::file_size(src, ec);
+            if(ec) return false;
+            in.mtime = fileMtime(src, ec);
+            if(ec || !hashFile(src, in.hash)) return false;
+        }
+        in.pathOffset = uint32_t(strings.size());
+        in.pathLength = uint32_t(src.size());
+        strings += src;
+        inputs.push_back(in);
+        return true;
+    };
+    for(const auto& src : assets.sourceFiles){
+        if(!addInput(src, false)) return false;
+    }
+    for(const auto& src : assets.probedFiles){
+        if(!addInput(src, true)) return false;
+    }
+
+    std::vector<CacheTexture> textures;
+    uint64_t pixelBytes = 0;
+    for(const auto& tex : assets.textures){
+        pixelBytes = alignUp64(pixelBytes, kSectionAlignment);
+        textures.push_back({tex.width, tex.height, tex.mipLevels, tex.format, tex.srgb ? 1u : 0u, 0, pixelBytes, tex.pixels.size()});
+        pixelBytes += tex.pixels.size();
+    }
+
+    CacheHeader header{};
+    std::memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kSceneCacheVersion;
+    header.vertexStride = sizeof(Vertex);
+    header.materialStride = sizeof(Material);
+    header.cameraKeyStride = sizeof(CameraKey);
+    header.envFaceSize = assets.envMap.faceSize;
+
+    const uint64_t sizes[kSectionCount] = {
+        inputs.size() * sizeof(CacheInput),
+        strings.size(),
+        assets.vertices.size() * sizeof(Vertex),
+        assets.indices.size() * sizeof(uint32_t),
+        assets.primitiveMaterialIndices.size() * sizeof(uint32_t),
+        assets.materials.size() * sizeof(Material),
+        textures.size() * sizeof(CacheTexture),
+        pixelBytes,
+        assets.envMap.faces.size() * sizeof(float),
+        assets.cameraKeys.size() * sizeof(CameraKey),
+    };
+    uint64_t offset = alignUp64(sizeof(CacheHeader), kSectionAlignment);
+    for(uint32_t i = 0; i < kSectionCount; i++){
+        header.sections[i] = {offset, sizes[i]};
+        offset = alignUp64(offset + sizes[i], kSectionAlignment);
+    }
+    header.fileSize = offset;
+
+    // 書きかけのファイルを読まないように一時ファイルに書いてから置き換える
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!ofs) return false;
+
+        uint64_t written = 0;
+        auto writeAt = [&](uint64_t at, const void* data, uint64_t size){
+            static const char zeros[kSectionAlignment] = {};
+            while(written < at){
+                uint64_t n = std::min<uint64_t>(at - written, kSectionAlignment);
+                ofs.write(zeros, std::streamsize(n));
+                written += n;
+            }
+            if(size) ofs.write(static_cast<const char*>(data), std::streamsize(size));
+            written += size;
+        };
+
+        writeAt(0, &header, sizeof(header));
+        writeAt(header.sections[kSectionInputs].offset, inputs.data(), sizes[kSectionInputs]);
+        writeAt(header.sections[kSectionStrings].offset, strings.data(), sizes[kSectionStrings]);
+        writeAt(header.sections[kSectionVertices].offset, assets.vertices.data(), sizes[kSectionVertices]);
+        writeAt(header.sections[kSectionIndices].offset, assets.indices.data(), sizes[kSectionIndices]);
+        writeAt(header.sections[kSectionPrimitiveMaterials].offset, assets.primitiveMaterialIndices.data(), sizes[kSectionPrimitiveMaterials]);
+        writeAt(header.sections[kSectionMaterials].offset, assets.materials.data(), sizes[kSectionMaterials]);
+        writeAt(header.sections[kSectionTextures].offset, textures.data(), sizes[kSectionTextures]);
+        for(size_t i = 0; i < textures.size(); i++){
+            writeAt(header.sections[kSectionTexturePixels].offset + textures[i].offset,
+                    assets.textures[i].pixels.data(), textures[i].size);
+        }
+        writeAt(header.sections[kSectionEnvFaces].offset, assets.envMap.faces.data(), sizes[kSectionEnvFaces]);
+        writeAt(header.sections[kSectionCameraKeys].offset, assets.cameraKeys.data(), sizes[kSectionCameraKeys]);
+        writeAt(header.fileSize, nullptr, 0);
+        if(!ofs) return false;
+    }
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+bool SceneCache::open(const std::filesystem::path& path){
+    PROFILE_ZONE("openSceneCache");
+    view = {};
+    if(!file.open(path)) return false;
+
+    CacheHeader header{};
+    auto reject = [&](const char* reason){
+        std::cout << "scene cache rejected (" << reason << "): " << path.string() << std::endl;
+        file.close();
+        return false;
+    };
+
+    if(file.size < sizeof(CacheHeader)) return reject("truncated");
+    std::memcpy(&header, file.data, sizeof(header));
+    if(std::memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic)) != 0) return reject("bad magic");
+    if(header.version != kSceneCacheVersion) return reject("version");
+    if(header.vertexStride != sizeof(Vertex) || header.materialStride != sizeof(Material) ||
+       header.cameraKeyStride != sizeof(CameraKey)) return reject("layout");
+    if(header.fileSize != file.size) return reject("size");
+    for(const auto& range : header.sections){
+        if(range.offset % kSectionAlignment != 0 || range.offset > file.size || range.size > file.size - range.offset){
+            return reject("section bounds");
+        }
+    }
+
+    // 入力ファイルの照合: 有無かサイズが違えば無効、mtime が同じなら有効、違えば内容ハッシュで判定
+    auto inputs = sectionSpan<CacheInput>(file, header.sections[kSectionInputs]);
+    auto strings = sectionSpan<char>(file, header.sections[kSectionStrings]);
+    for(const auto& in : inputs){
+        if(uint64_t(in.pathOffset) + in.pathLength > strings.size()) return reject("input table");
+        std::string src(strings.data() + in.pathOffset, in.pathLength);
+
+        std::error_code ec;
+        if(std::filesystem::exists(src, ec) != (in.present != 0)) return reject("input added or removed");
+        if(!in.present) continue;
+        uint64_t size = std::filesystem::file_size(src, ec);
+        if(ec || size != in.size) return reject("input changed");
+        int64_t mtime = fileMtime(src, ec);
+        if(ec) return reject("input changed");
+        if(mtime != in.mtime){
+            uint64_t hash = 0;
+            if(!hashFile(src, hash) || hash != in.hash) return reject("input changed");
+        }
+    }
+
+    view.vertices = sectionSpan<Vertex>(file, header.sections[kSectionVertices]);
+    view.indices = sectionSpan<uint32_t>(file, header.sections[kSectionIndices]);
+    view.primitiveMaterialIndices = sectionSpan<uint32_t>(file, header.sections[kSectionPrimitiveMaterials]);
+    view.materials = sectionSpan<Material>(file, header.sections[kSectionMaterials]);
+
+    auto pixels = sectionSpan<uint8_t>(file, header.sections[kSectionTexturePixels]);
+    for(const auto& tex : sectionSpan<CacheTexture>(file, header.sections[kSectionTextures])){
+        if(tex.offset > pixels.size() || tex.size > pixels.size() - tex.offset ||
+           tex.format > TextureFormat::BC7 ||
+           tex.mipLevels == 0 || tex.mipLevels > mipLevelCount(tex.width, tex.height) ||
+           tex.size != mipLevelOffset(tex.width, tex.height, tex.mipLevels, tex.format)){
+            view = {};
+            return reject("texture table");
+        }
+        view.textures.push_back({tex.width, tex.height, tex.mipLevels, tex.format, tex.srgb != 0, pixels.subspan(tex.offset, tex.size)});
+    }
+
+    view.envFaceSize = header.envFaceSize;
+    view.envFaces = sectionSpan<float>(file, header.sections[kSectionEnvFaces]);
+    if(view.envFaces.size() != 6ull * view.envFaceSize * view.envFaceSize * 4){
+        view = {};
+        return reject("env map");
+    }
+    view.cameraKeys = sectionSpan<CameraKey>(file, header.sections[kSectionCameraKeys]);
+    return true;
+}
@@ -0,0 +1,479 @@
+#include "../include/scene_decode.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <string>
+
+namespace {
+
+size_t getByteStride(const tinygltf::BufferView* bufferView, size_t defaultSize){
+    if(bufferView->byteStride > 0){
+        return bufferView->byteStride;
+    }
+    return defaultSize;
+}
+
+// アクセサが参照する範囲がバッファに収まっているか
+bool accessorInBounds(
+    std::span<const std::span<const uint8_t>> buffers,
+    const tinygltf::Accessor& accessor, const tinygltf::BufferView& view, size_t elementSize)
+{
+    if(view.buffer < 0 || size_t(view.buffer) >= buffers.size()) return false;
+    if(accessor.count == 0) return true;
+    size_t stride = getByteStride(&view, elementSize);
+    size_t last = view.byteOffset + accessor.byteOffset + (accessor.count - 1) * stride + elementSize;
+    return last <= buffers[view.buffer].size();
+}
+
+// 頂点属性のアクセサを引く。無ければ accessor / view は nullptr のまま true
+// FLOAT の type 以外 (正規化・量子化された属性)、sparse、範囲外は読めないので false
+bool findAttribute(
+    const tinygltf::Model& model,
+    std::span<const std::span<const uint8_t>> buffers,
+    const std::map<std::string, int>& attributes,
+    const char* name, int type, size_t elementSize, size_t minCount,
+    const tinygltf::Accessor*& accessor, const tinygltf::BufferView*& view)
+{
+    accessor = nullptr;
+    view = nullptr;
+    auto it = attributes.find(name);
+    if(it == attributes.end()) return true;
+    if(it->second < 0 || size_t(it->second) >= model.accessors.size()) return false;
+    const tinygltf::Accessor& a = model.accessors[it->second];
+    if(a.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT || a.type != type || a.count < minCount) return false;
+    if(a.bufferView < 0 || size_t(a.bufferView) >= model.bufferViews.size()) return false;
+    const tinygltf::BufferView& v = model.bufferViews[a.bufferView];
+    if(!accessorInBounds(buffers, a, v, elementSize)) return false;
+    accessor = &a;
+    view = &v;
+    return true;
+}
+
+// glTF のテクスチャ番号を画像番号 (loadTextures / シェーダの textures[] の並び) に変える
+// 画像は openGltf が tinygltf に読ませず外に出すので、model.images とは突き合わせない
+int imageIndex(const tinygltf::Model& model, int textureIndex){
+    if(textureIndex < 0 || size_t(textureIndex) >= model.textures.size()) return -1;
+    return std::max(model.textures[textureIndex].source, -1);
+}
+
+template<typename T>
+void appendIndices(const unsigned char* src, size_t count, uint32_t vertexOffset, std::vector<uint32_t>& indices){
+    for(size_t i = 0; i < count; i++){
+        T value;
+        std::memcpy(&value, src + i * sizeof(T), sizeof(T));
+        indices.push_back(uint32_t(value) + vertexOffset);
+    }
+}
+
+}
+
+bool decodeGeometry(
+    const tinygltf::Model& model,
+    std::span<const std::span<const uint8_t>> buffers,
+    std::vector<Vertex>& vertices,
+    std::vector<uint32_t>& indices,
+    std::vector<uint32_t>& primitiveMaterialIndices)
+{
+    for(size_t gltfMeshIndex = 0; gltfMeshIndex < model.meshes.size(); gltfMeshIndex++){
+        auto& gltfMesh = model.meshes.at(gltfMeshIndex);
+        for(const auto& gltfPrimitive : gltfMesh.primitives){
+            uint32_t vertexOffset = static_cast<uint32_t>(vertices.size());
+
+            // Vertex Attributes
+            auto& attributes = gltfPrimitive.attributes;
+
+            const tinygltf::Accessor* positionAccessor = nullptr;
+            const tinygltf::BufferView* positionBufferView = nullptr;
+            if(!findAttribute(model, buffers, attributes, "POSITION", TINYGLTF_TYPE_VEC3, sizeof(glm::vec3), 0,
+                              positionAccessor, positionBufferView) || !positionAccessor){
+                return false;
+            }
+            const size_t vertexCount = positionAccessor->count;
+
+            const tinygltf::Accessor* normalAccessor = nullptr;
+            const tinygltf::BufferView* normalBufferView = nullptr;
+            const tinygltf::Accessor* texCoordAccessor = nullptr;
+            const tinygltf::BufferView* texCoordBufferView = nullptr;
+            if(!findAttribute(model, buffers, attributes, "NORMAL", TINYGLTF_TYPE_VEC3, sizeof(glm::vec3), vertexCount,
+                              normalAccessor, normalBufferView) ||
+               !findAttribute(model, buffers, attributes, "TEXCOORD_0", TINYGLTF_TYPE_VEC2, sizeof(glm::vec2), vertexCount,
+                              texCoordAccessor, texCoordBufferView)){
+                return false;
+            }
+            const uint8_t* positionData = buffers[positionBufferView->buffer].data();
+            const uint8_t* normalData = normalBufferView ? buffers[normalBufferView->buffer].data() : nullptr;
+            const uint8_t* texCoordData = texCoordBufferView ? buffers[texCoordBufferView->buffer].data() : nullptr;
+
+            vertices.reserve(vertices.size() + vertexCount);
+            for(size_t i = 0; i < vertexCount; i++){
+                Vertex v{};
+                {
+                    size_t byteStride = getByteStride(positionBufferView, sizeof(glm::vec3));
+                    size_t positionByteOffset = positionAccessor->byteOffset +
+                                                positionBufferView->byteOffset + i * byteStride;
+                    std::memcpy(&v.pos, positionData + positionByteOffset, sizeof(glm::vec3));
+                }
+
+                if(normalBufferView){
+                    size_t byteStride = getByteStride(normalBufferView, sizeof(glm::vec3));
+                    size_t normalByteOffset = normalAccessor->byteOffset +
+                                                normalBufferView->byteOffset + i * byteStride;
+                    std::memcpy(&v.normal, normalData + normalByteOffset, sizeof(glm::vec3));
+                }
+                if(texCoordBufferView){
+                    size_t byteStride = getByteStride(texCoordBufferView, sizeof(glm::vec2));
+                    size_t texCoordByteOffset = texCoordAccessor->byteOffset +
+                                                texCoordBufferView->byteOffset + i * byteStride;
+                    std::memcpy(&v.texCoord, texCoordData + texCoordByteOffset, sizeof(glm::vec2));
+                }
+                vertices.push_back(v);
+            }
+
+            // 三角形ごとのマテリアル番号
+            uint32_t matId = (gltfPrimitive.material >= 0) ? (uint32_t)gltfPrimitive.material : 0u;
+
+            // インデックスの無いプリミティブは頂点を順に 3 つずつ三角形にする
+            if(gltfPrimitive.indices < 0){
+                primitiveMaterialIndices.insert(primitiveMaterialIndices.end(), vertexCount / 3, matId);
+                indices.reserve(indices.size() + vertexCount);
+                for(size_t i = 0; i < vertexCount; i++) indices.push_back(vertexOffset + uint32_t(i));
+                continue;
+            }
+            if(size_t(gltfPrimitive.indices) >= model.accessors.size()) return false;
+            auto& accessor   = model.accessors[gltfPrimitive.indices];
+            if(accessor.bufferView < 0 || size_t(accessor.bufferView) >= model.bufferViews.size()) return false;
+            auto& bufferView = model.bufferViews[accessor.bufferView];
+            size_t indexSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+            if(indexSize > 4 || !accessorInBounds(buffers, accessor, bufferView, indexSize)) return false;
+
+            primitiveMaterialIndices.insert(primitiveMaterialIndices.end(), accessor.count / 3, matId);
+
+            const unsigned char* src = buffers[bufferView.buffer].data() + accessor.byteOffset + bufferView.byteOffset;
+            indices.reserve(indices.size() + accessor.count);
+            switch(accessor.componentType){
+                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+                    appendIndices<uint32_t>(src, accessor.count, vertexOffset, indices);
+                    break;
+                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+                    appendIndices<uint16_t>(src, accessor.count, vertexOffset, indices);
+                    break;
+                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
+                    appendIndices<uint8_t>(src, accessor.count, vertexOffset, indices);
+                    break;
+                default:
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+std::vector<Material> translateMaterials(const tinygltf::Model& model){
+    std::vector<Material> materials;
+    materials.reserve(model.materials.size());
+
+    for(const auto& mat : model.materials){
+        Material m;
+
+        const auto& pbr = mat.pbrMetallicRoughness;
+
+        if (pbr.baseColorFactor.size() == 4) {
+            m.baseColorFactor = glm::vec4(
+                (float)pbr.baseColorFactor[0],
+                (float)pbr.baseColorFactor[1],
+                (float)pbr.baseColorFactor[2],
+                (float)pbr.baseColorFactor[3]
+            );
+        } else {
+            m.baseColorFactor = glm::vec4(1.0f);
+        }
+
+        m.metallicFactor  = (float)pbr.metallicFactor;
+        m.roughnessFactor = (float)pbr.roughnessFactor;
+
+        m.baseColorTextureIndex = imageIndex(model, pbr.baseColorTexture.index);
+        m.matallicRoughnessTextureIndex = imageIndex(model, pbr.metallicRoughnessTexture.index);
+        m.normalTextureIndex = imageIndex(model, mat.normalTexture.index);
+        m.occulusionTextureIndex = imageIndex(model, mat.occlusionTexture.index);
+        m.emissiveTextureIndex = imageIndex(model, mat.emissiveTexture.index);
+
+        if (mat.emissiveFactor.size() == 3) {
+            m.emissiveFactor = glm::vec4(
+                (float)mat.emissiveFactor[0],
+                (float)mat.emissiveFactor[1],
+                (float)mat.emissiveFactor[2],
+                1.0f
+            );
+        } else {
+            m.emissiveFactor = glm::vec4(0.0f);
+        }
+
+        m.transmission = 0.0f;
+        auto extTransmission = mat.extensions.find("KHR_materials_transmission");
+        if(extTransmission != mat.extensions.end()){
+            const tinygltf::Value& ext = extTransmission->second;
+            if(ext.Has("transmission")){
+                m.transmission = (float)ext.Get("transmission").GetNumberAsDouble();
+            }
+        }
+
+        m.ior = 1.5f;
+        auto extIor = mat.extensions.find("KHR_materials_ior");
+        if (extIor != mat.extensions.end()) {
+            const tinygltf::Value& ext = extIor->second;
+            if (ext.Has("ior")) {
+                m.ior = (float)ext.Get("ior").GetNumberAsDouble();
+            }
+        }
+
+        materials.push_back(m);
+    }
+    return materials;
+}
+
+namespace {
+
+struct Quat {
+    float x = 0.0f, y = 0.0f, z = 0.0f, w = 1.0f;
+};
+
+glm::vec3 rotate(const Quat& q, const glm::vec3& v){
+    glm::vec3 u(q.x, q.y, q.z);
+    glm::vec3 t = glm::cross(u, v) * 2.0f;
+    return v + t * q.w + glm::cross(u, t);
+}
+
+Quat normalizeQuat(Quat q){
+    float len = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    if(len <= 0.0f) return Quat{};
+    float inv = 1.0f / len;
+    return {q.x * inv, q.y * inv, q.z * inv, q.w * inv};
+}
+
+Quat slerp(Quat a, Quat b, float s){
+    float d = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    if(d < 0.0f){
+        b = {-b.x, -b.y, -b.z, -b.w};
+        d = -d;
+    }
+    float wa = 1.0f - s;
+    float wb = s;
+    if(d < 0.9995f){
+        float angle = std::acos(d);
+        float inv = 1.0f / std::sin(angle);
+        wa = std::sin((1.0f - s) * angle) * inv;
+        wb = std::sin(s * angle) * inv;
+    }
+    return normalizeQuat({a.x * wa + b.x * wb, a.y * wa + b.y * wb, a.z * wa + b.z * wb, a.w * wa + b.w * wb});
+}
+
+// float のアクセサを components 成分ずつ読む
+bool readFloats(
+    const tinygltf::Model& model, std::span<const std::span<const uint8_t>> buffers,
+    int accessorIndex, int components, std::vector<float>& out)
+{
+    if(accessorIndex < 0 || size_t(accessorIndex) >= model.accessors.size()) return false;
+    const auto& accessor = model.accessors[accessorIndex];
+    if(accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT ||
+       tinygltf::GetNumComponentsInType(uint32_t(accessor.type)) != components) return false;
+    if(accessor.bufferView < 0 || size_t(accessor.bufferView) >= model.bufferViews.size()) return false;
+    const auto& view = model.bufferViews[accessor.bufferView];
+    size_t elementSize = sizeof(float) * size_t(components);
+    if(!accessorInBounds(buffers, accessor, view, elementSize)) return false;
+
+    size_t stride = getByteStride(&view, elementSize);
+    const uint8_t* src = buffers[view.buffer].data() + view.byteOffset + accessor.byteOffset;
+    out.resize(accessor.count * size_t(components));
+    for(size_t i = 0; i < accessor.count; i++){
+        std::memcpy(&out[i * size_t(components)], src + i * stride, elementSize);
+    }
+    return true;
+}
+
+// アニメーションのサンプラ 1 本 (translation は 3 成分, rotation は 4 成分)
+struct Track {
+    std::vector<float> times;
+    std::vector<float> values;
+    int components = 0;
+    bool step = false;
+    bool cubic = false;     // CUBICSPLINE は (入る接線, 値, 出る接線) の 3 つ組
+
+    float value(size_t key, int c, int slot = 1) const {
+        size_t element = cubic ? key * 3 + size_t(slot) : key;
+        return values[element * size_t(components) + size_t(c)];
+    }
+
+    void sample(float t, float* out) const {
+        auto after = std::upper_bound(times.begin(), times.end(), t);
+        if(after == times.begin() || after == times.end()){
+            size_t key = after == times.begin() ? 0 : times.size() - 1;
+            for(int c = 0; c < components; c++) out[c] = value(key, c);
+            return;
+        }
+        size_t k1 = size_t(after - times.begin());
+        size_t k0 = k1 - 1;
+        float h = times[k1] - times[k0];
+        float s = (t - times[k0]) / h;
+        if(step){
+            for(int c = 0; c < components; c++) out[c] = value(k0, c);
+        }else if(cubic){
+            float s2 = s * s, s3 = s2 * s;
+            for(int c = 0; c < components; c++){
+                out[c] = (2.0f * s3 - 3.0f * s2 + 1.0f) * value(k0, c) + (s3 - 2.0f * s2 + s) * h * value(k0, c, 2) +
+                         (-2.0f * s3 + 3.0f * s2) * value(k1, c) + (s3 - s2) * h * value(k1, c, 0);
+            }
+        }else if(components == 4){
+            Quat q = slerp({value(k0, 0), value(k0, 1), value(k0, 2), value(k0, 3)},
+                           {value(k1, 0), value(k1, 1), value(k1, 2), value(k1, 3)}, s);
+            out[0] = q.x; out[1] = q.y; out[2] = q.z; out[3] = q.w;
+        }else{
+            for(int c = 0; c < components; c++) out[c] = value(k0, c) + (value(k1, c) - value(k0, c)) * s;
+        }
+    }
+};
+
+bool readTrack(
+    const tinygltf::Model& model, std::span<const std::span<const uint8_t>> buffers,
+    const tinygltf::AnimationSampler& sampler, int components, Track& track)
+{
+    track.components = components;
+    track.step = sampler.interpolation == "STEP";
+    track.cubic = sampler.interpolation == "CUBICSPLINE";
+    if(!readFloats(model, buffers, sampler.input, 1, track.times) ||
+       !readFloats(model, buffers, sampler.output, components, track.values)) return false;
+    size_t perKey = size_t(components) * (track.cubic ? 3 : 1);
+    if(track.times.empty() || track.values.size() != track.times.size() * perKey) return false;
+    for(size_t i = 1; i < track.times.size(); i++){
+        if(!(track.times[i] > track.times[i - 1])) return false;
+    }
+    return true;
+}
+
+// ノードのローカル変換 (matrix か TRS)
+struct NodeTransform {
+    bool hasMatrix = false;
+    float matrix[16] = {};
+    glm::vec3 translation{0.0f, 0.0f, 0.0f};
+    Quat rotation;
+    glm::vec3 scale{1.0f, 1.0f, 1.0f};
+
+    explicit NodeTransform(const tinygltf::Node& node){
+        if(node.matrix.size() == 16){
+            hasMatrix = true;
+            for(int i = 0; i < 16; i++) matrix[i] = float(node.matrix[i]);
+            return;
+        }
+        if(node.translation.size() == 3){
+            translation = glm::vec3(float(node.translation[0]), float(node.translation[1]), float(node.translation[2]));
+        }
+        if(node.rotation.size() == 4){
+            rotation = normalizeQuat({float(node.rotation[0]), float(node.rotation[1]), float(node.rotation[2]), float(node.rotation[3])});
+        }
+        if(node.scale.size() == 3){
+            scale = glm::vec3(float(node.scale[0]), float(node.scale[1]), float(node.scale[2]));
+        }
+    }
+
+    // w = 1 なら点、0 なら方向
+    glm::vec3 apply(const glm::vec3& v, float w) const {
+        if(hasMatrix){
+            // 列優先
+            return glm::vec3(matrix[0] * v.x + matrix[4] * v.y + matrix[8] * v.z + matrix[12] * w,
+                             matrix[1] * v.x + matrix[5] * v.y + matrix[9] * v.z + matrix[13] * w,
+                             matrix[2] * v.x + matrix[6] * v.y + matrix[10] * v.z + matrix[14] * w);
+        }
+        glm::vec3 scaled(v.x * scale.x, v.y * scale.y, v.z * scale.z);
+        return rotate(rotation, scaled) + translation * w;
+    }
+};
+
+}
+
+bool decodeCameraKeys(
+    const tinygltf::Model& model,
+    std::span<const std::span<const uint8_t>> buffers,
+    std::vector<CameraKey>& keys)
+{
+    keys.clear();
+    int cameraNode = -1;
+    for(size_t i = 0; i < model.nodes.size() && cameraNode < 0; i++){
+        int camera = model.nodes[i].camera;
+        if(camera >= 0 && size_t(camera) < model.cameras.size() && model.cameras[camera].type == "perspective"){
+            cameraNode = int(i);
+        }
+    }
+    if(cameraNode < 0) return true;
+    const tinygltf::Node& node = model.nodes[cameraNode];
+    const float vfov = float(model.cameras[node.camera].perspective.yfov);
+
+    // 親のノードは動かないものとして、カメラのノードから根まで順に掛ける
+    std::vector<int> parents(model.nodes.size(), -1);
+    for(size_t i = 0; i < model.nodes.size(); i++){
+        for(int child : model.nodes[i].children){
+            if(child >= 0 && size_t(child) < parents.size()) parents[child] = int(i);
+        }
+    }
+    std::vector<NodeTransform> ancestors;
+    for(int p = parents[cameraNode]; p >= 0 && ancestors.size() < model.nodes.size(); p = parents[p]){
+        ancestors.emplace_back(model.nodes[p]);
+    }
+
+    // カメラのノードを動かす最初のアニメーションの translation / rotation
+    Track translation, rotation;
+    bool hasTranslation = false, hasRotation = false;
+    for(const auto& animation : model.animations){
+        for(const auto& channel : animation.channels){
+            if(channel.target_node != cameraNode) continue;
+            if(channel.sampler < 0 || size_t(channel.sampler) >= animation.samplers.size()) return false;
+            const auto& sampler = animation.samplers[channel.sampler];
+            if(channel.target_path == "translation" && !hasTranslation){
+                if(!readTrack(model, buffers, sampler, 3, translation)) return false;
+                hasTranslation = true;
+            }else if(channel.target_path == "rotation" && !hasRotation){
+                if(!readTrack(model, buffers, sampler, 4, rotation)) return false;
+                hasRotation = true;
+            }
+        }
+        if(hasTranslation || hasRotation) break;
+    }
+
+    // どちらかのトラックにキーがある時刻ごとにカメラのキーを作る
+    std::vector<float> times;
+    if(hasTranslation) times.insert(times.end(), translation.times.begin(), translation.times.end());
+    if(hasRotation) times.insert(times.end(), rotation.times.begin(), rotation.times.end());
+    if(times.empty()) times.push_back(0.0f);
+    std::sort(times.begin(), times.end());
+    times.erase(std::unique(times.begin(), times.end()), times.end());
+
+    keys.reserve(times.size());
+    for(float t : times){
+        NodeTransform local(node);
+        if(!local.hasMatrix){
+            if(hasTranslation){
+                float v[3];
+                translation.sample(t, v);
+                local.translation = glm::vec3(v[0], v[1], v[2]);
+            }
+            if(hasRotation){
+                float q[4];
+                rotation.sample(t, q);
+                local.rotation = normalizeQuat({q[0], q[1], q[2], q[3]});
+            }
+        }
+        // glTF のカメラは -Z を向き、+Y が上
+        CameraKey key;
+        key.time = t;
+        key.position = local.apply(glm::vec3(0.0f, 0.0f, 0.0f), 1.0f);
+        key.forward = local.apply(glm::vec3(0.0f, 0.0f, -1.0f), 0.0f);
+        key.up = local.apply(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
+        for(const auto& parent : ancestors){
+            key.position = parent.apply(key.position, 1.0f);
+            key.forward = parent.apply(key.forward, 0.0f);
+            key.up = parent.apply(key.up, 0.0f);
+        }
+        key.vfov = vfov;
+        keys.push_back(key);
+    }
+    return sortCameraKeys(keys);
+}
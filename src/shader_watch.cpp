@@ -0,0 +1,135 @@
+#include "../include/shader_watch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+constexpr uint32_t kSpirvMagic = 0x07230203u;
+// 変更を見に行く間隔と、保存が落ち着くまで待つ時間
+constexpr auto kPollInterval = std::chrono::milliseconds(250);
+constexpr auto kSettleTime = std::chrono::milliseconds(100);
+
+std::string shellQuoted(const std::filesystem::path& path){
+    return "\"" + path.string() + "\"";
+}
+
+bool readSpirv(const std::filesystem::path& path, std::vector<uint32_t>& code){
+    std::ifstream ifs(path, std::ios::binary);
+    if(!ifs) return false;
+    std::vector<char> bytes((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    if(bytes.empty() || bytes.size() % sizeof(uint32_t) != 0) return false;
+    code.resize(bytes.size() / sizeof(uint32_t));
+    std::memcpy(code.data(), bytes.data(), bytes.size());
+    return code[0] == kSpirvMagic;
+}
+
+}
+
+ShaderWatcher::ShaderWatcher(std::filesystem::path shaderDir, std::filesystem::path outDir,
+                             std::string slangc, std::string profile, std::vector<ShaderCompileJob> jobs)
+    : shaderDir(std::move(shaderDir)), outDir(std::move(outDir)),
+      slangc(std::move(slangc)), profile(std::move(profile)), jobs(std::move(jobs)) {
+    worker = std::thread([this]{ run(); });
+}
+
+ShaderWatcher::~ShaderWatcher(){
+    stop();
+}
+
+bool ShaderWatcher::poll(std::vector<ShaderBinary>& binaries){
+    std::lock_guard<std::mutex> lock(mutex);
+    if(!ready) return false;
+    binaries = std::move(compiled);
+    compiled.clear();
+    ready = false;
+    return true;
+}
+
+void ShaderWatcher::stop(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!worker.joinable()) return;
+        stopping = true;
+    }
+    changed.notify_all();
+    worker.join();
+}
+
+ShaderWatcher::Stamps ShaderWatcher::scan() const {
+    Stamps stamps;
+    std::error_code ec;
+    for(const auto& entry : std::filesystem::directory_iterator(shaderDir, ec)){
+        if(entry.path().extension() != ".slang") continue;
+        auto time = entry.last_write_time(ec);
+        if(!ec) stamps.emplace_back(entry.path(), time);
+    }
+    std::sort(stamps.begin(), stamps.end());
+    return stamps;
+}
+
+bool ShaderWatcher::compile(std::vector<ShaderBinary>& binaries) const {
+    std::error_code ec;
+    std::filesystem::create_directories(outDir, ec);
+    binaries.clear();
+    for(const auto& job : jobs){
+        const std::filesystem::path source = shaderDir / (job.name + ".slang");
+        const std::filesystem::path output = outDir / (job.name + ".spv");
+        std::string cmd = shellQuoted(slangc) + " " + shellQuoted(source) +
+            " -target spirv -profile " + profile + " -I " + shellQuoted(shaderDir) +
+            " -entry " + job.entry + " -stage " + job.stage + " -o " + shellQuoted(output);
+#ifdef _WIN32
+        // cmd.exe は先頭と末尾の引用符を外すので全体をもう一度囲む
+        cmd = "\"" + cmd + "\"";
+#endif
+        // slangc のエラーはそのまま端末に出る
+        if(std::system(cmd.c_str()) != 0){
+            std::cerr << "shader reload: failed to compile " << source.filename().string() << std::endl;
+            return false;
+        }
+        ShaderBinary& binary = binaries.emplace_back();
+        binary.name = job.name;
+        if(!readSpirv(output, binary.code)){
+            std::cerr << "shader reload: invalid SPIR-V " << output.string() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShaderWatcher::run(){
+    Stamps stamps = scan();
+    std::unique_lock<std::mutex> lock(mutex);
+    for(;;){
+        if(changed.wait_for(lock, kPollInterval, [&]{ return stopping; })) return;
+        lock.unlock();
+        Stamps current = scan();
+        if(current != stamps){
+            // エディタの保存が何回かに分かれても 1 回のコンパイルで済ませる
+            do{
+                std::this_thread::sleep_for(kSettleTime);
+                stamps = current;
+                current = scan();
+            }while(current != stamps);
+
+            std::cout << "shader reload: compiling" << std::endl;
+            const auto start = std::chrono::steady_clock::now();
+            std::vector<ShaderBinary> binaries;
+            if(compile(binaries)){
+                const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                std::printf("shader reload: compiled in %.1f ms\n", ms);
+                lock.lock();
+                compiled = std::move(binaries);
+                ready = true;
+                continue;
+            }
+        }
+        lock.lock();
+    }
+}
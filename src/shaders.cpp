@@ -1,5 +1,7 @@
 #include "../include/globals.hpp"
 #include "../include/buffer.hpp"
+#include "../include/profiler.hpp"
+#include "../include/pipeline_cache.hpp"
 
 #include "raygen_spv.hpp"
 #include "miss_main_spv.hpp"
@@ -7,21 +9,45 @@
 #include "closesthit_spv.hpp"
 #include "anyhit_spv.hpp"
 
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
 
+namespace {
+
+// ディスクのキャッシュを読めたか ("warm" / "cold" / "off")。パイプライン作成時間の表示に使う
+const char* pipelineCacheState = "off";
+// 読んだときの内容。変わっていなければ書き戻さない
+uint64_t loadedPipelineCacheHash = 0;
+
+PipelineCacheKey makePipelineCacheKey(){
+    vk::PhysicalDeviceProperties props = physicalDevice.getProperties();
+    PipelineCacheKey key;
+    key.vendorID = props.vendorID;
+    key.deviceID = props.deviceID;
+    key.driverVersion = props.driverVersion;
+    std::memcpy(key.pipelineCacheUUID, props.pipelineCacheUUID.data(), sizeof(key.pipelineCacheUUID));
+    return key;
+}
+
+}
+
 vk::UniqueShaderModule createShaderModuleFromEmbedded(vk::Device &device,
-                                              const void* data,
+                                              const uint32_t* code,
                                               size_t sizeBytes)
 {
     vk::ShaderModuleCreateInfo ci{};
     ci.codeSize = sizeBytes;
-    ci.pCode    = static_cast<const uint32_t*>(data);  // SPIR-Vなのでuint32_t*
+    ci.pCode    = code;  // embed_spirv が uint32_t の配列で出すので揃っている
     return device.createShaderModuleUnique(ci);
 }
 
 void prepareShaders(){
+    PROFILE_ZONE("prepareShaders");
     uint32_t raygenShader = 0;
     uint32_t missMainShader = 1;
     uint32_t missShadowShader = 2;
@@ -104,25 +130,35 @@ void prepareShaders(){
     shaderGroups[hitGroup].setIntersectionShader(VK_SHADER_UNUSED_KHR);
 }
 
-void createRayTracingPipeline(){
-    vk::PipelineLayoutCreateInfo layoutCreateInfo{};
-    layoutCreateInfo.setSetLayouts(*descSetLayout);
-    pipelineLayout = device->createPipelineLayoutUnique(layoutCreateInfo);
+void createPipelineCache(const std::filesystem::path& path){
+    PROFILE_ZONE("createPipelineCache");
+    std::vector<uint8_t> data;
+    if(!path.empty()){
+        bool loaded = readPipelineCache(path, makePipelineCacheKey(), data);
+        pipelineCacheState = loaded ? "warm" : "cold";
+        loadedPipelineCacheHash = loaded ? hashBytes(data) : 0;
+    }
+    // path が空でもメモリ上のキャッシュは作り、各パイプラインの作成で共有する
+    vk::PipelineCacheCreateInfo createInfo{};
+    createInfo.setInitialDataSize(data.size());
+    createInfo.setPInitialData(data.data());
+    pipelineCache = device->createPipelineCacheUnique(createInfo);
+}
 
-    vk::RayTracingPipelineCreateInfoKHR pipelineCreateInfo{};
-    pipelineCreateInfo.setLayout(*pipelineLayout);
-    pipelineCreateInfo.setStages(shaderStages);
-    pipelineCreateInfo.setGroups(shaderGroups);
-    pipelineCreateInfo.setMaxPipelineRayRecursionDepth(2);
-    auto result = device->createRayTracingPipelineKHRUnique(nullptr, nullptr, pipelineCreateInfo);
-    if(result.result != vk::Result::eSuccess){
-        std::cerr << "Failed to create ray tracing pipeline.\n";
-        std::abort();
+void savePipelineCache(const std::filesystem::path& path){
+    PROFILE_ZONE("savePipelineCache");
+    if(path.empty()) return;
+    std::vector<uint8_t> data = device->getPipelineCacheData(*pipelineCache);
+    if(data.empty() || hashBytes(data) == loadedPipelineCacheHash) return;
+    if(!writePipelineCache(path, makePipelineCacheKey(), data)){
+        std::cerr << "failed to write pipeline cache: " << path.string() << std::endl;
     }
-    pipeline = std::move(result.value);
 }
 
+namespace {
+
 void createShaderBindingTable(){
+    PROFILE_ZONE("createShaderBindingTable");
     auto deviceProps = physicalDevice.getProperties2<
         vk::PhysicalDeviceProperties2,
         vk::PhysicalDeviceRayTracingPipelinePropertiesKHR>();
@@ -195,4 +231,82 @@ void createShaderBindingTable(){
     raygenRegion.setDeviceAddress(sbt.address);
     missRegion.setDeviceAddress(sbt.address + raygenRegion.size);
     hitRegion.setDeviceAddress(sbt.address + raygenRegion.size + missRegion.size);
-}
\ No newline at end of file
+}
+
+}
+
+void createRayTracingPipeline(const ShaderConstants& constants){
+    PROFILE_ZONE("createRayTracingPipeline");
+    if(!pipelineLayout){
+        vk::PipelineLayoutCreateInfo layoutCreateInfo{};
+        layoutCreateInfo.setSetLayouts(*descSetLayout);
+        pipelineLayout = device->createPipelineLayoutUnique(layoutCreateInfo);
+    }
+    if(pipeline && pipelineConstants == constants) return;
+
+    // ShaderConstants のメンバを順に constant_id 0, 1, ... に対応させる
+    std::array<vk::SpecializationMapEntry, kShaderConstantCount> entries;
+    for(uint32_t i = 0; i < kShaderConstantCount; i++){
+        entries[i] = vk::SpecializationMapEntry(i, i * sizeof(uint32_t), sizeof(uint32_t));
+    }
+    vk::SpecializationInfo specialization{};
+    specialization.setMapEntries(entries);
+    specialization.setDataSize(sizeof(ShaderConstants));
+    specialization.setPData(&constants);
+
+    // 定数を使うのは raygen だけ
+    std::vector<vk::PipelineShaderStageCreateInfo> stages = shaderStages;
+    for(auto& stage : stages){
+        if(stage.stage == vk::ShaderStageFlagBits::eRaygenKHR) stage.setPSpecializationInfo(&specialization);
+    }
+
+    vk::RayTracingPipelineCreateInfoKHR pipelineCreateInfo{};
+    pipelineCreateInfo.setLayout(*pipelineLayout);
+    pipelineCreateInfo.setStages(stages);
+    pipelineCreateInfo.setGroups(shaderGroups);
+    pipelineCreateInfo.setMaxPipelineRayRecursionDepth(2);
+    const auto start = std::chrono::steady_clock::now();
+    auto result = device->createRayTracingPipelineKHRUnique(nullptr, *pipelineCache, pipelineCreateInfo);
+    if(result.result != vk::Result::eSuccess){
+        std::cerr << "Failed to create ray tracing pipeline.\n";
+        std::abort();
+    }
+    pipeline = std::move(result.value);
+    pipelineConstants = constants;
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::printf("ray tracing pipeline: %.1f ms (pipeline cache %s, max depth %u, rr depth %u, nee %u, roulette %u)\n",
+                ms, pipelineCacheState, constants.maxDepth, constants.rouletteMinDepth, constants.sunNee, constants.russianRoulette);
+
+    createShaderBindingTable();
+}
+
+std::unique_ptr<ShaderWatcher> createShaderWatcher(const std::filesystem::path& outDir){
+    // shaderStages / shaderModules と同じ並び
+    std::vector<ShaderCompileJob> jobs = {
+        {"raygen", "raygenMain", "raygeneration"},
+        {"miss_main", "missMain", "miss"},
+        {"miss_shadow", "missShadow", "miss"},
+        {"closesthit", "closestHitMain", "closesthit"},
+        {"anyhit", "anyhitShadow", "anyhit"},
+    };
+    std::cout << "watching shaders: " << MAPLE_SHADER_DIR << std::endl;
+    return std::make_unique<ShaderWatcher>(MAPLE_SHADER_DIR, outDir, MAPLE_SLANGC, MAPLE_SLANG_PROFILE, std::move(jobs));
+}
+
+bool reloadRayTracingShaders(ShaderWatcher& watcher, const ShaderConstants& constants){
+    std::vector<ShaderBinary> binaries;
+    if(!watcher.poll(binaries)) return false;
+    PROFILE_ZONE("reloadRayTracingShaders");
+    if(binaries.size() != shaderModules.size()) return false;
+
+    // 古いパイプラインを使うコマンドが残っていないことを確かめてから捨てる
+    device->waitIdle();
+    for(size_t i = 0; i < binaries.size(); i++){
+        shaderModules[i] = createShaderModuleFromEmbedded(*device, binaries[i].code.data(), binaries[i].code.size() * sizeof(uint32_t));
+        shaderStages[i].setModule(*shaderModules[i]);
+    }
+    // パイプラインと SBT は古いシェーダのものなので作り直す
+    pipeline.reset();
+    createRayTracingPipeline(constants);
+    return true;
+}
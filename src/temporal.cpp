@@ -0,0 +1,93 @@
+#include "../include/temporal.hpp"
+#include "../include/profiler.hpp"
+
+#include "temporal_spv.hpp"
+
+#include <iostream>
+
+namespace {
+
+constexpr uint32_t kTemporalGroupSize = 8;
+constexpr uint32_t kTemporalBindings = 7;
+
+}
+
+void createTemporalPipeline(){
+    PROFILE_ZONE("createTemporalPipeline");
+
+    std::vector<vk::DescriptorSetLayoutBinding> bindings(kTemporalBindings);
+    for(uint32_t i = 0; i < kTemporalBindings; i++){
+        bindings[i].setBinding(i);
+        bindings[i].setDescriptorType(vk::DescriptorType::eStorageImage);
+        bindings[i].setDescriptorCount(1);
+        bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    }
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo{};
+    layoutCreateInfo.setBindings(bindings);
+    temporalDescSetLayout = device->createDescriptorSetLayoutUnique(layoutCreateInfo);
+
+    // 履歴の向きごとに 1 セット
+    vk::DescriptorPoolSize poolSize{vk::DescriptorType::eStorageImage, 2 * kTemporalBindings};
+    vk::DescriptorPoolCreateInfo poolCreateInfo{};
+    poolCreateInfo.setPoolSizes(poolSize);
+    poolCreateInfo.setMaxSets(2);
+    poolCreateInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+    temporalDescPool = device->createDescriptorPoolUnique(poolCreateInfo);
+
+    std::vector<vk::DescriptorSetLayout> layouts(2, *temporalDescSetLayout);
+    vk::DescriptorSetAllocateInfo allocateInfo{};
+    allocateInfo.setDescriptorPool(*temporalDescPool);
+    allocateInfo.setSetLayouts(layouts);
+    temporalDescSets = device->allocateDescriptorSetsUnique(allocateInfo);
+
+    for(uint32_t set = 0; set < 2; set++){
+        const uint32_t prev = set ^ 1;
+        vk::ImageView views[kTemporalBindings] = {
+            hdrView.get(), normalView.get(), depthView.get(),
+            historyColorViews[prev].get(), historyGeometryViews[prev].get(),
+            historyColorViews[set].get(), historyGeometryViews[set].get(),
+        };
+        vk::DescriptorImageInfo imageInfos[kTemporalBindings];
+        std::vector<vk::WriteDescriptorSet> writes(kTemporalBindings);
+        for(uint32_t i = 0; i < kTemporalBindings; i++){
+            imageInfos[i].setImageView(views[i]);
+            imageInfos[i].setImageLayout(vk::ImageLayout::eGeneral);
+            writes[i].setDstSet(*temporalDescSets[set]);
+            writes[i].setDstBinding(i);
+            writes[i].setDescriptorType(vk::DescriptorType::eStorageImage);
+            writes[i].setImageInfo(imageInfos[i]);
+        }
+        device->updateDescriptorSets(writes, nullptr);
+    }
+
+    vk::PushConstantRange pushRange{vk::ShaderStageFlagBits::eCompute, 0, sizeof(TemporalParams)};
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+    pipelineLayoutCreateInfo.setSetLayouts(*temporalDescSetLayout);
+    pipelineLayoutCreateInfo.setPushConstantRanges(pushRange);
+    temporalPipelineLayout = device->createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+
+    vk::ShaderModuleCreateInfo moduleCreateInfo{};
+    moduleCreateInfo.codeSize = temporal_spv_size;
+    moduleCreateInfo.pCode = temporal_spv;
+    temporalShader = device->createShaderModuleUnique(moduleCreateInfo);
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo{};
+    pipelineCreateInfo.stage.setStage(vk::ShaderStageFlagBits::eCompute);
+    pipelineCreateInfo.stage.setModule(*temporalShader);
+    pipelineCreateInfo.stage.setPName("main");
+    pipelineCreateInfo.setLayout(*temporalPipelineLayout);
+    auto result = device->createComputePipelineUnique(*pipelineCache, pipelineCreateInfo);
+    if(result.result != vk::Result::eSuccess){
+        std::cerr << "Failed to create temporal pipeline.\n";
+        std::abort();
+    }
+    temporalPipeline = std::move(result.value);
+}
+
+void recordTemporal(vk::CommandBuffer cmdBuf, const TemporalParams& params, uint32_t historyIndex){
+    cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, temporalPipeline.get());
+    cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, temporalPipelineLayout.get(), 0, {temporalDescSets[historyIndex & 1].get()}, {});
+    cmdBuf.pushConstants(temporalPipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(TemporalParams), &params);
+    cmdBuf.dispatch((width + kTemporalGroupSize - 1) / kTemporalGroupSize,
+                    (height + kTemporalGroupSize - 1) / kTemporalGroupSize, 1);
+}
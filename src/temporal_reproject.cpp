@@ -0,0 +1,145 @@
+#include "../include/temporal_reproject.hpp"
+#include "../include/parallel.hpp"
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// 履歴の重みの合計がこれ未満なら遮蔽が外れたとみなして捨てる
+constexpr float kMinHistoryWeight = 1e-3f;
+
+struct Vec3 {
+    float x, y, z;
+};
+
+Vec3 operator+(Vec3 a, Vec3 b){ return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+Vec3 operator-(Vec3 a, Vec3 b){ return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+Vec3 operator*(Vec3 a, float s){ return {a.x * s, a.y * s, a.z * s}; }
+float dot(Vec3 a, Vec3 b){ return a.x * b.x + a.y * b.y + a.z * b.z; }
+Vec3 cross(Vec3 a, Vec3 b){ return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+Vec3 load3(const float* v){ return {v[0], v[1], v[2]}; }
+
+struct Camera {
+    Vec3 position, forward, right, up;
+    float tanHalfFov;
+    float aspect;
+};
+
+Camera unpack(const TemporalCamera& c){
+    Camera camera;
+    camera.position = load3(c.position);
+    camera.forward = load3(c.forward);
+    camera.right = load3(c.right);
+    camera.up = cross(camera.right, camera.forward);
+    camera.tanHalfFov = c.position[3];
+    camera.aspect = c.forward[3];
+    return camera;
+}
+
+}
+
+TemporalCamera makeTemporalCamera(const CameraView& view, uint32_t width, uint32_t height){
+    TemporalCamera camera{};
+    camera.position[0] = view.position.x;
+    camera.position[1] = view.position.y;
+    camera.position[2] = view.position.z;
+    camera.position[3] = view.tanHalfFov;
+    camera.forward[0] = view.forward.x;
+    camera.forward[1] = view.forward.y;
+    camera.forward[2] = view.forward.z;
+    camera.forward[3] = float(width) / float(std::max(1u, height));
+    camera.right[0] = view.right.x;
+    camera.right[1] = view.right.y;
+    camera.right[2] = view.right.z;
+    return camera;
+}
+
+void temporalAccumulate(
+    std::span<const float> current, std::span<const float> normal, std::span<const float> depth,
+    uint32_t width, uint32_t height, const TemporalParams& params,
+    const TemporalHistoryView& previous, const TemporalHistory& next, std::span<float> output){
+    PROFILE_ZONE("temporalAccumulate");
+    const Camera cur = unpack(params.current);
+    const Camera prev = unpack(params.previous);
+
+    parallelRows(height, [&](uint32_t begin, uint32_t end){
+        for(uint32_t y = begin; y < end; y++){
+            for(uint32_t x = 0; x < width; x++){
+                const size_t p = size_t(y) * width + x;
+                const Vec3 color = load3(&current[p * 4]);
+                const float z = depth[p];
+                Vec3 n = load3(&normal[p * 4]);
+                const float nLength = std::sqrt(dot(n, n));
+                const bool hasGeometry = z > 0.0f && nLength > 1e-6f;
+                n = hasGeometry ? n * (1.0f / nLength) : Vec3{0.0f, 0.0f, 0.0f};
+
+                Vec3 history{0.0f, 0.0f, 0.0f};
+                float historyLength = 0.0f;
+                if(params.historyValid != 0 && hasGeometry){
+                    // 画素中心のレイ (forward との内積が 1) に線形深度を掛けるとワールド座標
+                    float ndcX = 2.0f * (float(x) + 0.5f) / float(width) - 1.0f;
+                    float ndcY = 1.0f - 2.0f * (float(y) + 0.5f) / float(height);
+                    Vec3 dir = cur.forward + cur.right * (ndcX * cur.aspect * cur.tanHalfFov) + cur.up * (ndcY * cur.tanHalfFov);
+                    Vec3 world = cur.position + dir * z;
+
+                    Vec3 v = world - prev.position;
+                    float prevZ = dot(v, prev.forward);
+                    if(prevZ > 0.0f){
+                        float prevNdcX = dot(v, prev.right) / (prevZ * prev.aspect * prev.tanHalfFov);
+                        float prevNdcY = dot(v, prev.up) / (prevZ * prev.tanHalfFov);
+                        float px = (prevNdcX + 1.0f) * 0.5f * float(width) - 0.5f;
+                        float py = (1.0f - prevNdcY) * 0.5f * float(height) - 0.5f;
+                        float fx0 = std::floor(px);
+                        float fy0 = std::floor(py);
+                        float fx = px - fx0;
+                        float fy = py - fy0;
+                        int x0 = int(fx0);
+                        int y0 = int(fy0);
+
+                        // 双線形の 4 タップのうち、深度と法線が合うものだけで補間する
+                        float weightSum = 0.0f;
+                        Vec3 colorSum{0.0f, 0.0f, 0.0f};
+                        float lengthSum = 0.0f;
+                        for(int tap = 0; tap < 4; tap++){
+                            int tx = x0 + (tap & 1);
+                            int ty = y0 + (tap >> 1);
+                            if(tx < 0 || ty < 0 || tx >= int(width) || ty >= int(height)) continue;
+                            const size_t q = size_t(ty) * width + size_t(tx);
+                            const float* g = &previous.geometry[q * 4];
+                            if(g[3] <= 0.0f || std::abs(g[3] - prevZ) > params.depthTolerance * prevZ) continue;
+                            if(dot(load3(g), n) < params.normalThreshold) continue;
+                            float w = ((tap & 1) ? fx : 1.0f - fx) * ((tap >> 1) ? fy : 1.0f - fy);
+                            const float* h = &previous.color[q * 4];
+                            weightSum += w;
+                            colorSum = colorSum + load3(h) * w;
+                            lengthSum += h[3] * w;
+                        }
+                        if(weightSum >= kMinHistoryWeight){
+                            history = colorSum * (1.0f / weightSum);
+                            historyLength = lengthSum / weightSum;
+                        }
+                    }
+                }
+
+                const float length = historyLength + 1.0f;
+                const float blend = std::max(1.0f / length, params.minBlend);
+                const Vec3 result = history + (color - history) * blend;
+
+                next.color[p * 4 + 0] = result.x;
+                next.color[p * 4 + 1] = result.y;
+                next.color[p * 4 + 2] = result.z;
+                next.color[p * 4 + 3] = length;
+                next.geometry[p * 4 + 0] = n.x;
+                next.geometry[p * 4 + 1] = n.y;
+                next.geometry[p * 4 + 2] = n.z;
+                next.geometry[p * 4 + 3] = hasGeometry ? z : 0.0f;
+                output[p * 4 + 0] = result.x;
+                output[p * 4 + 1] = result.y;
+                output[p * 4 + 2] = result.z;
+                output[p * 4 + 3] = current[p * 4 + 3];
+            }
+        }
+    });
+}
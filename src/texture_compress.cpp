@@ -0,0 +1,419 @@
+#include "../include/texture_compress.hpp"
+#include "../include/mipmap.hpp"
+#include "../include/mapped_file.hpp"
+#include "../include/parallel.hpp"
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr char kContainerMagic[8] = {'M', 'A', 'P', 'L', 'E', 'T', 'E', 'X'};
+
+// BC のブロックは 16 バイト境界に置く (Vulkan のコピー元オフセット制約)
+constexpr uint64_t kContainerAlignment = 16;
+
+struct ContainerHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t textureCount;
+    uint64_t sourceHash;
+    uint64_t fileSize;
+};
+
+struct ContainerTexture {
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    TextureFormat format;
+    uint64_t offset;    // ファイル先頭からのオフセット
+    uint64_t size;      // 全ミップの合計
+};
+
+// 16 画素の主軸 (べき乗法)。N は使うチャンネル数
+template<int N>
+std::array<float, N> principalAxis(const std::array<std::array<float, N>, 16>& px, std::array<float, N>& mean){
+    mean.fill(0.0f);
+    for(const auto& p : px){
+        for(int c = 0; c < N; c++) mean[c] += p[c];
+    }
+    for(int c = 0; c < N; c++) mean[c] /= 16.0f;
+
+    float cov[N][N] = {};
+    for(const auto& p : px){
+        for(int a = 0; a < N; a++){
+            for(int b = 0; b < N; b++) cov[a][b] += (p[a] - mean[a]) * (p[b] - mean[b]);
+        }
+    }
+
+    std::array<float, N> axis;
+    axis.fill(1.0f);
+    for(int iter = 0; iter < 8; iter++){
+        std::array<float, N> next{};
+        float len = 0.0f;
+        for(int a = 0; a < N; a++){
+            for(int b = 0; b < N; b++) next[a] += cov[a][b] * axis[b];
+            len += next[a] * next[a];
+        }
+        // 単色のブロックは軸が決まらないのでそのまま
+        if(len < 1e-12f) break;
+        len = std::sqrt(len);
+        for(int a = 0; a < N; a++) axis[a] = next[a] / len;
+    }
+    return axis;
+}
+
+// 主軸上の両端を端点にする
+template<int N>
+void fitEndpoints(const std::array<std::array<float, N>, 16>& px, std::array<float, N>& e0, std::array<float, N>& e1){
+    std::array<float, N> mean;
+    std::array<float, N> axis = principalAxis<N>(px, mean);
+    float tMin = 0.0f, tMax = 0.0f;
+    for(const auto& p : px){
+        float t = 0.0f;
+        for(int c = 0; c < N; c++) t += (p[c] - mean[c]) * axis[c];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    for(int c = 0; c < N; c++){
+        e0[c] = std::clamp(mean[c] + axis[c] * tMin, 0.0f, 255.0f);
+        e1[c] = std::clamp(mean[c] + axis[c] * tMax, 0.0f, 255.0f);
+    }
+}
+
+uint32_t squaredError(const uint8_t* a, const uint8_t* b, int channels){
+    uint32_t err = 0;
+    for(int c = 0; c < channels; c++){
+        int d = int(a[c]) - int(b[c]);
+        err += uint32_t(d * d);
+    }
+    return err;
+}
+
+uint16_t packRgb565(const std::array<float, 3>& c){
+    uint32_t r = uint32_t(std::lround(c[0] * 31.0f / 255.0f));
+    uint32_t g = uint32_t(std::lround(c[1] * 63.0f / 255.0f));
+    uint32_t b = uint32_t(std::lround(c[2] * 31.0f / 255.0f));
+    return uint16_t((r << 11) | (g << 5) | b);
+}
+
+void unpackRgb565(uint16_t v, uint8_t* out){
+    uint32_t r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    out[0] = uint8_t((r << 3) | (r >> 2));
+    out[1] = uint8_t((g << 2) | (g >> 4));
+    out[2] = uint8_t((b << 3) | (b >> 2));
+}
+
+// 128bit のブロックに LSB から詰める
+struct BitWriter {
+    uint8_t* out;
+    uint32_t pos = 0;
+
+    void write(uint32_t value, uint32_t bits){
+        for(uint32_t i = 0; i < bits; i++, pos++){
+            if(value & (1u << i)) out[pos >> 3] |= uint8_t(1u << (pos & 7));
+        }
+    }
+};
+
+constexpr uint32_t kBC7Weights4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+void gatherBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t* block){
+    for(uint32_t y = 0; y < 4; y++){
+        uint32_t sy = std::min(by * 4 + y, height - 1);
+        for(uint32_t x = 0; x < 4; x++){
+            uint32_t sx = std::min(bx * 4 + x, width - 1);
+            std::memcpy(block + (y * 4 + x) * 4, pixels + (size_t(sy) * width + sx) * 4, 4);
+        }
+    }
+}
+
+}
+
+void encodeBC1Block(const uint8_t* block, uint8_t* out){
+    std::array<std::array<float, 3>, 16> px;
+    for(int i = 0; i < 16; i++){
+        for(int c = 0; c < 3; c++) px[i][c] = float(block[i * 4 + c]);
+    }
+    std::array<float, 3> e0, e1;
+    fitEndpoints<3>(px, e0, e1);
+
+    // c0 > c1 で 4 色モード
+    uint16_t c0 = packRgb565(e1);
+    uint16_t c1 = packRgb565(e0);
+    if(c0 < c1) std::swap(c0, c1);
+
+    uint8_t palette[4][3];
+    unpackRgb565(c0, palette[0]);
+    unpackRgb565(c1, palette[1]);
+    for(int c = 0; c < 3; c++){
+        palette[2][c] = uint8_t((2 * palette[0][c] + palette[1][c] + 1) / 3);
+        palette[3][c] = uint8_t((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+    }
+
+    uint32_t indices = 0;
+    if(c0 != c1){
+        for(int i = 0; i < 16; i++){
+            uint32_t best = 0, bestErr = UINT32_MAX;
+            for(uint32_t k = 0; k < 4; k++){
+                uint32_t err = squaredError(block + i * 4, palette[k], 3);
+                if(err < bestErr){ bestErr = err; best = k; }
+            }
+            indices |= best << (2 * i);
+        }
+    }
+
+    out[0] = uint8_t(c0); out[1] = uint8_t(c0 >> 8);
+    out[2] = uint8_t(c1); out[3] = uint8_t(c1 >> 8);
+    std::memcpy(out + 4, &indices, 4);
+}
+
+void encodeBC4Block(const uint8_t* block, uint32_t channel, uint8_t* out){
+    uint8_t lo = 255, hi = 0;
+    for(int i = 0; i < 16; i++){
+        lo = std::min(lo, block[i * 4 + channel]);
+        hi = std::max(hi, block[i * 4 + channel]);
+    }
+
+    // r0 > r1 の 8 段階モード。code 0 = r0 (最大), 1 = r1 (最小), 2..7 は r0 側から内分
+    uint64_t bits = 0;
+    if(hi > lo){
+        float scale = 7.0f / float(hi - lo);
+        for(int i = 0; i < 16; i++){
+            uint32_t p = uint32_t(std::lround(float(block[i * 4 + channel] - lo) * scale));
+            uint32_t code = p == 7 ? 0 : p == 0 ? 1 : 8 - p;
+            bits |= uint64_t(code) << (3 * i);
+        }
+    }
+
+    out[0] = hi;
+    out[1] = lo;
+    for(int i = 0; i < 6; i++) out[2 + i] = uint8_t(bits >> (8 * i));
+}
+
+void encodeBC5Block(const uint8_t* block, uint8_t* out){
+    encodeBC4Block(block, 0, out);
+    encodeBC4Block(block, 1, out + 8);
+}
+
+void encodeBC7Block(const uint8_t* block, uint8_t* out){
+    // mode 6: 1 サブセット, RGBA 7bit 端点 + 端点ごとの P ビット, 4bit インデックス
+    std::array<std::array<float, 4>, 16> px;
+    for(int i = 0; i < 16; i++){
+        for(int c = 0; c < 4; c++) px[i][c] = float(block[i * 4 + c]);
+    }
+    std::array<float, 4> e[2];
+    fitEndpoints<4>(px, e[0], e[1]);
+
+    // P ビットは端点ごとに誤差の小さい方を選ぶ
+    uint32_t q[2][4];
+    uint32_t p[2];
+    uint8_t endpoint[2][4];
+    for(int k = 0; k < 2; k++){
+        float bestErr = 1e30f;
+        for(uint32_t pbit = 0; pbit < 2; pbit++){
+            float err = 0.0f;
+            uint32_t cand[4];
+            for(int c = 0; c < 4; c++){
+                cand[c] = uint32_t(std::clamp(std::lround((e[k][c] - float(pbit)) * 0.5f), 0l, 127l));
+                float d = float((cand[c] << 1) | pbit) - e[k][c];
+                err += d * d;
+            }
+            if(err < bestErr){
+                bestErr = err;
+                p[k] = pbit;
+                std::copy(cand, cand + 4, q[k]);
+            }
+        }
+        for(int c = 0; c < 4; c++) endpoint[k][c] = uint8_t((q[k][c] << 1) | p[k]);
+    }
+
+    uint8_t palette[16][4];
+    for(int i = 0; i < 16; i++){
+        for(int c = 0; c < 4; c++){
+            palette[i][c] = uint8_t(((64 - kBC7Weights4[i]) * endpoint[0][c] + kBC7Weights4[i] * endpoint[1][c] + 32) >> 6);
+        }
+    }
+
+    uint32_t indices[16];
+    for(int i = 0; i < 16; i++){
+        uint32_t best = 0, bestErr = UINT32_MAX;
+        for(uint32_t k = 0; k < 16; k++){
+            uint32_t err = squaredError(block + i * 4, palette[k], 4);
+            if(err < bestErr){ bestErr = err; best = k; }
+        }
+        indices[i] = best;
+    }
+
+    // 先頭画素のインデックスの最上位ビットは省略されるので 0 にしておく
+    if(indices[0] & 8){
+        std::swap(q[0], q[1]);
+        std::swap(p[0], p[1]);
+        for(auto& index : indices) index = 15 - index;
+    }
+
+    std::memset(out, 0, 16);
+    BitWriter writer{out};
+    writer.write(1u << 6, 7);
+    for(int c = 0; c < 4; c++){
+        writer.write(q[0][c], 7);
+        writer.write(q[1][c], 7);
+    }
+    writer.write(p[0], 1);
+    writer.write(p[1], 1);
+    writer.write(indices[0], 3);
+    for(int i = 1; i < 16; i++) writer.write(indices[i], 4);
+}
+
+TextureData compressTexture(const TextureData& src, TextureFormat format){
+    PROFILE_ZONE("compressTexture");
+    if(format == TextureFormat::RGBA8 || src.format != TextureFormat::RGBA8) return src;
+
+    TextureData dst;
+    dst.width = src.width;
+    dst.height = src.height;
+    dst.mipLevels = src.mipLevels;
+    dst.format = format;
+    dst.pixels.resize(mipLevelOffset(src.width, src.height, src.mipLevels, format));
+
+    const size_t blockBytes = textureBlockBytes(format);
+    for(uint32_t level = 0; level < src.mipLevels; level++){
+        const uint8_t* pixels = src.pixels.data() + mipLevelOffset(src.width, src.height, level);
+        uint8_t* blocks = dst.pixels.data() + mipLevelOffset(src.width, src.height, level, format);
+        uint32_t w = mipExtent(src.width, level), h = mipExtent(src.height, level);
+        uint32_t blocksX = (w + 3) / 4, blocksY = (h + 3) / 4;
+
+        parallelRows(blocksY, [&](uint32_t begin, uint32_t end){
+            uint8_t block[64];
+            for(uint32_t by = begin; by < end; by++){
+                for(uint32_t bx = 0; bx < blocksX; bx++){
+                    gatherBlock(pixels, w, h, bx, by, block);
+                    uint8_t* out = blocks + (size_t(by) * blocksX + bx) * blockBytes;
+                    switch(format){
+                    case TextureFormat::BC1: encodeBC1Block(block, out); break;
+                    case TextureFormat::BC4: encodeBC4Block(block, 0, out); break;
+                    case TextureFormat::BC5: encodeBC5Block(block, out); break;
+                    case TextureFormat::BC7: encodeBC7Block(block, out); break;
+                    default: break;
+                    }
+                }
+            }
+        });
+    }
+    return dst;
+}
+
+std::vector<TextureFormat> chooseTextureFormats(const std::vector<Material>& materials, size_t textureCount, bool preferBC1){
+    std::vector<TextureFormat> formats(textureCount, TextureFormat::BC7);
+    auto assign = [&](int index, TextureFormat format){
+        if(index >= 0 && size_t(index) < textureCount) formats[index] = format;
+    };
+    // ORM のように1枚を共有している場合は後から割り当てた用途を優先する
+    for(const auto& m : materials) assign(m.occulusionTextureIndex, TextureFormat::BC4);
+    for(const auto& m : materials){
+        // BC5 は R/G だけ。シェーダは metallic = .r, roughness = .g で読むので B は要らない
+        assign(m.matallicRoughnessTextureIndex, TextureFormat::BC5);
+        assign(m.normalTextureIndex, TextureFormat::BC5);
+    }
+    TextureFormat color = preferBC1 ? TextureFormat::BC1 : TextureFormat::BC7;
+    for(const auto& m : materials){
+        assign(m.baseColorTextureIndex, color);
+        assign(m.emissiveTextureIndex, color);
+    }
+    return formats;
+}
+
+std::vector<bool> srgbTextureFlags(const std::vector<Material>& materials, size_t textureCount){
+    std::vector<bool> srgb(textureCount, false);
+    for(const auto& m : materials){
+        for(int index : {m.baseColorTextureIndex, m.emissiveTextureIndex}){
+            if(index >= 0 && size_t(index) < textureCount) srgb[index] = true;
+        }
+    }
+    return srgb;
+}
+
+bool writeTextureContainer(const std::filesystem::path& path, uint64_t sourceHash, const std::vector<TextureData>& textures){
+    PROFILE_ZONE("writeTextureContainer");
+    ContainerHeader header{};
+    std::memcpy(header.magic, kContainerMagic, sizeof(kContainerMagic));
+    header.version = kTextureContainerVersion;
+    header.textureCount = uint32_t(textures.size());
+    header.sourceHash = sourceHash;
+
+    std::vector<ContainerTexture> table;
+    uint64_t offset = sizeof(ContainerHeader) + textures.size() * sizeof(ContainerTexture);
+    for(const auto& tex : textures){
+        offset = (offset + kContainerAlignment - 1) / kContainerAlignment * kContainerAlignment;
+        table.push_back({tex.width, tex.height, tex.mipLevels, tex.format, offset, tex.pixels.size()});
+        offset += tex.pixels.size();
+    }
+    header.fileSize = offset;
+
+    std::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!ofs) return false;
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(table.data()), std::streamsize(table.size() * sizeof(ContainerTexture)));
+        uint64_t written = sizeof(header) + table.size() * sizeof(ContainerTexture);
+        for(size_t i = 0; i < textures.size(); i++){
+            static const char zeros[kContainerAlignment] = {};
+            ofs.write(zeros, std::streamsize(table[i].offset - written));
+            ofs.write(reinterpret_cast<const char*>(textures[i].pixels.data()), std::streamsize(table[i].size));
+            written = table[i].offset + table[i].size;
+        }
+        if(!ofs) return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+bool readTextureContainer(const std::filesystem::path& path, uint64_t sourceHash, std::vector<TextureData>& textures){
+    PROFILE_ZONE("readTextureContainer");
+    MappedFile file;
+    if(!file.open(path)) return false;
+
+    auto reject = [&](const char* reason){
+        std::cout << "texture container rejected (" << reason << "): " << path.string() << std::endl;
+        return false;
+    };
+
+    ContainerHeader header{};
+    if(file.size < sizeof(header)) return reject("truncated");
+    std::memcpy(&header, file.data, sizeof(header));
+    if(std::memcmp(header.magic, kContainerMagic, sizeof(kContainerMagic)) != 0) return reject("bad magic");
+    if(header.version != kTextureContainerVersion) return reject("version");
+    if(header.fileSize != file.size) return reject("size");
+    if(header.sourceHash != sourceHash) return reject("source changed");
+    if(header.textureCount > (file.size - sizeof(header)) / sizeof(ContainerTexture)) return reject("texture table");
+
+    std::vector<ContainerTexture> table(header.textureCount);
+    std::memcpy(table.data(), file.data + sizeof(header), table.size() * sizeof(ContainerTexture));
+
+    std::vector<TextureData> loaded;
+    for(const auto& entry : table){
+        if(entry.offset > file.size || entry.size > file.size - entry.offset ||
+           entry.format > TextureFormat::BC7 || entry.width == 0 || entry.height == 0 ||
+           entry.mipLevels == 0 || entry.mipLevels > mipLevelCount(entry.width, entry.height) ||
+           entry.size != mipLevelOffset(entry.width, entry.height, entry.mipLevels, entry.format)){
+            return reject("texture table");
+        }
+        TextureData tex;
+        tex.width = entry.width;
+        tex.height = entry.height;
+        tex.mipLevels = entry.mipLevels;
+        tex.format = entry.format;
+        tex.pixels.assign(file.data + entry.offset, file.data + entry.offset + entry.size);
+        loaded.push_back(std::move(tex));
+    }
+    textures = std::move(loaded);
+    return true;
+}
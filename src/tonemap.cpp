@@ -0,0 +1,84 @@
+#include "../include/tonemap.hpp"
+#include "../include/profiler.hpp"
+
+#include "tonemap_spv.hpp"
+
+#include <iostream>
+
+namespace {
+
+constexpr uint32_t kTonemapGroupSize = 8;
+
+}
+
+void createTonemapPipeline(){
+    PROFILE_ZONE("createTonemapPipeline");
+
+    std::vector<vk::DescriptorSetLayoutBinding> bindings(2);
+    for(uint32_t i = 0; i < 2; i++){
+        bindings[i].setBinding(i);
+        bindings[i].setDescriptorType(vk::DescriptorType::eStorageImage);
+        bindings[i].setDescriptorCount(1);
+        bindings[i].setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    }
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo{};
+    layoutCreateInfo.setBindings(bindings);
+    tonemapDescSetLayout = device->createDescriptorSetLayoutUnique(layoutCreateInfo);
+
+    vk::DescriptorPoolSize poolSize{vk::DescriptorType::eStorageImage, 2};
+    vk::DescriptorPoolCreateInfo poolCreateInfo{};
+    poolCreateInfo.setPoolSizes(poolSize);
+    poolCreateInfo.setMaxSets(1);
+    poolCreateInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+    tonemapDescPool = device->createDescriptorPoolUnique(poolCreateInfo);
+
+    vk::DescriptorSetAllocateInfo allocateInfo{};
+    allocateInfo.setDescriptorPool(*tonemapDescPool);
+    allocateInfo.setSetLayouts(*tonemapDescSetLayout);
+    tonemapDescSet = std::move(device->allocateDescriptorSetsUnique(allocateInfo)[0]);
+
+    vk::DescriptorImageInfo imageInfos[2];
+    imageInfos[0].setImageView(hdrView.get());
+    imageInfos[0].setImageLayout(vk::ImageLayout::eGeneral);
+    imageInfos[1].setImageView(outputView.get());
+    imageInfos[1].setImageLayout(vk::ImageLayout::eGeneral);
+    std::vector<vk::WriteDescriptorSet> writes(2);
+    for(uint32_t i = 0; i < 2; i++){
+        writes[i].setDstSet(*tonemapDescSet);
+        writes[i].setDstBinding(i);
+        writes[i].setDescriptorType(vk::DescriptorType::eStorageImage);
+        writes[i].setImageInfo(imageInfos[i]);
+    }
+    device->updateDescriptorSets(writes, nullptr);
+
+    vk::PushConstantRange pushRange{vk::ShaderStageFlagBits::eCompute, 0, sizeof(TonemapParams)};
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+    pipelineLayoutCreateInfo.setSetLayouts(*tonemapDescSetLayout);
+    pipelineLayoutCreateInfo.setPushConstantRanges(pushRange);
+    tonemapPipelineLayout = device->createPipelineLayoutUnique(pipelineLayoutCreateInfo);
+
+    vk::ShaderModuleCreateInfo moduleCreateInfo{};
+    moduleCreateInfo.codeSize = tonemap_spv_size;
+    moduleCreateInfo.pCode = tonemap_spv;
+    tonemapShader = device->createShaderModuleUnique(moduleCreateInfo);
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo{};
+    pipelineCreateInfo.stage.setStage(vk::ShaderStageFlagBits::eCompute);
+    pipelineCreateInfo.stage.setModule(*tonemapShader);
+    pipelineCreateInfo.stage.setPName("main");
+    pipelineCreateInfo.setLayout(*tonemapPipelineLayout);
+    auto result = device->createComputePipelineUnique(*pipelineCache, pipelineCreateInfo);
+    if(result.result != vk::Result::eSuccess){
+        std::cerr << "Failed to create tonemap pipeline.\n";
+        std::abort();
+    }
+    tonemapPipeline = std::move(result.value);
+}
+
+void recordTonemap(vk::CommandBuffer cmdBuf, const TonemapParams& params){
+    cmdBuf.bindPipeline(vk::PipelineBindPoint::eCompute, tonemapPipeline.get());
+    cmdBuf.bindDescriptorSets(vk::PipelineBindPoint::eCompute, tonemapPipelineLayout.get(), 0, {tonemapDescSet.get()}, {});
+    cmdBuf.pushConstants(tonemapPipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(TonemapParams), &params);
+    cmdBuf.dispatch((width + kTonemapGroupSize - 1) / kTonemapGroupSize,
+                    (height + kTonemapGroupSize - 1) / kTonemapGroupSize, 1);
+}
@@ -0,0 +1,35 @@
+#include "../include/tonemap_curve.hpp"
+#include "../include/parallel.hpp"
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Narkowicz の ACES フィルミックカーブの近似
+float acesFitted(float x){
+    return std::clamp((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f), 0.0f, 1.0f);
+}
+
+uint8_t srgbEncode8(float c){
+    c = std::clamp(c, 0.0f, 1.0f);
+    float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    return uint8_t(s * 255.0f + 0.5f);
+}
+
+}
+
+void tonemapFrame(std::span<const float> hdr, uint32_t width, uint32_t height, const TonemapParams& params, std::span<uint8_t> ldr){
+    PROFILE_ZONE("tonemapFrame");
+    parallelRows(height, [&](uint32_t begin, uint32_t end){
+        for(size_t i = size_t(begin) * width; i < size_t(end) * width; i++){
+            for(int c = 0; c < 3; c++){
+                float v = std::max(hdr[i * 4 + c], 0.0f) * params.exposure;
+                if(params.tonemapOperator == kTonemapAces) v = acesFitted(v);
+                ldr[i * 4 + c] = srgbEncode8(v);
+            }
+            ldr[i * 4 + 3] = 255;
+        }
+    });
+}
@@ -1,7 +1,10 @@
 #include "../include/globals.hpp"
 #include "../include/buffer.hpp"
+#include "../include/sampler.hpp"
+#include "../include/profiler.hpp"
 
 void createUniformBuffer(){
+    PROFILE_ZONE("createUniformBuffer");
     
     vk::BufferUsageFlags bufferUsage{vk::BufferUsageFlagBits::eUniformBuffer};
     vk::MemoryPropertyFlags memoryProperty{
@@ -13,4 +16,14 @@ void createUniformBuffer(){
         bufferUsage, memoryProperty, &scene);
 
     uniformData = device->mapMemory(sceneBuffer.memory.get(), 0, VK_WHOLE_SIZE);
-}
\ No newline at end of file
+}
+
+void createSobolBuffer(){
+    PROFILE_ZONE("createSobolBuffer");
+    std::vector<uint32_t> matrices = buildSobolMatrices(kSobolDimensions);
+    sobolBuffer.init(
+        physicalDevice, *device, sizeof(uint32_t) * matrices.size(),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        matrices.data());
+}
@@ -0,0 +1,186 @@
+#include "../include/video_output.hpp"
+#include "../include/parallel.hpp"
+#include "../include/profiler.hpp"
+
+#include <algorithm>
+#include <csignal>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace {
+
+struct SinkInfo {
+    VideoSink sink;
+    const char* name;
+    const char* defaultPath;
+};
+
+constexpr SinkInfo kSinks[] = {
+    {VideoSink::None,   "none",   ""},
+    {VideoSink::Ffmpeg, "ffmpeg", "out.mp4"},
+    {VideoSink::Y4m,    "y4m",    "out.y4m"},
+};
+
+const SinkInfo& sinkInfo(VideoSink sink){
+    for(const auto& info : kSinks){
+        if(info.sink == sink) return info;
+    }
+    return kSinks[0];
+}
+
+// BT.601 limited range の整数近似
+uint8_t lumaOf(int r, int g, int b){
+    return uint8_t(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+}
+
+bool parseVideoSink(std::string_view name, VideoSink& sink){
+    for(const auto& info : kSinks){
+        if(name == info.name){
+            sink = info.sink;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* videoSinkName(VideoSink sink){
+    return sinkInfo(sink).name;
+}
+
+const char* defaultVideoPath(VideoSink sink){
+    return sinkInfo(sink).defaultPath;
+}
+
+void rgbaToI420(std::span<const uint8_t> rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& out){
+    const uint32_t cw = (width + 1) / 2;
+    const uint32_t ch = (height + 1) / 2;
+    out.resize(size_t(width) * height + 2 * size_t(cw) * ch);
+    uint8_t* yPlane = out.data();
+    uint8_t* uPlane = yPlane + size_t(width) * height;
+    uint8_t* vPlane = uPlane + size_t(cw) * ch;
+
+    // 色差 1 行が輝度 2 行に対応する
+    parallelRows(ch, [&](uint32_t begin, uint32_t end){
+        for(uint32_t cy = begin; cy < end; cy++){
+            const uint32_t y0 = cy * 2;
+            const uint32_t y1 = std::min(y0 + 1, height - 1);
+            const uint8_t* row0 = rgba.data() + size_t(y0) * width * 4;
+            const uint8_t* row1 = rgba.data() + size_t(y1) * width * 4;
+            for(uint32_t x = 0; x < width; x++){
+                const uint8_t* p = row0 + x * 4;
+                yPlane[size_t(y0) * width + x] = lumaOf(p[0], p[1], p[2]);
+                if(y1 != y0){
+                    const uint8_t* q = row1 + x * 4;
+                    yPlane[size_t(y1) * width + x] = lumaOf(q[0], q[1], q[2]);
+                }
+            }
+            for(uint32_t cx = 0; cx < cw; cx++){
+                const uint32_t x0 = cx * 2;
+                const uint32_t x1 = std::min(x0 + 1, width - 1);
+                int r = 0, g = 0, b = 0;
+                for(const uint8_t* row : {row0, row1}){
+                    for(uint32_t x : {x0, x1}){
+                        r += row[x * 4 + 0];
+                        g += row[x * 4 + 1];
+                        b += row[x * 4 + 2];
+                    }
+                }
+                // 4 画素の合計なので係数の分母に 4 を足す
+                uPlane[size_t(cy) * cw + cx] = uint8_t(((-38 * r - 74 * g + 112 * b + 512) >> 10) + 128);
+                vPlane[size_t(cy) * cw + cx] = uint8_t(((112 * r - 94 * g - 18 * b + 512) >> 10) + 128);
+            }
+        }
+    });
+}
+
+VideoWriter::~VideoWriter(){
+    close();
+}
+
+bool VideoWriter::open(VideoSink videoSink, const std::filesystem::path& path, uint32_t frameWidth, uint32_t frameHeight, uint32_t fps){
+    PROFILE_ZONE("openVideo");
+    close();
+    if(videoSink == VideoSink::None || frameWidth == 0 || frameHeight == 0 || fps == 0) return false;
+    width = frameWidth;
+    height = frameHeight;
+    frameCount = 0;
+
+    if(videoSink == VideoSink::Ffmpeg){
+        std::string out = path.string();
+#ifdef _WIN32
+        // cmd.exe の引用符の中では " 以外は展開されない
+        if(out.find('"') != std::string::npos){
+            std::cerr << "video path must not contain quotes: " << out << "\n";
+            return false;
+        }
+        std::string quotedOut = "\"" + out + "\"";
+#else
+        // /bin/sh が $ やバッククォートを展開しないよう単引用符で囲む (' は '\'' にする)
+        std::string quotedOut = "'";
+        for(char c : out){
+            if(c == '\'') quotedOut += "'\\''";
+            else quotedOut += c;
+        }
+        quotedOut += "'";
+#endif
+#ifndef _WIN32
+        // ffmpeg が先に落ちても write の失敗として扱う
+        std::signal(SIGPIPE, SIG_IGN);
+#endif
+        std::string cmd = "ffmpeg -hide_banner -loglevel error -y -f rawvideo -pix_fmt rgba"
+            " -s " + std::to_string(width) + "x" + std::to_string(height) +
+            " -r " + std::to_string(fps) + " -i -"
+            " -c:v libx264 -preset medium -crf 18 -pix_fmt yuv420p " + quotedOut;
+#ifdef _WIN32
+        fp = popen(cmd.c_str(), "wb");
+#else
+        fp = popen(cmd.c_str(), "w");
+#endif
+        if(!fp){
+            std::cerr << "failed to start ffmpeg\n";
+            return false;
+        }
+    }else{
+        fp = std::fopen(path.string().c_str(), "wb");
+        if(!fp){
+            std::cerr << "failed to open " << path.string() << "\n";
+            return false;
+        }
+        // C420jpeg: 色差は 2x2 の中心 (rgbaToI420 の平均と同じ位置)
+        std::fprintf(fp, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, fps);
+    }
+    sink = videoSink;
+    return true;
+}
+
+bool VideoWriter::write(std::span<const uint8_t> rgba){
+    PROFILE_ZONE("writeVideoFrame");
+    if(!fp || rgba.size() < size_t(width) * height * 4) return false;
+
+    bool ok = false;
+    if(sink == VideoSink::Ffmpeg){
+        size_t size = size_t(width) * height * 4;
+        ok = std::fwrite(rgba.data(), 1, size, fp) == size;
+    }else{
+        rgbaToI420(rgba, width, height, scratch);
+        ok = std::fputs("FRAME\n", fp) >= 0 && std::fwrite(scratch.data(), 1, scratch.size(), fp) == scratch.size();
+    }
+    if(ok) frameCount++;
+    return ok;
+}
+
+bool VideoWriter::close(){
+    if(!fp) return true;
+    PROFILE_ZONE("closeVideo");
+    bool ok = sink == VideoSink::Ffmpeg ? pclose(fp) == 0 : std::fclose(fp) == 0;
+    fp = nullptr;
+    sink = VideoSink::None;
+    return ok;
+}
@@ -1,4 +1,5 @@
 #include "../include/globals.hpp"
+#include "../include/profiler.hpp"
 #include <iostream>
 
 
@@ -10,6 +11,7 @@ VKAPI_ATTR vk::Bool32 VKAPI_CALL debug_message(
 );
 
 void SetupVulkan(){
+    PROFILE_ZONE("SetupVulkan");
 	// create instance
 	vk::detail::DynamicLoader dl;
 	auto vkGetInstanceProcAddr = dl.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr");
@@ -119,6 +121,8 @@ void SetupVulkan(){
         VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME,
     };
     vk::PhysicalDeviceFeatures2 feats2{};
+    // 圧縮済みテクスチャ (.mtex) 用。非対応なら uploadTextures で止める
+    feats2.features.textureCompressionBC = physicalDevice.getFeatures().textureCompressionBC;
     vk::PhysicalDeviceVulkan12Features v12{};
     v12.bufferDeviceAddress = VK_TRUE;
 
@@ -0,0 +1,184 @@
+// temporalAccumulate (CPU 版) の既知の入力に対する結果を確かめる
+// カメラに正対する平面を写し、履歴の採用・棄却と混合率の下限、動いたカメラからの再投影を見る
+#include "../include/temporal_reproject.hpp"
+#include "../include/camera_timeline.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// 横長にしてアスペクト比の扱いも確かめる。画角 90 度、深度 2 なので
+// カメラを横に 1 動かすと 1 画素、縦に 1 動かすと 1 画素ずれる
+constexpr uint32_t kWidth = 8;
+constexpr uint32_t kHeight = 4;
+constexpr size_t kPixels = size_t(kWidth) * kHeight;
+constexpr float kDepth = 2.0f;
+constexpr float kVFov = 1.57079633f;
+
+int failures = 0;
+
+void check(bool ok, const char* name, float got, float expected){
+    if(!ok){
+        std::printf("FAIL %s: got %g, expected %g\n", name, got, expected);
+        failures++;
+    }
+}
+
+void checkNear(const char* name, float got, float expected){
+    check(std::abs(got - expected) <= 1e-4f, name, got, expected);
+}
+
+struct Frame {
+    std::vector<float> current = std::vector<float>(kPixels * 4, 0.0f);
+    std::vector<float> normal = std::vector<float>(kPixels * 4, 0.0f);
+    std::vector<float> depth = std::vector<float>(kPixels, kDepth);
+    std::vector<float> prevColor = std::vector<float>(kPixels * 4, 0.0f);
+    std::vector<float> prevGeometry = std::vector<float>(kPixels * 4, 0.0f);
+    std::vector<float> nextColor = std::vector<float>(kPixels * 4, -1.0f);
+    std::vector<float> nextGeometry = std::vector<float>(kPixels * 4, -1.0f);
+    std::vector<float> output = std::vector<float>(kPixels * 4, -1.0f);
+};
+
+// 今のフレームは黒、履歴は白 (historyLength フレーム分)。どちらもカメラに正対する平面 (法線 +Z) で深度 kDepth
+Frame makeFrame(float historyLength, float historyDepth, float historyNormalZ){
+    Frame f;
+    for(size_t p = 0; p < kPixels; p++){
+        f.current[p * 4 + 3] = 1.0f;
+        f.normal[p * 4 + 2] = 1.0f;
+        for(int c = 0; c < 3; c++) f.prevColor[p * 4 + c] = 1.0f;
+        f.prevColor[p * 4 + 3] = historyLength;
+        f.prevGeometry[p * 4 + 0] = std::sqrt(1.0f - historyNormalZ * historyNormalZ);
+        f.prevGeometry[p * 4 + 2] = historyNormalZ;
+        f.prevGeometry[p * 4 + 3] = historyDepth;
+    }
+    return f;
+}
+
+// 今のカメラは原点から -Z を見る。平面の法線はカメラ向き (+Z)
+// 前のカメラは向きはそのままで previousPosition にあったとする
+void run(Frame& f, uint32_t historyValid, glm::vec3 previousPosition = glm::vec3(0.0f)){
+    const glm::vec3 forward(0.0f, 0.0f, -1.0f);
+    const glm::vec3 up(0.0f, 1.0f, 0.0f);
+    TemporalParams params{};
+    params.current = makeTemporalCamera(makeCameraView(glm::vec3(0.0f), forward, up, kVFov), kWidth, kHeight);
+    params.previous = makeTemporalCamera(makeCameraView(previousPosition, forward, up, kVFov), kWidth, kHeight);
+    params.historyValid = historyValid;
+    temporalAccumulate(f.current, f.normal, f.depth, kWidth, kHeight, params,
+                       TemporalHistoryView{f.prevColor, f.prevGeometry},
+                       TemporalHistory{f.nextColor, f.nextGeometry}, f.output);
+}
+
+// 全画素が同じ結果になるはず
+void expectAll(const char* name, const Frame& f, float color, float length){
+    for(size_t p = 0; p < kPixels; p++){
+        checkNear(name, f.output[p * 4 + 0], color);
+        checkNear(name, f.nextColor[p * 4 + 0], color);
+        checkNear(name, f.nextColor[p * 4 + 3], length);
+        checkNear(name, f.output[p * 4 + 3], 1.0f);
+    }
+}
+
+}
+
+int main(){
+    // 最初のフレーム: 履歴は使わない
+    {
+        Frame f = makeFrame(3.0f, kDepth, 1.0f);
+        run(f, 0);
+        expectAll("first frame", f, 0.0f, 1.0f);
+        for(size_t p = 0; p < kPixels; p++){
+            checkNear("first frame geometry normal", f.nextGeometry[p * 4 + 2], 1.0f);
+            checkNear("first frame geometry depth", f.nextGeometry[p * 4 + 3], kDepth);
+        }
+    }
+    // 履歴 3 フレーム: 混合率 1/4
+    {
+        Frame f = makeFrame(3.0f, kDepth, 1.0f);
+        run(f, 1);
+        expectAll("accumulate", f, 0.75f, 4.0f);
+    }
+    // 長い履歴: 混合率は minBlend (0.1) で止まる
+    {
+        Frame f = makeFrame(100.0f, kDepth, 1.0f);
+        run(f, 1);
+        expectAll("min blend clamp", f, 0.9f, 101.0f);
+    }
+    // 深度が許容誤差 (5%) を超えて違う履歴は捨てる
+    {
+        Frame f = makeFrame(3.0f, kDepth * 1.5f, 1.0f);
+        run(f, 1);
+        expectAll("depth rejection", f, 0.0f, 1.0f);
+    }
+    // 深度のずれが許容範囲内なら使う
+    {
+        Frame f = makeFrame(3.0f, kDepth * 1.02f, 1.0f);
+        run(f, 1);
+        expectAll("depth tolerance", f, 0.75f, 4.0f);
+    }
+    // 法線の内積が normalThreshold (0.9) 未満の履歴は捨てる
+    {
+        Frame f = makeFrame(3.0f, kDepth, 0.5f);
+        run(f, 1);
+        expectAll("normal rejection", f, 0.0f, 1.0f);
+    }
+    // 前のカメラが右に 1.5、上に 0.25 ずれていた: 画素 (x, y) は前のフレームの (x - 1.5, y + 0.25) に写る
+    // 双線形のタップは x - 2, x - 1 が 0.5 ずつ、y, y + 1 が 0.75 / 0.25。画面外のタップは除いて正規化する
+    {
+        Frame f = makeFrame(3.0f, kDepth, 1.0f);
+        auto historyValue = [](int x, int y){ return 1.0f + float(x) + 10.0f * float(y); };
+        for(uint32_t y = 0; y < kHeight; y++){
+            for(uint32_t x = 0; x < kWidth; x++){
+                for(int c = 0; c < 3; c++) f.prevColor[(size_t(y) * kWidth + x) * 4 + c] = historyValue(int(x), int(y));
+            }
+        }
+        run(f, 1, glm::vec3(1.5f, 0.25f, 0.0f));
+        for(int y = 0; y < int(kHeight); y++){
+            for(int x = 0; x < int(kWidth); x++){
+                float weightSum = 0.0f;
+                float valueSum = 0.0f;
+                for(int tx : {x - 2, x - 1}){
+                    for(int ty : {y, y + 1}){
+                        if(tx < 0 || ty >= int(kHeight)) continue;
+                        float w = 0.5f * (ty == y ? 0.75f : 0.25f);
+                        weightSum += w;
+                        valueSum += w * historyValue(tx, ty);
+                    }
+                }
+                const size_t p = size_t(y) * kWidth + size_t(x);
+                if(x == 0){
+                    // 左端は前のフレームの画面外に写るので履歴なし
+                    check(weightSum == 0.0f, "offscreen taps", weightSum, 0.0f);
+                    checkNear("offscreen color", f.output[p * 4 + 0], 0.0f);
+                    checkNear("offscreen length", f.nextColor[p * 4 + 3], 1.0f);
+                    continue;
+                }
+                const float expected = 0.75f * valueSum / weightSum;
+                checkNear("reprojected color", f.output[p * 4 + 0], expected);
+                checkNear("reprojected color", f.nextColor[p * 4 + 2], expected);
+                checkNear("reprojected length", f.nextColor[p * 4 + 3], 4.0f);
+            }
+        }
+        // 具体値でも 1 つ確かめる: (3, 1) は (1, 1), (2, 1) が 0.375、(1, 2), (2, 2) が 0.125
+        checkNear("reprojected (3, 1)", f.output[(1 * kWidth + 3) * 4 + 0],
+                  0.75f * (0.375f * 12.0f + 0.375f * 13.0f + 0.125f * 22.0f + 0.125f * 23.0f));
+    }
+    // 背景 (深度 0) は履歴を使わず、幾何も 0 で残す
+    {
+        Frame f = makeFrame(3.0f, kDepth, 1.0f);
+        for(float& z : f.depth) z = 0.0f;
+        run(f, 1);
+        expectAll("background", f, 0.0f, 1.0f);
+        for(size_t p = 0; p < kPixels; p++){
+            checkNear("background geometry depth", f.nextGeometry[p * 4 + 3], 0.0f);
+        }
+    }
+
+    if(failures > 0){
+        std::printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("temporal_reproject_test: ok\n");
+    return 0;
+}